@@ -0,0 +1,294 @@
+﻿// XGBlockCompression.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGBlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /**
+     * \brief Rounds a color to the 5:6:5 bits of a block endpoint
+     */
+    uint16_t PackColor565(float Red, float Green, float Blue)
+    {
+        const auto Quantize = [](float Value, int MaxValue)
+        {
+            const int Quantized = static_cast<int>(Value * static_cast<float>(MaxValue) / 255.0f + 0.5f);
+            return std::max(0, std::min(Quantized, MaxValue));
+        };
+
+        return static_cast<uint16_t>((Quantize(Red, 31) << 11) | (Quantize(Green, 63) << 5) | Quantize(Blue, 31));
+    }
+
+    /**
+     * \brief Packs the channels of a color into the layout of olc::Pixel, without going through its constructor
+     */
+    uint32_t PackTexel(int Red, int Green, int Blue, int Alpha)
+    {
+        return static_cast<uint32_t>(Red) | (static_cast<uint32_t>(Green) << 8) | (static_cast<uint32_t>(Blue) << 16) |
+            (static_cast<uint32_t>(Alpha) << 24);
+    }
+
+    /**
+     * \brief Expands the endpoints of a color block into the four colors its indices pick from
+     */
+    void GetColorPalette(uint16_t Color0, uint16_t Color1, bool IsAlphaAllowed, uint32_t OutPalette[4])
+    {
+        // Repeating the high bits in the low ones maps the largest 5 or 6 bit value to 255
+        const int Red0 = ((Color0 >> 8) & 0xF8) | (Color0 >> 13);
+        const int Green0 = ((Color0 >> 3) & 0xFC) | ((Color0 >> 9) & 0x03);
+        const int Blue0 = ((Color0 << 3) & 0xF8) | ((Color0 >> 2) & 0x07);
+        const int Red1 = ((Color1 >> 8) & 0xF8) | (Color1 >> 13);
+        const int Green1 = ((Color1 >> 3) & 0xFC) | ((Color1 >> 9) & 0x03);
+        const int Blue1 = ((Color1 << 3) & 0xF8) | ((Color1 >> 2) & 0x07);
+
+        OutPalette[0] = PackTexel(Red0, Green0, Blue0, 255);
+        OutPalette[1] = PackTexel(Red1, Green1, Blue1, 255);
+        if (Color0 > Color1 || !IsAlphaAllowed)
+        {
+            OutPalette[2] = PackTexel((Red0 * 2 + Red1 + 1) / 3, (Green0 * 2 + Green1 + 1) / 3, (Blue0 * 2 + Blue1 + 1) / 3, 255);
+            OutPalette[3] = PackTexel((Red0 + Red1 * 2 + 1) / 3, (Green0 + Green1 * 2 + 1) / 3, (Blue0 + Blue1 * 2 + 1) / 3, 255);
+        }
+        else
+        {
+            OutPalette[2] = PackTexel((Red0 + Red1 + 1) / 2, (Green0 + Green1 + 1) / 2, (Blue0 + Blue1 + 1) / 2, 255);
+            OutPalette[3] = 0;
+        }
+    }
+
+    /**
+     * \brief Expands the endpoints of an alpha block into the eight values its indices pick from
+     */
+    void GetAlphaPalette(uint8_t Alpha0, uint8_t Alpha1, uint8_t OutPalette[8])
+    {
+        OutPalette[0] = Alpha0;
+        OutPalette[1] = Alpha1;
+        if (Alpha0 > Alpha1)
+        {
+            for (int Index = 2; Index < 8; ++Index)
+            {
+                OutPalette[Index] = static_cast<uint8_t>(((8 - Index) * Alpha0 + (Index - 1) * Alpha1 + 3) / 7);
+            }
+        }
+        else
+        {
+            // Blocks with endpoints in this order trade two of the blended values for fully transparent and opaque
+            for (int Index = 2; Index < 6; ++Index)
+            {
+                OutPalette[Index] = static_cast<uint8_t>(((6 - Index) * Alpha0 + (Index - 1) * Alpha1 + 2) / 5);
+            }
+            OutPalette[6] = 0;
+            OutPalette[7] = 255;
+        }
+    }
+
+    int GetColorDistance(const olc::Pixel& Color, uint32_t PaletteColor)
+    {
+        const int Red = Color.r - static_cast<int>(PaletteColor & 0xFF);
+        const int Green = Color.g - static_cast<int>((PaletteColor >> 8) & 0xFF);
+        const int Blue = Color.b - static_cast<int>((PaletteColor >> 16) & 0xFF);
+        return Red * Red + Green * Green + Blue * Blue;
+    }
+}
+
+uint64_t XGBlockCompression::EncodeColorBlock(const olc::Pixel* Texels, uint32_t ValidTexelMask)
+{
+    // Find the mean color of the block and how its colors vary around it
+    float Mean[3] = { 0.0f, 0.0f, 0.0f };
+    int ValidTexelCount = 0;
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        if ((ValidTexelMask & (1u << Index)) != 0)
+        {
+            Mean[0] += Texels[Index].r;
+            Mean[1] += Texels[Index].g;
+            Mean[2] += Texels[Index].b;
+            ++ValidTexelCount;
+        }
+    }
+
+    if (ValidTexelCount == 0)
+    {
+        return 0;
+    }
+
+    for (float& Channel : Mean)
+    {
+        Channel /= static_cast<float>(ValidTexelCount);
+    }
+
+    float Covariance[3][3] = {};
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        if ((ValidTexelMask & (1u << Index)) != 0)
+        {
+            const float Offset[3] = { Texels[Index].r - Mean[0], Texels[Index].g - Mean[1], Texels[Index].b - Mean[2] };
+            for (int Row = 0; Row < 3; ++Row)
+            {
+                for (int Column = 0; Column < 3; ++Column)
+                {
+                    Covariance[Row][Column] += Offset[Row] * Offset[Column];
+                }
+            }
+        }
+    }
+
+    // The colors spread out the most along the principal axis of the covariance, which a few rounds of power iteration
+    // find. Starting from the channel that varies the most keeps the first round from vanishing.
+    int WidestChannel = 0;
+    for (int Channel = 1; Channel < 3; ++Channel)
+    {
+        if (Covariance[Channel][Channel] > Covariance[WidestChannel][WidestChannel])
+        {
+            WidestChannel = Channel;
+        }
+    }
+
+    float Axis[3] = { 0.0f, 0.0f, 0.0f };
+    Axis[WidestChannel] = 1.0f;
+    for (int Iteration = 0; Iteration < 4; ++Iteration)
+    {
+        float NextAxis[3];
+        for (int Row = 0; Row < 3; ++Row)
+        {
+            NextAxis[Row] = Covariance[Row][0] * Axis[0] + Covariance[Row][1] * Axis[1] + Covariance[Row][2] * Axis[2];
+        }
+
+        // Every texel has the same color when nothing varies
+        const float Length = std::sqrt(NextAxis[0] * NextAxis[0] + NextAxis[1] * NextAxis[1] + NextAxis[2] * NextAxis[2]);
+        if (Length < 1.0e-6f)
+        {
+            break;
+        }
+
+        for (int Row = 0; Row < 3; ++Row)
+        {
+            Axis[Row] = NextAxis[Row] / Length;
+        }
+    }
+
+    // The endpoints are the extremes of the colors projected onto the axis
+    float MinProjection = 0.0f;
+    float MaxProjection = 0.0f;
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        if ((ValidTexelMask & (1u << Index)) != 0)
+        {
+            const float Projection =
+                (Texels[Index].r - Mean[0]) * Axis[0] + (Texels[Index].g - Mean[1]) * Axis[1] + (Texels[Index].b - Mean[2]) * Axis[2];
+            MinProjection = std::min(MinProjection, Projection);
+            MaxProjection = std::max(MaxProjection, Projection);
+        }
+    }
+
+    uint16_t Color0 = PackColor565(Mean[0] + Axis[0] * MaxProjection, Mean[1] + Axis[1] * MaxProjection, Mean[2] + Axis[2] * MaxProjection);
+    uint16_t Color1 = PackColor565(Mean[0] + Axis[0] * MinProjection, Mean[1] + Axis[1] * MinProjection, Mean[2] + Axis[2] * MinProjection);
+
+    // Keeping the first endpoint greater selects the mode with four colors
+    if (Color0 < Color1)
+    {
+        std::swap(Color0, Color1);
+    }
+
+    uint64_t Block = static_cast<uint64_t>(Color0) | (static_cast<uint64_t>(Color1) << 16);
+    if (Color0 == Color1)
+    {
+        // Every index picks the first endpoint
+        return Block;
+    }
+
+    uint32_t Palette[4];
+    GetColorPalette(Color0, Color1, true, Palette);
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        int BestEntry = 0;
+        int BestDistance = GetColorDistance(Texels[Index], Palette[0]);
+        for (int Entry = 1; Entry < 4; ++Entry)
+        {
+            const int Distance = GetColorDistance(Texels[Index], Palette[Entry]);
+            if (Distance < BestDistance)
+            {
+                BestEntry = Entry;
+                BestDistance = Distance;
+            }
+        }
+
+        Block |= static_cast<uint64_t>(BestEntry) << (32 + Index * 2);
+    }
+
+    return Block;
+}
+
+uint64_t XGBlockCompression::EncodeAlphaBlock(const olc::Pixel* Texels, uint32_t ValidTexelMask)
+{
+    int MinAlpha = 255;
+    int MaxAlpha = 0;
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        if ((ValidTexelMask & (1u << Index)) != 0)
+        {
+            MinAlpha = std::min(MinAlpha, static_cast<int>(Texels[Index].a));
+            MaxAlpha = std::max(MaxAlpha, static_cast<int>(Texels[Index].a));
+        }
+    }
+
+    if (MaxAlpha <= MinAlpha)
+    {
+        // Every index picks the first endpoint, which is opaque if the block had no valid texels
+        return static_cast<uint64_t>(std::max(MinAlpha, MaxAlpha)) | (static_cast<uint64_t>(MinAlpha) << 8);
+    }
+
+    // Keeping the first endpoint greater selects the mode with eight blended values
+    uint64_t Block = static_cast<uint64_t>(MaxAlpha) | (static_cast<uint64_t>(MinAlpha) << 8);
+
+    uint8_t Palette[8];
+    GetAlphaPalette(static_cast<uint8_t>(MaxAlpha), static_cast<uint8_t>(MinAlpha), Palette);
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        int BestEntry = 0;
+        int BestDistance = 256;
+        for (int Entry = 0; Entry < 8; ++Entry)
+        {
+            const int Distance = std::abs(Texels[Index].a - Palette[Entry]);
+            if (Distance < BestDistance)
+            {
+                BestEntry = Entry;
+                BestDistance = Distance;
+            }
+        }
+
+        Block |= static_cast<uint64_t>(BestEntry) << (16 + Index * 3);
+    }
+
+    return Block;
+}
+
+void XGBlockCompression::DecodeColorBlock(uint64_t Block, bool IsAlphaAllowed, olc::Pixel* OutTexels)
+{
+    uint32_t Palette[4];
+    GetColorPalette(static_cast<uint16_t>(Block), static_cast<uint16_t>(Block >> 16), IsAlphaAllowed, Palette);
+
+    uint32_t Indices = static_cast<uint32_t>(Block >> 32);
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        OutTexels[Index].n = Palette[Indices & 3];
+        Indices >>= 2;
+    }
+}
+
+void XGBlockCompression::DecodeAlphaBlock(uint64_t Block, olc::Pixel* OutTexels)
+{
+    uint8_t Palette[8];
+    GetAlphaPalette(static_cast<uint8_t>(Block), static_cast<uint8_t>(Block >> 8), Palette);
+
+    uint64_t Indices = Block >> 16;
+    for (int Index = 0; Index < BlockTexelCount; ++Index)
+    {
+        OutTexels[Index].a = Palette[Indices & 7];
+        Indices >>= 3;
+    }
+}
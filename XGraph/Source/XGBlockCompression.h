@@ -0,0 +1,51 @@
+﻿// XGBlockCompression.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+
+/**
+ * \brief Encodes and decodes 4x4 blocks of texels in the BC1 and BC3 formats
+ * \details A color block stores two endpoint colors as 5:6:5 bits and picks one of four colors on the line between them
+ * for each texel with a 2-bit index, which is 4 bits per texel. BC1 is a color block alone. BC3 adds an alpha block,
+ * which stores two endpoint alphas and a 3-bit index per texel, for 8 bits per texel.
+ *
+ * Blocks are kept in 64-bit words, with the first endpoint in the lowest bits. The texels of a block are numbered row by
+ * row, which is the order XGTexture stores the texels of a block in.
+ */
+struct XGBlockCompression
+{
+    static constexpr int BlockTexelCount = 16;
+
+    /**
+     * \brief Encodes the colors of a block, ignoring their alpha
+     * \param Texels The 16 texels of the block
+     * \param ValidTexelMask One bit per texel, set for the texels that are inside the image. Padding texels past its
+     * edges don't affect the endpoints.
+     */
+    static uint64_t EncodeColorBlock(const olc::Pixel* Texels, uint32_t ValidTexelMask);
+
+    /**
+     * \brief Encodes the alpha of a block
+     * \param Texels The 16 texels of the block
+     * \param ValidTexelMask One bit per texel, set for the texels that are inside the image
+     */
+    static uint64_t EncodeAlphaBlock(const olc::Pixel* Texels, uint32_t ValidTexelMask);
+
+    /**
+     * \brief Decodes the colors of a block into 16 texels
+     * \param IsAlphaAllowed Whether a block whose first endpoint isn't greater than its second uses its last index for
+     * transparent black, as BC1 does. BC3 color blocks always use four colors.
+     */
+    static void DecodeColorBlock(uint64_t Block, bool IsAlphaAllowed, olc::Pixel* OutTexels);
+
+    /**
+     * \brief Decodes the alpha of a block into the alpha of 16 texels whose colors have already been decoded
+     */
+    static void DecodeAlphaBlock(uint64_t Block, olc::Pixel* OutTexels);
+};
@@ -0,0 +1,54 @@
+﻿// XGBoundingBox.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGBoundingBox.h"
+
+#include <algorithm>
+
+void XGBoundingBox::Expand(const XGVector3D& Point)
+{
+    Min.X = std::min(Min.X, Point.X);
+    Min.Y = std::min(Min.Y, Point.Y);
+    Min.Z = std::min(Min.Z, Point.Z);
+    Max.X = std::max(Max.X, Point.X);
+    Max.Y = std::max(Max.Y, Point.Y);
+    Max.Z = std::max(Max.Z, Point.Z);
+}
+
+void XGBoundingBox::Expand(const XGBoundingBox& OtherBox)
+{
+    if (OtherBox.IsValid())
+    {
+        Expand(OtherBox.Min);
+        Expand(OtherBox.Max);
+    }
+}
+
+bool XGBoundingBox::IsValid() const
+{
+    return Min.X <= Max.X && Min.Y <= Max.Y && Min.Z <= Max.Z;
+}
+
+XGVector3D XGBoundingBox::GetCenter() const
+{
+    return (Min + Max) * 0.5f;
+}
+
+XGVector3D XGBoundingBox::GetSize() const
+{
+    return Max - Min;
+}
+
+void XGBoundingBox::GetCorners(XGVector3D OutCorners[8]) const
+{
+    for (int CornerIndex = 0; CornerIndex < 8; ++CornerIndex)
+    {
+        OutCorners[CornerIndex] = {
+            (CornerIndex & 1) ? Max.X : Min.X,
+            (CornerIndex & 2) ? Max.Y : Min.Y,
+            (CornerIndex & 4) ? Max.Z : Min.Z
+        };
+    }
+}
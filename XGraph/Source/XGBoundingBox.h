@@ -0,0 +1,40 @@
+﻿// XGBoundingBox.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include "XGVector3D.h"
+
+/**
+ * \brief An axis-aligned bounding box
+ */
+struct XGBoundingBox
+{
+    XGVector3D Min = { 3.402823466e+38f, 3.402823466e+38f, 3.402823466e+38f };
+    XGVector3D Max = { -3.402823466e+38f, -3.402823466e+38f, -3.402823466e+38f };
+
+    /**
+     * \brief Grows the box so that it contains the given point
+     */
+    void Expand(const XGVector3D& Point);
+
+    /**
+     * \brief Grows the box so that it contains the given box
+     */
+    void Expand(const XGBoundingBox& OtherBox);
+
+    /**
+     * \brief Returns true if at least one point has been added to the box
+     */
+    bool IsValid() const;
+
+    XGVector3D GetCenter() const;
+    XGVector3D GetSize() const;
+
+    /**
+     * \brief Writes the eight corners of the box into the given array
+     */
+    void GetCorners(XGVector3D OutCorners[8]) const;
+};
@@ -0,0 +1,71 @@
+﻿// XGDepthBuffer.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGDepthBuffer.h"
+
+#include <algorithm>
+
+void XGDepthBuffer::Resize(int NewWidth, int NewHeight, XGDepthFormat NewFormat, float NearClipPlane)
+{
+    Layout.Resize(NewWidth, NewHeight);
+    Format = NewFormat;
+
+    switch (Format)
+    {
+    case Unorm16Depth:
+        EncodeScale = NearClipPlane * XGUnorm16DepthTraits::MaxValue;
+        break;
+    case Fixed24Stencil8Depth:
+        EncodeScale = NearClipPlane * XGFixed24Stencil8DepthTraits::MaxValue;
+        break;
+    default:
+        EncodeScale = 1.0f;
+        break;
+    }
+
+    // Swap with a new vector rather than calling assign, so switching to a smaller format gives the memory back
+    std::vector<uint32_t>(GetWordCount(), 0u).swap(Storage);
+}
+
+void XGDepthBuffer::SetSize(int NewWidth, int NewHeight)
+{
+    Layout.Resize(NewWidth, NewHeight);
+
+    const size_t WordCount = GetWordCount();
+    if (WordCount > Storage.size())
+    {
+        Storage.resize(WordCount);
+    }
+}
+
+void XGDepthBuffer::Release()
+{
+    std::vector<uint32_t>().swap(Storage);
+    Layout.Resize(0, 0);
+}
+
+void XGDepthBuffer::Clear()
+{
+    // Zero is infinitely far away in every format. Words past the current size are left alone.
+    std::fill(Storage.begin(), Storage.begin() + GetWordCount(), 0u);
+}
+
+size_t XGDepthBuffer::GetBytesPerPixel(XGDepthFormat DepthFormat)
+{
+    switch (DepthFormat)
+    {
+    case Unorm16Depth:
+        return sizeof(XGUnorm16DepthTraits::ValueType);
+    case Fixed24Stencil8Depth:
+        return sizeof(XGFixed24Stencil8DepthTraits::ValueType);
+    default:
+        return sizeof(XGFloat32DepthTraits::ValueType);
+    }
+}
+
+size_t XGDepthBuffer::GetWordCount() const
+{
+    return (Layout.GetPaddedPixelCount() * GetBytesPerPixel(Format) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+}
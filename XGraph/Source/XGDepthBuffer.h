@@ -0,0 +1,170 @@
+﻿// XGDepthBuffer.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "XGTileLayout.h"
+
+/**
+ * \brief The ways the depth buffer can store the depth of each pixel
+ */
+enum XGDepthFormat
+{
+    /**
+     * \brief 1/W as a 32-bit float. The most precise format.
+     */
+    Float32Depth,
+
+    /**
+     * \brief Near/W as a 16-bit normalized integer. Half the bandwidth of the other formats, but distant surfaces that
+     * are close together may fight.
+     */
+    Unorm16Depth,
+
+    /**
+     * \brief Near/W as a 24-bit fixed point number in the low bits of a 32-bit word. The top 8 bits are left alone by
+     * depth writes, so they can hold a stencil value or a tag.
+     */
+    Fixed24Stencil8Depth
+};
+
+/**
+ * \brief Depth test and write for the Float32Depth format
+ * \details Every format's traits have the same members, so the rasterizer can be specialized on them. Encode turns
+ * the interpolated 1/W of a pixel into a stored value, IsCloser tests an encoded value against the stored one, and
+ * Write stores an encoded value. A stored value of zero is infinitely far away in every format.
+ */
+struct XGFloat32DepthTraits
+{
+    using ValueType = float;
+
+    static ValueType Encode(float InvW, float /*EncodeScale*/) { return InvW; }
+
+    // 1/W is negative in front of the camera, so smaller values are closer
+    static bool IsCloser(ValueType Value, ValueType StoredValue) { return Value < StoredValue; }
+
+    static void Write(ValueType& StoredValue, ValueType Value) { StoredValue = Value; }
+};
+
+/**
+ * \brief Depth test and write for the Unorm16Depth format
+ */
+struct XGUnorm16DepthTraits
+{
+    using ValueType = uint16_t;
+    static constexpr float MaxValue = 65535.0f;
+
+    // Near/W is 1 at the near clip plane and falls towards 0 with distance, so larger values are closer. Interpolation
+    // can overshoot the near plane slightly, so the value is clamped.
+    static ValueType Encode(float InvW, float EncodeScale)
+    {
+        const float Value = -InvW * EncodeScale;
+        return static_cast<ValueType>(std::fmin(Value, MaxValue));
+    }
+
+    static bool IsCloser(ValueType Value, ValueType StoredValue) { return Value > StoredValue; }
+
+    static void Write(ValueType& StoredValue, ValueType Value) { StoredValue = Value; }
+};
+
+/**
+ * \brief Depth test and write for the Fixed24Stencil8Depth format
+ */
+struct XGFixed24Stencil8DepthTraits
+{
+    using ValueType = uint32_t;
+    static constexpr float MaxValue = 16777215.0f;
+    static constexpr uint32_t DepthMask = 0x00FFFFFFu;
+
+    static ValueType Encode(float InvW, float EncodeScale)
+    {
+        const float Value = -InvW * EncodeScale;
+        return static_cast<ValueType>(std::fmin(Value, MaxValue));
+    }
+
+    static bool IsCloser(ValueType Value, ValueType StoredValue) { return Value > (StoredValue & DepthMask); }
+
+    static void Write(ValueType& StoredValue, ValueType Value) { StoredValue = (StoredValue & ~DepthMask) | Value; }
+};
+
+/**
+ * \brief The depth of the closest surface drawn so far at each pixel of the screen, in one of several formats
+ * \details Pixels are stored in 8x8 tiles, so they are found through the layout returned by GetLayout.
+ */
+class XGDepthBuffer
+{
+public:
+    /**
+     * \brief Reallocates the buffer. Its contents are cleared.
+     * \param NewWidth The width of the buffer in pixels
+     * \param NewHeight The height of the buffer in pixels
+     * \param NewFormat How depth values are stored
+     * \param NearClipPlane The distance of the near clip plane from the camera. The fixed point formats store depth
+     * relative to it.
+     */
+    void Resize(int NewWidth, int NewHeight, XGDepthFormat NewFormat, float NearClipPlane);
+
+    /**
+     * \brief Changes the size of the buffer and keeps its format. Memory is only reallocated when the buffer has to
+     * grow past the largest size it has had, so the size can change every frame. Its contents are undefined afterwards.
+     */
+    void SetSize(int NewWidth, int NewHeight);
+
+    /**
+     * \brief Frees the buffer
+     */
+    void Release();
+
+    /**
+     * \brief Sets every pixel to infinitely far away, and every stencil value to zero
+     */
+    void Clear();
+
+    int GetWidth() const { return Layout.Width; }
+    int GetHeight() const { return Layout.Height; }
+    const XGTileLayout& GetLayout() const { return Layout; }
+    XGDepthFormat GetFormat() const { return Format; }
+
+    /**
+     * \brief The factor passed to the format's Encode function
+     */
+    float GetEncodeScale() const { return EncodeScale; }
+
+    size_t GetMemoryUsage() const { return Storage.capacity() * sizeof(uint32_t); }
+
+    /**
+     * \brief The number of bytes each pixel uses in the given format
+     */
+    static size_t GetBytesPerPixel(XGDepthFormat DepthFormat);
+
+    /**
+     * \brief Returns the first pixel of the buffer. DepthTraits must match the buffer's format.
+     */
+    template <typename DepthTraits>
+    typename DepthTraits::ValueType* GetPixels()
+    {
+        return reinterpret_cast<typename DepthTraits::ValueType*>(Storage.data());
+    }
+
+private:
+    XGTileLayout Layout;
+    XGDepthFormat Format = Float32Depth;
+    float EncodeScale = 1.0f;
+
+    /**
+     * \brief The pixels of every format are packed into 32-bit words, which are aligned well enough for all of them
+     */
+    std::vector<uint32_t> Storage;
+
+    /**
+     * \brief The number of words the current size and format need
+     */
+    size_t GetWordCount() const;
+};
@@ -6,10 +6,15 @@
 #include "XGEngine.h"
 
 #include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
 #include <string>
 #include "XGTriangle.h"
+#include "XGVertexCacheOptimizer.h"
 
 XGEngine::XGEngine(const std::string& MeshFilePath, const std::string& TextureFilePath, bool InvertUVMapping)
+    : TextureToRenderPath(TextureFilePath)
 {
     if (!MeshFilePath.empty())
     {
@@ -19,7 +24,7 @@ XGEngine::XGEngine(const std::string& MeshFilePath, const std::string& TextureFi
     else
     {
         // Create a unit cube to render
-        MeshToRender.Triangles = {
+        const XGTriangle CubeTriangles[] = {
             // South face
             XGTriangle(
                 { 0.0f, 0.0f, 0.0f },
@@ -123,18 +128,107 @@ XGEngine::XGEngine(const std::string& MeshFilePath, const std::string& TextureFi
                 { 1.0f, 1.0f }
             )
         };
+
+        for (const XGTriangle& Triangle : CubeTriangles)
+        {
+            MeshToRender.AddTriangle(Triangle);
+        }
+        MeshToRender.ComputeBounds();
     }
 
-    if (!TextureFilePath.empty())
+    // Split the mesh into clusters, so parts of it that are hidden or off screen can be culled as a unit, then order
+    // the triangles of each cluster so their shared vertices are transformed as few times as possible
+    MeshToRender.BuildClusters();
+    MeshToRender.OptimizeVertexCache();
+
+    // Within each cluster, draw the triangles most likely to hide the others first, so the depth test rejects more of
+    // the hidden pixels before they are textured
+    MeshToRender.OptimizeOverdraw();
+}
+
+bool XGEngine::LoadTexture(XGTexture& Texture, const std::string& FilePath)
+{
+    // Textures are made to tile
+    if (ShouldLoadTexturesAsync)
     {
-        TextureToRender = new olc::Sprite();
-        if (TextureToRender->LoadFromFile(TextureFilePath) != olc::OK)
+        TextureLoader.Load(Texture, FilePath, RepeatWrap, TextureFormat);
+    }
+    else
+    {
+        if (!Texture.LoadFromFile(FilePath))
         {
-            std::cout << "ERROR: Failed to load texture at path: " << TextureFilePath << std::endl;
+            return false;
+        }
+
+        Texture.SetWrap(RepeatWrap);
+        Texture.Compress(TextureFormat);
+    }
+
+    TextureResidency.Register(Texture, FilePath);
+    return true;
+}
+
+void XGEngine::LoadMaterialTextures()
+{
+    TexturesByMaterial.assign(MeshToRender.Materials.size(), TextureToRender);
+    for (size_t MaterialIndex = 0; MaterialIndex < MeshToRender.Materials.size(); ++MaterialIndex)
+    {
+        const std::string& TexturePath = MeshToRender.Materials[MaterialIndex].DiffuseTexturePath;
+        if (TexturePath.empty())
+        {
+            continue;
         }
+
+        // Materials often share textures, so only load each file once
+        const auto LoadedMaterial = std::find_if(
+            MeshToRender.Materials.begin(),
+            MeshToRender.Materials.begin() + MaterialIndex,
+            [&](const XGMaterial& Material) { return Material.DiffuseTexturePath == TexturePath; }
+        );
+        if (LoadedMaterial != MeshToRender.Materials.begin() + MaterialIndex)
+        {
+            TexturesByMaterial[MaterialIndex] = TexturesByMaterial[LoadedMaterial - MeshToRender.Materials.begin()];
+            continue;
+        }
+
+        XGTexture* Texture = new XGTexture();
+        if (!LoadTexture(*Texture, TexturePath))
+        {
+            std::cout << "ERROR: Failed to load texture at path: " << TexturePath << std::endl;
+            delete Texture;
+            continue;
+        }
+
+        MaterialTextures.push_back(Texture);
+        TexturesByMaterial[MaterialIndex] = Texture;
+    }
+}
+
+void XGEngine::LoadLightmap()
+{
+    if (!LightmapFilePath.empty() && Lightmap.LoadFromFile(LightmapFilePath, MeshToRender))
+    {
+        return;
+    }
+
+    // The light direction is baked in model space, which matches world space for instances that aren't rotated
+    if (!Lightmap.Bake(MeshToRender, LightDirection, LightmapBakeSettings))
+    {
+        std::cout << "ERROR: Failed to bake lightmap" << std::endl;
+        return;
+    }
+
+    if (!LightmapFilePath.empty() && !Lightmap.SaveToFile(LightmapFilePath))
+    {
+        std::cout << "ERROR: Failed to save lightmap at path: " << LightmapFilePath << std::endl;
     }
 }
 
+XGEngine::~XGEngine()
+{
+    ReleaseBuffers();
+}
+
 bool XGEngine::OnUserCreate()
 {
     // Create perspective projection matrix
@@ -154,19 +248,86 @@ bool XGEngine::OnUserCreate()
     LightDirection.Normalize();
 
     // Initialize the depth buffer
-    const unsigned long long BufferSize = static_cast<unsigned long long>(ScreenWidth()) * static_cast<unsigned long long>(ScreenHeight());
-    DepthBuffer = new float[BufferSize];
+    DepthBuffer.Resize(ScreenWidth(), ScreenHeight(), DepthFormat, NearClipPlane);
+
+    // Initialize the render target filled triangles are drawn into
+    RenderTarget.Resize(ScreenWidth(), ScreenHeight());
+    RenderWidth = ScreenWidth();
+    RenderHeight = ScreenHeight();
+    ResolutionGovernor.Reset(ScreenWidth(), ScreenHeight());
+
+    // Initialize the occlusion buffer
+    OcclusionBuffer.Resize(OcclusionBufferWidth, OcclusionBufferHeight);
+
+    // Shrink the mesh's vertices now that nothing else needs them at full precision
+    if (ShouldQuantizeMesh && !MeshToRender.IsQuantized())
+    {
+        MeshToRender.Quantize();
+    }
+
+    // Load the textures now that the settings for how they are loaded and stored are final
+    if (!TextureToRenderPath.empty())
+    {
+        TextureToRender = new XGTexture();
+        if (!LoadTexture(*TextureToRender, TextureToRenderPath))
+        {
+            // An empty texture has nothing to sample, so the mesh is drawn untextured instead
+            std::cout << "ERROR: Failed to load texture at path: " << TextureToRenderPath << std::endl;
+            delete TextureToRender;
+            TextureToRender = nullptr;
+        }
+    }
+
+    LoadMaterialTextures();
+
+    // The lightmap maps the mesh's triangles in their final order, so it is loaded once the mesh won't change again
+    if (ShouldUseLightmap)
+    {
+        LoadLightmap();
+    }
+
+    UpdateMemoryUsage();
     
     return true;
 }
 
 bool XGEngine::OnUserUpdate(float fElapsedTime)
 {
+    using Clock = std::chrono::high_resolution_clock;
+    using Milliseconds = std::chrono::duration<float, std::milli>;
+    const Clock::time_point FrameStartTime = Clock::now();
+
+    // Everything allocated from the arena during the last frame is done with
+    FrameArena.Reset();
+
+    // Swap in the textures that have finished loading, so the whole frame is drawn with the same textures
+    TextureLoader.PublishLoadedTextures();
+
+    // Drop the texture levels that haven't been drawn lately if the textures are over budget, and reload the ones whose
+    // dropped levels are wanted again
+    TextureResidency.Update(TextureLoader, MemoryTracker.GetBudget(TextureMemory));
+
+    // Start loading the pages of virtual textures that the last frame needed, and publish the ones that have loaded
+    if (TextureToRender != nullptr)
+    {
+        TextureToRender->UpdatePages();
+    }
+
+    for (XGTexture* Texture : MaterialTextures)
+    {
+        Texture->UpdatePages();
+    }
+
+    // Filled triangles are drawn into the render target, which can be smaller than the screen and is scaled up when it
+    // is resolved. The buffers keep the memory of the largest size they have had, so this doesn't allocate.
+    const bool IsResolutionScaled = ShouldScaleResolution && RenderMode != Wireframe;
+    RenderWidth = IsResolutionScaled ? ResolutionGovernor.GetWidth() : ScreenWidth();
+    RenderHeight = IsResolutionScaled ? ResolutionGovernor.GetHeight() : ScreenHeight();
+    RenderTarget.SetSize(RenderWidth, RenderHeight);
+    DepthBuffer.SetSize(RenderWidth, RenderHeight);
+
     ProcessKeyboardInput(fElapsedTime);
 
-    // Move the mesh out in front of the camera
-    const XGMatrix4x4 WorldMatrix = XGMatrix4x4::Translation({ 0.0f, 0.0f, 5.0f });
-    
     // Calculate the camera's look direction based on the current yaw value
     const XGVector3D DefaultCameraLookDirection = { 0.0f, 0.0f, 1.0f };
     CameraLookDirection = XGMatrix4x4::RotationY(CameraYaw) * DefaultCameraLookDirection;
@@ -177,43 +338,204 @@ bool XGEngine::OnUserUpdate(float fElapsedTime)
     XGMatrix4x4 ViewMatrix = XGMatrix4x4::PointAt(CameraPosition, CameraTarget, CameraUp);
     ViewMatrix = ViewMatrix.QuickInverse();
 
-    std::vector<XGTriangle> TrianglesToDraw;
-    TransformAndProjectTriangles(
+    // Bring the world matrices of scene nodes that moved up to date, and move the instances attached to them
+    SceneGraph.UpdateWorldMatrices();
+    for (XGMeshInstance& Instance : MeshInstances)
+    {
+        if (Instance.SceneNode >= 0)
+        {
+            Instance.WorldMatrix = SceneGraph.GetWorldMatrix(Instance.SceneNode);
+        }
+    }
+
+    // Unless instances of the mesh have been placed in the world, draw it once, moved out in front of the camera
+    XGMeshInstance DefaultInstance;
+    DefaultInstance.WorldMatrix = XGMatrix4x4::Translation({ 0.0f, 0.0f, 5.0f });
+
+    const XGMeshInstance* Instances = &DefaultInstance;
+    size_t InstanceCount = 1;
+    if (!MeshInstances.empty())
+    {
+        Instances = MeshInstances.data();
+        InstanceCount = MeshInstances.size();
+    }
+
+    // Start with room for as many triangles as the last frame had, so the arrays rarely have to grow
+    XGFrameArray<XGScreenTriangle> TrianglesToDraw(FrameArena, LastFrameTriangleCount);
+    XGFrameArray<uint32_t> TriangleMaterials(FrameArena, LastFrameTriangleCount);
+    XGFrameArray<uint32_t> SourceTriangles(FrameArena, Lightmap.IsEmpty() ? 0 : LastFrameTriangleCount);
+    SubmitMeshInstances(
         MeshToRender,
-        WorldMatrix,
+        Instances,
+        InstanceCount,
         ViewMatrix,
-        TrianglesToDraw
+        TrianglesToDraw,
+        TriangleMaterials,
+        SourceTriangles
     );
+    LastFrameTriangleCount = TrianglesToDraw.GetSize();
 
-    // Sort the triangles from farthest away from the camera to closest if we're in FlatShaded mode.
-    // The depth buffer handles draw order issues in textured mode, and it doesn't matter in wireframe mode.
-    if (RenderMode == FlatShaded)
+    // Clear screen to black. Filled triangles are drawn into the render target, which covers the whole screen once it
+    // is resolved, so only it has to be cleared in those modes. The depth buffer takes care of draw order, so the
+    // triangles don't need to be sorted.
+    const XGSortEntry* DrawOrder = nullptr;
+    if (RenderMode == Wireframe)
     {
-        std::sort(TrianglesToDraw.begin(), TrianglesToDraw.end(), [](const XGTriangle& Triangle1, const XGTriangle& Triangle2)
-        {
-            // Get the midpoint in the Z axis of the triangles
-            const float Depth1 = (Triangle1.Points[0].Z + Triangle1.Points[1].Z + Triangle1.Points[2].Z) / 3.0f;
-            const float Depth2 = (Triangle2.Points[0].Z + Triangle2.Points[1].Z + Triangle2.Points[2].Z) / 3.0f;
-    
-            return Depth1 < Depth2;
-        });
+        FillRect(0, 0, ScreenWidth(), ScreenHeight(), olc::BLACK);
     }
+    else if (IsUsingSpanBuffer())
+    {
+        // Shading the spans writes every pixel of the render target, so nothing has to be cleared. A span is rejected
+        // soonest when the spans in front of it are already in the buffer, so the triangles are sorted front to back.
+        // Smaller sums of 1/W are closer.
+        const size_t TriangleCount = TrianglesToDraw.GetSize();
+        XGSortEntry* SortEntries = FrameArena.AllocateArray<XGSortEntry>(TriangleCount);
+        XGSortEntry* SortScratch = FrameArena.AllocateArray<XGSortEntry>(TriangleCount);
+        for (size_t TriangleIndex = 0; TriangleIndex < TriangleCount; ++TriangleIndex)
+        {
+            const XGScreenTriangle& Triangle = TrianglesToDraw[TriangleIndex];
+            const float Depth = Triangle.Vertices[0].InvW + Triangle.Vertices[1].InvW + Triangle.Vertices[2].InvW;
+            SortEntries[TriangleIndex] = { XGRadixSort::FloatToKey(Depth), static_cast<uint32_t>(TriangleIndex) };
+        }
 
-    // Clear screen to black
-    FillRect(0, 0, ScreenWidth(), ScreenHeight(), olc::BLACK);
+        XGRadixSort::Sort(SortEntries, SortScratch, TriangleCount);
+        DrawOrder = SortEntries;
 
-    // Clear the depth buffer
-    for (int i = 0; i < ScreenWidth() * ScreenHeight(); ++i)
+        // Triangles are clipped to the last column, and spans stop just before their right edge, so no span ever
+        // reaches the last column
+        SpanBuffer.Reset(RenderWidth - 1, RenderHeight);
+    }
+    else
     {
-        DepthBuffer[i] = 0.0f;
+        RenderTarget.Clear(olc::BLACK);
+        DepthBuffer.Clear();
+
+        // Draw the triangles of one material after another, so each texture is only brought into the cache once. The
+        // sort keeps the order of triangles with the same material, so each material is still drawn front to back.
+        if (ShouldSortByMaterial && MeshToRender.MaterialGroups.size() > 1)
+        {
+            const size_t TriangleCount = TrianglesToDraw.GetSize();
+            XGSortEntry* SortEntries = FrameArena.AllocateArray<XGSortEntry>(TriangleCount);
+            XGSortEntry* SortScratch = FrameArena.AllocateArray<XGSortEntry>(TriangleCount);
+            for (size_t TriangleIndex = 0; TriangleIndex < TriangleCount; ++TriangleIndex)
+            {
+                SortEntries[TriangleIndex] = { TriangleMaterials[TriangleIndex], static_cast<uint32_t>(TriangleIndex) };
+            }
+
+            XGRadixSort::Sort(SortEntries, SortScratch, TriangleCount);
+            DrawOrder = SortEntries;
+        }
     }
 
     // Clip and rasterize the triangles
-    ClipAndRasterizeTriangles(TrianglesToDraw);
+    ClipAndRasterizeTriangles(TrianglesToDraw, TriangleMaterials, SourceTriangles, DrawOrder);
+
+    if (IsResolutionScaled)
+    {
+        ResolutionGovernor.Update(Milliseconds(Clock::now() - FrameStartTime).count());
+    }
+
+    UpdateMemoryUsage();
+    if (ShouldDrawMemoryOverlay)
+    {
+        DrawMemoryOverlay();
+    }
     
     return true;
 }
 
+bool XGEngine::OnUserDestroy()
+{
+    ReleaseBuffers();
+    return true;
+}
+
+void XGEngine::UpdateMemoryUsage()
+{
+    MemoryTracker.SetBufferSize(MeshMemory, &MeshToRender, MeshToRender.GetMemoryUsage());
+    MemoryTracker.SetBufferSize(
+        TextureMemory,
+        &TextureToRender,
+        TextureToRender != nullptr ? TextureToRender->GetMemoryUsage() : 0
+    );
+    for (const XGTexture* Texture : MaterialTextures)
+    {
+        MemoryTracker.SetBufferSize(TextureMemory, Texture, Texture->GetMemoryUsage());
+    }
+    MemoryTracker.SetBufferSize(TextureMemory, &Lightmap, Lightmap.GetMemoryUsage());
+    MemoryTracker.SetBufferSize(ColorBufferMemory, &RenderTarget, RenderTarget.GetMemoryUsage());
+    MemoryTracker.SetBufferSize(DepthBufferMemory, &DepthBuffer, DepthBuffer.GetMemoryUsage());
+    MemoryTracker.SetBufferSize(OcclusionBufferMemory, &OcclusionBuffer, OcclusionBuffer.GetMemoryUsage());
+    MemoryTracker.SetBufferSize(FrameScratchMemory, &FrameArena, FrameArena.GetReservedBytes());
+    MemoryTracker.SetBufferSize(FrameScratchMemory, &SpanBuffer, SpanBuffer.GetMemoryUsage());
+    MemoryTracker.SetBufferSize(SceneMemory, &SceneGraph, SceneGraph.GetMemoryUsage());
+    MemoryTracker.SetBufferSize(SceneMemory, &MeshInstances, MeshInstances.capacity() * sizeof(XGMeshInstance));
+}
+
+void XGEngine::DrawMemoryOverlay()
+{
+    constexpr int LineHeight = 10;
+    char Line[96];
+    int Y = 2;
+
+    for (int Category = 0; Category < MemoryCategoryCount; ++Category)
+    {
+        const XGMemoryCategory MemoryCategory = static_cast<XGMemoryCategory>(Category);
+        const bool IsOverBudget = MemoryTracker.GetBudget(MemoryCategory) > 0 &&
+            MemoryTracker.GetCurrentBytes(MemoryCategory) > MemoryTracker.GetBudget(MemoryCategory);
+
+        snprintf(
+            Line,
+            sizeof(Line),
+            "%-16s %9.1f KB  peak %9.1f KB",
+            XGMemoryTracker::GetCategoryName(MemoryCategory),
+            static_cast<double>(MemoryTracker.GetCurrentBytes(MemoryCategory)) / 1024.0,
+            static_cast<double>(MemoryTracker.GetHighWaterBytes(MemoryCategory)) / 1024.0
+        );
+        DrawString(2, Y, Line, IsOverBudget ? olc::RED : olc::WHITE);
+        Y += LineHeight;
+    }
+
+    snprintf(
+        Line,
+        sizeof(Line),
+        "%-16s %9.1f KB  peak %9.1f KB",
+        "Total",
+        static_cast<double>(MemoryTracker.GetTotalBytes()) / 1024.0,
+        static_cast<double>(MemoryTracker.GetTotalHighWaterBytes()) / 1024.0
+    );
+    DrawString(2, Y, Line, olc::YELLOW);
+}
+
+void XGEngine::ReleaseBuffers()
+{
+    RenderTarget.Release();
+    DepthBuffer.Release();
+
+    // Neither the loader nor the residency manager may hold on to any of the textures when they are deleted
+    TextureLoader.Stop();
+    TextureResidency.Clear();
+
+    delete TextureToRender;
+    TextureToRender = nullptr;
+
+    for (XGTexture* Texture : MaterialTextures)
+    {
+        MemoryTracker.SetBufferSize(TextureMemory, Texture, 0);
+        delete Texture;
+    }
+    MaterialTextures.clear();
+    TexturesByMaterial.clear();
+    Lightmap.Release();
+
+    UpdateMemoryUsage();
+}
+
+bool XGEngine::CompareSortEntries(const XGSortEntry& Entry1, const XGSortEntry& Entry2)
+{
+    return Entry1.Key != Entry2.Key ? Entry1.Key < Entry2.Key : Entry1.Index < Entry2.Index;
+}
+
 olc::Pixel XGEngine::CreateGrayscaleColor(const float& Brightness)
 {
     return olc::PixelF(Brightness, Brightness, Brightness, 1.0f);
@@ -262,25 +584,212 @@ void XGEngine::ProcessKeyboardInput(const float& SecondsElapsedThisFrame)
     {
         CameraYaw += 2.0f * SecondsElapsedThisFrame;
     }
+
+    if (GetKey(olc::M).bPressed)
+    {
+        ShouldDrawMemoryOverlay = !ShouldDrawMemoryOverlay;
+    }
+
+    // Switch between the depth buffer and the span buffer, to compare them
+    if (GetKey(olc::B).bPressed)
+    {
+        ShouldUseSpanBuffer = !ShouldUseSpanBuffer;
+    }
+
+    // Cycle through the texture filters
+    if (GetKey(olc::T).bPressed)
+    {
+        TextureFilter = static_cast<XGTextureFilter>((TextureFilter + 1) % (TrilinearFilter + 1));
+    }
+}
+
+void XGEngine::SubmitMeshInstances(
+        const XGMesh& Mesh,
+        const XGMeshInstance* Instances,
+        size_t InstanceCount,
+        const XGMatrix4x4& ViewMatrix,
+        XGFrameArray<XGScreenTriangle>& OutProjectedTriangles,
+        XGFrameArray<uint32_t>& OutTriangleMaterials,
+        XGFrameArray<uint32_t>& OutSourceTriangles)
+{
+    OcclusionStats = XGOcclusionStats();
+    OcclusionBuffer.Clear();
+
+    // Cull whole instances using the bounds of the mesh they share
+    XGFrameArray<XGSortEntry> SortedInstances(FrameArena, InstanceCount);
+    for (size_t InstanceIndex = 0; InstanceIndex < InstanceCount; ++InstanceIndex)
+    {
+        const XGMatrix4x4 WorldViewMatrix = Instances[InstanceIndex].WorldMatrix * ViewMatrix;
+        if (!IsInsideViewFrustum(Mesh.Bounds, WorldViewMatrix))
+        {
+            continue;
+        }
+
+        const XGVector3D ViewCenter = WorldViewMatrix * Mesh.Bounds.GetCenter();
+        SortedInstances.Add({ XGRadixSort::FloatToKey(ViewCenter.Z), static_cast<uint32_t>(InstanceIndex) });
+    }
+
+    // Submit the closest instances first, so they can occlude the instances behind them, and so the depth test can
+    // reject the hidden pixels of the instances behind them before they are textured
+    std::sort(SortedInstances.begin(), SortedInstances.end(), CompareSortEntries);
+
+    for (const XGSortEntry& SortedInstance : SortedInstances)
+    {
+        const XGMeshInstance& Instance = Instances[SortedInstance.Index];
+        if (!Mesh.Clusters.empty())
+        {
+            CullAndTransformClusters(
+                Mesh,
+                Instance.WorldMatrix,
+                ViewMatrix,
+                Instance.Tint,
+                OutProjectedTriangles,
+                OutTriangleMaterials,
+                OutSourceTriangles
+            );
+        }
+        else if (!Mesh.MaterialGroups.empty())
+        {
+            for (const XGMeshCluster& MaterialGroup : Mesh.MaterialGroups)
+            {
+                TransformAndProjectTriangles(
+                    Mesh,
+                    MaterialGroup.FirstTriangle,
+                    MaterialGroup.TriangleCount,
+                    MaterialGroup.MaterialIndex,
+                    Instance.WorldMatrix,
+                    ViewMatrix,
+                    Instance.Tint,
+                    OutProjectedTriangles,
+                    OutTriangleMaterials,
+                    OutSourceTriangles
+                );
+            }
+        }
+        else
+        {
+            TransformAndProjectTriangles(
+                Mesh,
+                0,
+                static_cast<unsigned int>(Mesh.GetTriangleCount()),
+                0,
+                Instance.WorldMatrix,
+                ViewMatrix,
+                Instance.Tint,
+                OutProjectedTriangles,
+                OutTriangleMaterials,
+                OutSourceTriangles
+            );
+        }
+    }
+}
+
+bool XGEngine::IsInsideViewFrustum(const XGBoundingBox& Bounds, const XGMatrix4x4& WorldViewMatrix) const
+{
+    XGVector3D Corners[8];
+    Bounds.GetCorners(Corners);
+
+    int CornersInFrontOfNearPlane = 0;
+    int CornersLeftOfView = 0;
+    int CornersRightOfView = 0;
+    int CornersBelowView = 0;
+    int CornersAboveView = 0;
+
+    for (const XGVector3D& Corner : Corners)
+    {
+        const XGVector3D ViewCorner = WorldViewMatrix * Corner;
+        const XGVector3D ProjectedCorner = ProjectionMatrix * ViewCorner;
+
+        // The side planes of the frustum pass through the camera, so before the perspective divide, a point is inside
+        // them when its projected X and Y are between -Z and Z
+        CornersInFrontOfNearPlane += ViewCorner.Z < NearClipPlane ? 1 : 0;
+        CornersLeftOfView += ProjectedCorner.X < -ViewCorner.Z ? 1 : 0;
+        CornersRightOfView += ProjectedCorner.X > ViewCorner.Z ? 1 : 0;
+        CornersBelowView += ProjectedCorner.Y < -ViewCorner.Z ? 1 : 0;
+        CornersAboveView += ProjectedCorner.Y > ViewCorner.Z ? 1 : 0;
+    }
+
+    // The box is only outside the frustum if all of its corners are outside the same plane
+    return CornersInFrontOfNearPlane < 8 &&
+        CornersLeftOfView < 8 &&
+        CornersRightOfView < 8 &&
+        CornersBelowView < 8 &&
+        CornersAboveView < 8;
 }
 
 void XGEngine::TransformAndProjectTriangles(
         const XGMesh& Mesh,
+        unsigned int FirstTriangle,
+        unsigned int TriangleCount,
+        unsigned int MaterialIndex,
         const XGMatrix4x4& WorldMatrix,
         const XGMatrix4x4& ViewMatrix,
-        std::vector<XGTriangle>& OutProjectedTriangles)
+        const olc::Pixel& Tint,
+        XGFrameArray<XGScreenTriangle>& OutProjectedTriangles,
+        XGFrameArray<uint32_t>& OutTriangleMaterials,
+        XGFrameArray<uint32_t>& OutSourceTriangles)
 {
-    OutProjectedTriangles.clear();
-    
-    for (const XGTriangle& Triangle : Mesh.Triangles)
-    {
-        XGTriangle TransformedTriangle = {
-            WorldMatrix * Triangle.Points[0],
-            WorldMatrix * Triangle.Points[1],
-            WorldMatrix * Triangle.Points[2],
-            Triangle.TextureCoordinates[0],
-            Triangle.TextureCoordinates[1],
-            Triangle.TextureCoordinates[2],
+    // The material's color tints its triangles the same way the instance's tint does
+    const olc::Pixel MaterialTint = MaterialIndex < Mesh.Materials.size()
+        ? Mesh.Materials[MaterialIndex].DiffuseColor * Tint
+        : Tint;
+
+    // Vertices are shared by several neighbouring triangles, so keep the most recently transformed ones around. The
+    // cache is direct mapped, which works well because the mesh's vertices are numbered in the order they are used.
+    unsigned int CachedVertexIndices[XGPostTransformCacheSize];
+    XGVector3D CachedWorldPositions[XGPostTransformCacheSize];
+    XGVector3D CachedViewPositions[XGPostTransformCacheSize];
+    std::fill(CachedVertexIndices, CachedVertexIndices + XGPostTransformCacheSize, 0xFFFFFFFF);
+
+    // Quantized positions are decoded by the same matrix multiply that moves them into world space
+    const bool IsQuantized = Mesh.IsQuantized();
+
+    // The lightmap maps each mesh triangle on its own, so the triangles clipped from one need to know which it was
+    const bool IsLightmapped = !Lightmap.IsEmpty();
+    const XGMatrix4x4 ModelToWorldMatrix = IsQuantized ? Mesh.DequantizationMatrix * WorldMatrix : WorldMatrix;
+
+    for (unsigned int TriangleIndex = FirstTriangle; TriangleIndex < FirstTriangle + TriangleCount; ++TriangleIndex)
+    {
+        XGVector3D WorldPoints[3];
+        XGVector3D ViewPoints[3];
+        XGVector2D TextureCoordinates[3];
+        for (int PointIndex = 0; PointIndex < 3; ++PointIndex)
+        {
+            const unsigned int VertexIndex = Mesh.Indices[TriangleIndex * 3 + PointIndex];
+            const unsigned int CacheSlot = VertexIndex % XGPostTransformCacheSize;
+            if (CachedVertexIndices[CacheSlot] != VertexIndex)
+            {
+                XGVector3D ModelPosition;
+                if (IsQuantized)
+                {
+                    const XGQuantizedVertex& QuantizedVertex = Mesh.QuantizedVertices[VertexIndex];
+                    ModelPosition = {
+                        static_cast<float>(QuantizedVertex.Position[0]),
+                        static_cast<float>(QuantizedVertex.Position[1]),
+                        static_cast<float>(QuantizedVertex.Position[2])
+                    };
+                }
+                else
+                {
+                    ModelPosition = Mesh.Vertices[VertexIndex].Position;
+                }
+
+                CachedVertexIndices[CacheSlot] = VertexIndex;
+                CachedWorldPositions[CacheSlot] = ModelToWorldMatrix * ModelPosition;
+                CachedViewPositions[CacheSlot] = ViewMatrix * CachedWorldPositions[CacheSlot];
+            }
+
+            WorldPoints[PointIndex] = CachedWorldPositions[CacheSlot];
+            ViewPoints[PointIndex] = CachedViewPositions[CacheSlot];
+            TextureCoordinates[PointIndex] = IsQuantized
+                ? Mesh.DecodeTextureCoordinate(Mesh.QuantizedVertices[VertexIndex])
+                : Mesh.Vertices[VertexIndex].TextureCoordinate;
+        }
+
+        const XGTriangle TransformedTriangle = {
+            WorldPoints[0],
+            WorldPoints[1],
+            WorldPoints[2]
         };
         
         XGVector3D Normal = TransformedTriangle.GetNormal();
@@ -299,14 +808,14 @@ void XGEngine::TransformAndProjectTriangles(
             continue;
         }
 
-        // Project the triangle from world space to view space
+        // The triangle's points were already projected from world space to view space along with its vertices
         const XGTriangle ViewedTriangle = {
-            ViewMatrix * TransformedTriangle.Points[0],
-            ViewMatrix * TransformedTriangle.Points[1],
-            ViewMatrix * TransformedTriangle.Points[2],
-            TransformedTriangle.TextureCoordinates[0],
-            TransformedTriangle.TextureCoordinates[1],
-            TransformedTriangle.TextureCoordinates[2],
+            ViewPoints[0],
+            ViewPoints[1],
+            ViewPoints[2],
+            TextureCoordinates[0],
+            TextureCoordinates[1],
+            TextureCoordinates[2],
         };
 
         // Clip the triangle in view space against the near clip plane
@@ -321,110 +830,260 @@ void XGEngine::TransformAndProjectTriangles(
 
         for (int i = 0; i < ClippedTriangleCount; ++i)
         {
-            // Project the triangle from view space to an intermediate screen space
-            XGTriangle ProjectedTriangle = {
-                ProjectionMatrix * ClippedTriangles[i].Points[0],
-                ProjectionMatrix * ClippedTriangles[i].Points[1],
-                ProjectionMatrix * ClippedTriangles[i].Points[2],
-                ClippedTriangles[i].TextureCoordinates[0],
-                ClippedTriangles[i].TextureCoordinates[1],
-                ClippedTriangles[i].TextureCoordinates[2],
-            };
-
-            // Update the texture coordinates to respect projected depth
-            
-            ProjectedTriangle.TextureCoordinates[0].U /= ProjectedTriangle.Points[0].W;
-            ProjectedTriangle.TextureCoordinates[1].U /= ProjectedTriangle.Points[1].W;
-            ProjectedTriangle.TextureCoordinates[2].U /= ProjectedTriangle.Points[2].W;
-            
-            ProjectedTriangle.TextureCoordinates[0].V /= ProjectedTriangle.Points[0].W;
-            ProjectedTriangle.TextureCoordinates[1].V /= ProjectedTriangle.Points[1].W;
-            ProjectedTriangle.TextureCoordinates[2].V /= ProjectedTriangle.Points[2].W;
-
-            // Set the W component of the texture coordinates to the inverse of the W component of the vertices
-            ProjectedTriangle.TextureCoordinates[0].W = 1.0f / ProjectedTriangle.Points[0].W;
-            ProjectedTriangle.TextureCoordinates[1].W = 1.0f / ProjectedTriangle.Points[1].W;
-            ProjectedTriangle.TextureCoordinates[2].W = 1.0f / ProjectedTriangle.Points[2].W;
-
-            // Normalize into Cartesian space
-            ProjectedTriangle.Points[0] /= ProjectedTriangle.Points[0].W;
-            ProjectedTriangle.Points[1] /= ProjectedTriangle.Points[1].W;
-            ProjectedTriangle.Points[2] /= ProjectedTriangle.Points[2].W;
-
-            // Calculate the color of the triangle based on its normal (in world space)
-            const float Luminance = std::max(0.1f, LightDirection.DotProduct(Normal));
-            ProjectedTriangle.Color = CreateGrayscaleColor(Luminance);
-
-            // Scale triangle into view
-            // Shift unit cube from -1 to 1 coordinates to 0 to 2
-            const XGVector3D Offset = { 1.0f, 1.0f, 0.0f };
-            ProjectedTriangle.Points[0] += Offset;
-            ProjectedTriangle.Points[1] += Offset;
-            ProjectedTriangle.Points[2] += Offset;
-
-            // Divide each point by half to get to 0 to 1 range, and multiply by screen height or width to scale it to our screen
-            ProjectedTriangle.Points[0].X *= 0.5f * static_cast<float>(ScreenWidth());
-            ProjectedTriangle.Points[0].Y *= 0.5f * static_cast<float>(ScreenHeight());
-            ProjectedTriangle.Points[1].X *= 0.5f * static_cast<float>(ScreenWidth());
-            ProjectedTriangle.Points[1].Y *= 0.5f * static_cast<float>(ScreenHeight());
-            ProjectedTriangle.Points[2].X *= 0.5f * static_cast<float>(ScreenWidth());
-            ProjectedTriangle.Points[2].Y *= 0.5f * static_cast<float>(ScreenHeight());
-
-            OutProjectedTriangles.push_back(ProjectedTriangle);
+            XGScreenTriangle ProjectedTriangle;
+            for (int PointIndex = 0; PointIndex < 3; ++PointIndex)
+            {
+                // Project the point from view space to an intermediate screen space
+                const XGVector3D ProjectedPoint = ProjectionMatrix * ClippedTriangles[i].Points[PointIndex];
+                const XGVector2D& TextureCoordinate = ClippedTriangles[i].TextureCoordinates[PointIndex];
+                XGScreenVertex& Vertex = ProjectedTriangle.Vertices[PointIndex];
+
+                // Update the texture coordinates to respect projected depth
+                Vertex.InvW = 1.0f / ProjectedPoint.W;
+                Vertex.UOverW = TextureCoordinate.U * Vertex.InvW;
+                Vertex.VOverW = TextureCoordinate.V * Vertex.InvW;
+
+                // Normalize into Cartesian space, then scale into view. Shift from -1 to 1 coordinates to 0 to 2,
+                // divide by half to get to 0 to 1 range, and multiply by screen width or height.
+                Vertex.X = (ProjectedPoint.X * Vertex.InvW + 1.0f) * 0.5f * static_cast<float>(RenderWidth);
+                Vertex.Y = (ProjectedPoint.Y * Vertex.InvW + 1.0f) * 0.5f * static_cast<float>(RenderHeight);
+            }
+
+            // Calculate the color of the triangle based on its normal (in world space). Textured triangles get their
+            // color from the texture, so they only need the tint.
+            if (RenderMode == Textured)
+            {
+                ProjectedTriangle.Color = MaterialTint;
+            }
+            else
+            {
+                const float Luminance = std::max(0.1f, LightDirection.DotProduct(Normal));
+                ProjectedTriangle.Color = CreateGrayscaleColor(Luminance) * MaterialTint;
+            }
+
+            OutProjectedTriangles.Add(ProjectedTriangle);
+            OutTriangleMaterials.Add(MaterialIndex);
+            if (IsLightmapped)
+            {
+                OutSourceTriangles.Add(TriangleIndex);
+            }
         }
     }
 }
 
-void XGEngine::ClipAndRasterizeTriangles(const std::vector<XGTriangle>& Triangles)
+void XGEngine::CullAndTransformClusters(
+        const XGMesh& Mesh,
+        const XGMatrix4x4& WorldMatrix,
+        const XGMatrix4x4& ViewMatrix,
+        const olc::Pixel& Tint,
+        XGFrameArray<XGScreenTriangle>& OutProjectedTriangles,
+        XGFrameArray<uint32_t>& OutTriangleMaterials,
+        XGFrameArray<uint32_t>& OutSourceTriangles)
 {
-    for (const XGTriangle& Triangle : Triangles)
+    using Clock = std::chrono::high_resolution_clock;
+    using Milliseconds = std::chrono::duration<float, std::milli>;
+    const Clock::time_point CullStartTime = Clock::now();
+
+    const XGMatrix4x4 WorldViewMatrix = WorldMatrix * ViewMatrix;
+    const float ScreenToBufferX = static_cast<float>(OcclusionBuffer.GetWidth()) / static_cast<float>(RenderWidth);
+    const float ScreenToBufferY = static_cast<float>(OcclusionBuffer.GetHeight()) / static_cast<float>(RenderHeight);
+
+    // Sort the clusters by view depth from closest to the camera to farthest away, so the geometry most likely to hide
+    // the rest of the mesh is in the occlusion buffer before the clusters behind it are tested, and in the depth buffer
+    // before the clusters behind it are rasterized
+    const size_t ClusterCount = Mesh.Clusters.size();
+    XGSortEntry* SortedClusters = FrameArena.AllocateArray<XGSortEntry>(ClusterCount);
+    for (size_t ClusterIndex = 0; ClusterIndex < ClusterCount; ++ClusterIndex)
     {
-        std::list<XGTriangle> TriangleList;
-        
-        TriangleList.push_back(Triangle);
-        unsigned long long NumNewTriangles = 1;
+        const XGVector3D ViewCenter = WorldViewMatrix * Mesh.Clusters[ClusterIndex].Bounds.GetCenter();
+        SortedClusters[ClusterIndex] = { XGRadixSort::FloatToKey(ViewCenter.Z), static_cast<uint32_t>(ClusterIndex) };
+    }
+    std::sort(SortedClusters, SortedClusters + ClusterCount, CompareSortEntries);
+
+    for (size_t SortedClusterIndex = 0; SortedClusterIndex < ClusterCount; ++SortedClusterIndex)
+    {
+        const XGMeshCluster& Cluster = Mesh.Clusters[SortedClusters[SortedClusterIndex].Index];
+
+        if (!IsClusterVisible(Cluster.Bounds, WorldViewMatrix))
+        {
+            continue;
+        }
+
+        const size_t FirstProjectedTriangle = OutProjectedTriangles.GetSize();
+        TransformAndProjectTriangles(
+            Mesh,
+            Cluster.FirstTriangle,
+            Cluster.TriangleCount,
+            Cluster.MaterialIndex,
+            WorldMatrix,
+            ViewMatrix,
+            Tint,
+            OutProjectedTriangles,
+            OutTriangleMaterials,
+            OutSourceTriangles
+        );
+
+        if (!ShouldCullOccludedClusters)
+        {
+            continue;
+        }
+
+        // The triangles of this cluster are now known to be visible, so they occlude whatever is behind them
+        for (size_t i = FirstProjectedTriangle; i < OutProjectedTriangles.GetSize(); ++i)
+        {
+            OcclusionBuffer.RasterizeOccluder(OutProjectedTriangles[i], ScreenToBufferX, ScreenToBufferY);
+        }
+        OcclusionStats.OccluderTrianglesRasterized += static_cast<int>(OutProjectedTriangles.GetSize() - FirstProjectedTriangle);
+    }
+
+    OcclusionStats.CullMilliseconds += Milliseconds(Clock::now() - CullStartTime).count();
+}
+
+bool XGEngine::IsClusterVisible(const XGBoundingBox& Bounds, const XGMatrix4x4& WorldViewMatrix)
+{
+    OcclusionStats.ClustersTested++;
+
+    XGVector3D Corners[8];
+    Bounds.GetCorners(Corners);
+
+    float MinX = FLT_MAX;
+    float MinY = FLT_MAX;
+    float MaxX = -FLT_MAX;
+    float MaxY = -FLT_MAX;
+    float NearestDepth = 0.0f;
+
+    for (const XGVector3D& Corner : Corners)
+    {
+        const XGVector3D ViewCorner = WorldViewMatrix * Corner;
+
+        // Boxes that reach behind the near clip plane can't be projected reliably, so assume they are visible
+        if (ViewCorner.Z < NearClipPlane)
+        {
+            return true;
+        }
+
+        XGVector3D ProjectedCorner = ProjectionMatrix * ViewCorner;
+        NearestDepth = std::min(NearestDepth, 1.0f / ProjectedCorner.W);
+        ProjectedCorner /= ProjectedCorner.W;
+
+        // Scale the corner into screen space the same way triangles are
+        const float ScreenX = (ProjectedCorner.X + 1.0f) * 0.5f * static_cast<float>(RenderWidth);
+        const float ScreenY = (ProjectedCorner.Y + 1.0f) * 0.5f * static_cast<float>(RenderHeight);
+        MinX = std::min(MinX, ScreenX);
+        MinY = std::min(MinY, ScreenY);
+        MaxX = std::max(MaxX, ScreenX);
+        MaxY = std::max(MaxY, ScreenY);
+    }
+
+    if (MaxX < 0.0f || MaxY < 0.0f || MinX > static_cast<float>(RenderWidth) || MinY > static_cast<float>(RenderHeight))
+    {
+        OcclusionStats.ClustersFrustumCulled++;
+        return false;
+    }
+
+    if (!ShouldCullOccludedClusters)
+    {
+        return true;
+    }
+
+    const float ScreenToBufferX = static_cast<float>(OcclusionBuffer.GetWidth()) / static_cast<float>(RenderWidth);
+    const float ScreenToBufferY = static_cast<float>(OcclusionBuffer.GetHeight()) / static_cast<float>(RenderHeight);
+    if (OcclusionBuffer.IsRectangleOccluded(
+        MinX * ScreenToBufferX,
+        MinY * ScreenToBufferY,
+        MaxX * ScreenToBufferX,
+        MaxY * ScreenToBufferY,
+        NearestDepth))
+    {
+        OcclusionStats.ClustersOccluded++;
+        return false;
+    }
+
+    return true;
+}
+
+void XGEngine::ClipAndRasterizeTriangles(
+        const XGFrameArray<XGScreenTriangle>& Triangles,
+        const XGFrameArray<uint32_t>& TriangleMaterials,
+        const XGFrameArray<uint32_t>& SourceTriangles,
+        const XGSortEntry* DrawOrder)
+{
+    // Clipping against each of the four screen edges can at most double the number of triangles, so each triangle is
+    // clipped back and forth between two arrays that are big enough for the worst case
+    constexpr int MaxClippedTriangles = 16;
+    XGScreenTriangle* TrianglesToClip = FrameArena.AllocateArray<XGScreenTriangle>(MaxClippedTriangles);
+    XGScreenTriangle* ClippedTriangles = FrameArena.AllocateArray<XGScreenTriangle>(MaxClippedTriangles);
+
+    // Filled triangles only reach the draw target when the render target is resolved, so their wireframes have to wait
+    // until then as well
+    const bool ShouldDeferWireframes = RenderMode != Wireframe && ShouldDrawWireframe;
+    XGFrameArray<XGScreenTriangle> WireframeTriangles(FrameArena);
+
+    // With the span buffer, triangles are only shaded once every one of them has been inserted, so their setups are
+    // kept until then
+    const bool ShouldInsertSpans = IsUsingSpanBuffer();
+    XGFrameArray<XGTriangleSetup> SpanTriangles(FrameArena);
+    XGFrameArray<const XGTexture*> SpanTextures(FrameArena);
+    XGFrameArray<const XGLightmapMapping*> SpanLightmapMappings(FrameArena);
+
+    for (size_t DrawIndex = 0; DrawIndex < Triangles.GetSize(); ++DrawIndex)
+    {
+        const size_t TriangleIndex = DrawOrder != nullptr ? DrawOrder[DrawIndex].Index : DrawIndex;
+        const XGScreenTriangle& Triangle = Triangles[TriangleIndex];
+        const XGTexture* Texture = RenderMode == Textured ? GetMaterialTexture(TriangleMaterials[TriangleIndex]) : nullptr;
+
+        // The lightmap is applied at the texture coordinates of each pixel, so only textured triangles are lit by it
+        const XGLightmapMapping* LightmapMapping = Texture != nullptr && !Lightmap.IsEmpty()
+            ? &Lightmap.GetMapping(SourceTriangles[TriangleIndex])
+            : nullptr;
+
+        TrianglesToClip[0] = Triangle;
+        int TrianglesToClipCount = 1;
 
         for (int PlaneIndex = 0; PlaneIndex < 4; ++PlaneIndex)
         {
-            int NumTrianglesToAdd = 0;
-            while (NumNewTriangles > 0)
+            int ClippedTriangleCount = 0;
+            for (int TriangleToClipIndex = 0; TriangleToClipIndex < TrianglesToClipCount; ++TriangleToClipIndex)
             {
-                const XGTriangle TriangleToClip = TriangleList.front();
-                TriangleList.pop_front();
-                NumNewTriangles--;
+                const XGScreenTriangle& TriangleToClip = TrianglesToClip[TriangleToClipIndex];
+                int NumTrianglesToAdd = 0;
 
                 // Clip triangles against all four screen edges
-                XGTriangle NewTrianglesFromClipping[2];
+                XGScreenTriangle NewTrianglesFromClipping[2];
                 switch (PlaneIndex)
                 {
                 case 0:
-                    NumTrianglesToAdd = TriangleToClip.ClipAgainstPlane(
-                        { 0.0f, 0.0f, 0.0f },
-                        { 0.0f, 1.0f, 0.0f },
+                    NumTrianglesToAdd = TriangleToClip.ClipAgainstEdge(
+                        false,
+                        0.0f,
+                        1.0f,
                         NewTrianglesFromClipping[0],
                         NewTrianglesFromClipping[1]
                     );
                     break;
                 case 1:
-                    NumTrianglesToAdd = TriangleToClip.ClipAgainstPlane(
-                        { 0.0f, static_cast<float>(ScreenHeight()) - 1.0f, 0.0f },
-                        { 0.0f, -1.0f, 0.0f },
+                    NumTrianglesToAdd = TriangleToClip.ClipAgainstEdge(
+                        false,
+                        static_cast<float>(RenderHeight) - 1.0f,
+                        -1.0f,
                         NewTrianglesFromClipping[0],
                         NewTrianglesFromClipping[1]
                     );
                     break;
                 case 2:
-                    NumTrianglesToAdd = TriangleToClip.ClipAgainstPlane(
-                        { 0.0f, 0.0f, 0.0f },
-                        { 1.0f, 0.0f, 0.0f },
+                    NumTrianglesToAdd = TriangleToClip.ClipAgainstEdge(
+                        true,
+                        0.0f,
+                        1.0f,
                         NewTrianglesFromClipping[0],
                         NewTrianglesFromClipping[1]
                     );
                     break;
                 case 3:
-                    NumTrianglesToAdd = TriangleToClip.ClipAgainstPlane(
-                        { static_cast<float>(ScreenWidth()) - 1.0f, 0.0f, 0.0f },
-                        { -1.0f, 0.0f, 0.0f },
+                    NumTrianglesToAdd = TriangleToClip.ClipAgainstEdge(
+                        true,
+                        static_cast<float>(RenderWidth) - 1.0f,
+                        -1.0f,
                         NewTrianglesFromClipping[0],
                         NewTrianglesFromClipping[1]
                     );
@@ -435,262 +1094,327 @@ void XGEngine::ClipAndRasterizeTriangles(const std::vector<XGTriangle>& Triangle
 
                 for (int i = 0; i < NumTrianglesToAdd; ++i)
                 {
-                    TriangleList.push_back(NewTrianglesFromClipping[i]);
+                    ClippedTriangles[ClippedTriangleCount++] = NewTrianglesFromClipping[i];
                 }
             }
 
-            NumNewTriangles = TriangleList.size();
+            std::swap(TrianglesToClip, ClippedTriangles);
+            TrianglesToClipCount = ClippedTriangleCount;
         }
 
         // Rasterize the final list of triangles
-        for (const XGTriangle& TriangleToRasterize : TriangleList)
+        for (int TriangleToRasterizeIndex = 0; TriangleToRasterizeIndex < TrianglesToClipCount; ++TriangleToRasterizeIndex)
         {
-            if (RenderMode == FlatShaded)
+            const XGScreenTriangle& TriangleToRasterize = TrianglesToClip[TriangleToRasterizeIndex];
+            if (RenderMode != Wireframe)
             {
-                FillTriangle(
-                    static_cast<int32_t>(TriangleToRasterize.Points[0].X),
-                    static_cast<int32_t>(TriangleToRasterize.Points[0].Y),
-                    static_cast<int32_t>(TriangleToRasterize.Points[1].X),
-                    static_cast<int32_t>(TriangleToRasterize.Points[1].Y),
-                    static_cast<int32_t>(TriangleToRasterize.Points[2].X),
-                    static_cast<int32_t>(TriangleToRasterize.Points[2].Y),
-                    Triangle.Color
-                );
+                XGTriangleSetup Setup;
+                if (Setup.Initialize(TriangleToRasterize))
+                {
+                    if (ShouldInsertSpans)
+                    {
+                        InsertTriangleSpans(Setup, static_cast<uint32_t>(SpanTriangles.GetSize()));
+                        SpanTriangles.Add(Setup);
+                        SpanTextures.Add(Texture);
+                        SpanLightmapMappings.Add(LightmapMapping);
+                    }
+                    else
+                    {
+                        DrawFilledTriangle(Setup, Texture, LightmapMapping);
+                    }
+                }
             }
-            else if (RenderMode == Textured)
+
+            if (ShouldDeferWireframes)
             {
-                DrawTexturedTriangle(TriangleToRasterize, *TextureToRender);
+                WireframeTriangles.Add(TriangleToRasterize);
             }
-
-            if (RenderMode == Wireframe || ShouldDrawWireframe)
+            else if (RenderMode == Wireframe || ShouldDrawWireframe)
             {
-                DrawTriangle(
-                    static_cast<int32_t>(TriangleToRasterize.Points[0].X),
-                    static_cast<int32_t>(TriangleToRasterize.Points[0].Y),
-                    static_cast<int32_t>(TriangleToRasterize.Points[1].X),
-                    static_cast<int32_t>(TriangleToRasterize.Points[1].Y),
-                    static_cast<int32_t>(TriangleToRasterize.Points[2].X),
-                    static_cast<int32_t>(TriangleToRasterize.Points[2].Y),
-                    olc::WHITE
-                );
+                DrawWireframeTriangle(TriangleToRasterize);
             }
         }
     }
-}
 
-void XGEngine::DrawTexturedTriangle(const XGTriangle& Triangle, const olc::Sprite& TextureSprite)
-{
-    // Create local copies of the data so we can swap them to make our calculations easier
-    // Since we're drawing pixels, we use integer X and Y coordinates
-    int X1 = static_cast<int>(Triangle.Points[0].X);
-    int X2 = static_cast<int>(Triangle.Points[1].X);
-    int X3 = static_cast<int>(Triangle.Points[2].X);
-    int Y1 = static_cast<int>(Triangle.Points[0].Y);
-    int Y2 = static_cast<int>(Triangle.Points[1].Y);
-    int Y3 = static_cast<int>(Triangle.Points[2].Y);
-    float U1 = Triangle.TextureCoordinates[0].U;
-    float U2 = Triangle.TextureCoordinates[1].U;
-    float U3 = Triangle.TextureCoordinates[2].U;
-    float V1 = Triangle.TextureCoordinates[0].V;
-    float V2 = Triangle.TextureCoordinates[1].V;
-    float V3 = Triangle.TextureCoordinates[2].V;
-    float W1 = Triangle.TextureCoordinates[0].W;
-    float W2 = Triangle.TextureCoordinates[1].W;
-    float W3 = Triangle.TextureCoordinates[2].W;
-
-    // Sort the variables based on the Y position of each point of the triangle
-    
-    if (Y2 < Y1)
+    if (ShouldInsertSpans)
     {
-        std::swap(X1, X2);
-        std::swap(Y1, Y2);
-        std::swap(U1, U2);
-        std::swap(V1, V2);
-        std::swap(W1, W2);
+        ShadeSpans(SpanTriangles, SpanTextures, SpanLightmapMappings);
     }
 
-    if (Y3 < Y1)
+    if (RenderMode != Wireframe)
     {
-        std::swap(X1, X3);
-        std::swap(Y1, Y3);
-        std::swap(U1, U3);
-        std::swap(V1, V3);
-        std::swap(W1, W3);
+        RenderTarget.Resolve(*GetDrawTarget());
     }
 
-    if (Y3 < Y2)
+    // The render target may have been scaled up to fill the screen, so the wireframes have to be scaled to match
+    const float RenderToScreenX = static_cast<float>(ScreenWidth()) / static_cast<float>(RenderWidth);
+    const float RenderToScreenY = static_cast<float>(ScreenHeight()) / static_cast<float>(RenderHeight);
+    for (XGScreenTriangle& WireframeTriangle : WireframeTriangles)
     {
-        std::swap(X2, X3);
-        std::swap(Y2, Y3);
-        std::swap(U2, U3);
-        std::swap(V2, V3);
-        std::swap(W2, W3);
+        for (XGScreenVertex& Vertex : WireframeTriangle.Vertices)
+        {
+            Vertex.X *= RenderToScreenX;
+            Vertex.Y *= RenderToScreenY;
+        }
+        DrawWireframeTriangle(WireframeTriangle);
     }
+}
 
-    // Calculate the slope of Line A
-    int LineADeltaX = X2 - X1;
-    int LineADeltaY = Y2 - Y1;
-    float LineADeltaU = U2 - U1;
-    float LineADeltaV = V2 - V1;
-    float LineADeltaW = W2 - W1;
-
-    // Calculate the slope of Line B
-    int LineBDeltaX = X3 - X1;
-    int LineBDeltaY = Y3 - Y1;
-    float LineBDeltaU = U3 - U1;
-    float LineBDeltaV = V3 - V1;
-    float LineBDeltaW = W3 - W1;
+void XGEngine::DrawWireframeTriangle(const XGScreenTriangle& Triangle)
+{
+    DrawTriangle(
+        static_cast<int32_t>(Triangle.Vertices[0].X),
+        static_cast<int32_t>(Triangle.Vertices[0].Y),
+        static_cast<int32_t>(Triangle.Vertices[1].X),
+        static_cast<int32_t>(Triangle.Vertices[1].Y),
+        static_cast<int32_t>(Triangle.Vertices[2].X),
+        static_cast<int32_t>(Triangle.Vertices[2].Y),
+        olc::WHITE
+    );
+}
 
-    float LineAStepX = 0.0f;
-    float LineAStepU = 0.0f;
-    float LineAStepV = 0.0f;
-    float LineAStepW = 0.0f;
-    
-    float LineBStepX = 0.0f;
-    float LineBStepU = 0.0f;
-    float LineBStepV = 0.0f;
-    float LineBStepW = 0.0f;
+void XGEngine::InsertTriangleSpans(const XGTriangleSetup& Setup, uint32_t TriangleId)
+{
+    // 1/W is a linear function of X along each row, so each span only needs its value at X = 0 and its step
+    const float DepthAtZeroX = Setup.InvW - static_cast<float>(Setup.X[0]) * Setup.InvWStepX;
 
-    if (LineADeltaY > 0)
+    Setup.ForEachSpan([&](int Y, int StartX, int EndX)
     {
-        LineAStepX = static_cast<float>(LineADeltaX) / static_cast<float>(std::abs(LineADeltaY));
-        LineAStepU = LineADeltaU / static_cast<float>(std::abs(LineADeltaY));
-        LineAStepV = LineADeltaV / static_cast<float>(std::abs(LineADeltaY));
-        LineAStepW = LineADeltaW / static_cast<float>(std::abs(LineADeltaY));
-    }
+        const float DepthAtZero = DepthAtZeroX + static_cast<float>(Y - Setup.Y[0]) * Setup.InvWStepY;
+        SpanBuffer.InsertSpan(Y, StartX, EndX, DepthAtZero, Setup.InvWStepX, TriangleId);
+    });
+}
+
+void XGEngine::ShadeSpans(
+        const XGFrameArray<XGTriangleSetup>& Triangles,
+        const XGFrameArray<const XGTexture*>& Textures,
+        const XGFrameArray<const XGLightmapMapping*>& LightmapMappings)
+{
+    const XGTileLayout& Layout = RenderTarget.GetLayout();
+    olc::Pixel* const ColorPixels = RenderTarget.GetPixels();
 
-    if (LineBDeltaY > 0)
+    for (int Y = 0; Y < SpanBuffer.GetHeight(); ++Y)
     {
-        LineBStepX = static_cast<float>(LineBDeltaX) / static_cast<float>(std::abs(LineBDeltaY));
-        LineBStepU = LineBDeltaU / static_cast<float>(std::abs(LineBDeltaY));
-        LineBStepV = LineBDeltaV / static_cast<float>(std::abs(LineBDeltaY));
-        LineBStepW = LineBDeltaW / static_cast<float>(std::abs(LineBDeltaY));
-    }
-    
-    float TexU;
-    float TexV;
-    float TexW;
-
-    // Draw the top half of the triangle as long as Line A isn't flat
-    if (LineADeltaY > 0)
-    {
-        // For each row in the top half of the triangle,
-        for (int Y = Y1; Y <= Y2; Y++)
-        {
-            const auto CurrentDeltaY = static_cast<float>(Y - Y1);
-            
-            int LineAX = X1 + static_cast<int>(CurrentDeltaY * LineAStepX);
-            int LineBX = X1 + static_cast<int>(CurrentDeltaY * LineBStepX);
-
-            float UStart = U1 + CurrentDeltaY * LineAStepU;
-            float VStart = V1 + CurrentDeltaY * LineAStepV;
-            float WStart = W1 + CurrentDeltaY * LineAStepW;
-            
-            float UEnd = U1 + CurrentDeltaY * LineBStepU;
-            float VEnd = V1 + CurrentDeltaY * LineBStepV;
-            float WEnd = W1 + CurrentDeltaY * LineBStepW;
-
-            // Sort our variables to make sure we're always going from a smaller X value to a larger one
-            if (LineAX > LineBX)
-            {
-                std::swap(LineAX, LineBX);
-                std::swap(UStart, UEnd);
-                std::swap(VStart, VEnd);
-                std::swap(WStart, WEnd);
-            }
+        const size_t RowOffset = Layout.GetRowOffset(Y);
+        int X = 0;
 
-            float TStep = 1.0f / static_cast<float>(LineBX - LineAX);
-            float T = 0.0f;
+        for (int32_t SpanIndex = SpanBuffer.GetFirstSpan(Y); SpanIndex != -1; SpanIndex = SpanBuffer.GetSpan(SpanIndex).Next)
+        {
+            const XGSpan& Span = SpanBuffer.GetSpan(SpanIndex);
 
-            for (int X = LineAX; X < LineBX; X++)
+            // Nothing was drawn between the last span and this one
+            for (; X < Span.StartX; ++X)
             {
-                TexU = (1.0f - T) * UStart + T * UEnd;
-                TexV = (1.0f - T) * VStart + T * VEnd;
-                TexW = (1.0f - T) * WStart + T * WEnd;
+                ColorPixels[RowOffset + XGTileLayout::GetColumnOffset(X)] = olc::BLACK;
+            }
 
-                // If the depth buffer has pixels that are closer to the screen than this one, don't draw it
-                if (TexW < DepthBuffer[Y * ScreenWidth() + X])
+            const XGTriangleSetup& Setup = Triangles[Span.TriangleId];
+            const XGTexture* Texture = Textures[Span.TriangleId];
+            const XGLightmapMapping* LightmapMapping = LightmapMappings[Span.TriangleId];
+            if (Texture != nullptr)
+            {
+                const bool IsTinted = Setup.Color != olc::WHITE;
+                const float LevelOfDetail = GetSpanLevelOfDetail(*Texture, Setup, Y, Span.StartX, Span.EndX);
+                const float SpanOffsetX = static_cast<float>(Span.StartX - Setup.X[0]);
+                const float SpanOffsetY = static_cast<float>(Y - Setup.Y[0]);
+                float TexW = Setup.InvW + SpanOffsetX * Setup.InvWStepX + SpanOffsetY * Setup.InvWStepY;
+                float TexU = Setup.UOverW + SpanOffsetX * Setup.UOverWStepX + SpanOffsetY * Setup.UOverWStepY;
+                float TexV = Setup.VOverW + SpanOffsetX * Setup.VOverWStepX + SpanOffsetY * Setup.VOverWStepY;
+
+                // Every pixel of a span is visible, so it is sampled a whole batch at a time
+                float BatchU[XGTexture::SampleBatchSize];
+                float BatchV[XGTexture::SampleBatchSize];
+                olc::Pixel BatchColors[XGTexture::SampleBatchSize];
+                while (X < Span.EndX)
                 {
-                    const olc::Pixel SampledColor = TextureSprite.Sample(TexU / TexW, TexV / TexW);
-                    Draw(X, Y, SampledColor);
-
-                    DepthBuffer[Y * ScreenWidth() + X] = TexW;
+                    const int BatchCount = std::min(Span.EndX - X, XGTexture::SampleBatchSize);
+                    for (int BatchIndex = 0; BatchIndex < BatchCount; ++BatchIndex)
+                    {
+                        BatchU[BatchIndex] = TexU / TexW;
+                        BatchV[BatchIndex] = TexV / TexW;
+
+                        TexW += Setup.InvWStepX;
+                        TexU += Setup.UOverWStepX;
+                        TexV += Setup.VOverWStepX;
+                    }
+
+                    Texture->SampleBatch(TextureFilter, LevelOfDetail, BatchU, BatchV, BatchCount, BatchColors);
+                    if (LightmapMapping != nullptr)
+                    {
+                        Lightmap.ApplyBatch(*LightmapMapping, BatchU, BatchV, BatchCount, BatchColors);
+                    }
+
+                    for (int BatchIndex = 0; BatchIndex < BatchCount; ++BatchIndex, ++X)
+                    {
+                        ColorPixels[RowOffset + XGTileLayout::GetColumnOffset(X)] = IsTinted ? BatchColors[BatchIndex] * Setup.Color : BatchColors[BatchIndex];
+                    }
+                }
+            }
+            else
+            {
+                for (; X < Span.EndX; ++X)
+                {
+                    ColorPixels[RowOffset + XGTileLayout::GetColumnOffset(X)] = Setup.Color;
                 }
-                
-                T += TStep;
             }
         }
-    }
-
-    // Update our "d" values for the bottom half of the triangle
-    LineADeltaY = Y3 - Y2;
-    LineADeltaX = X3 - X2;
-    LineADeltaV = V3 - V2;
-    LineADeltaU = U3 - U2;
-    LineADeltaW = W3 - W2;
 
-    // Update the step values only for Line A. Since it's a triangle, Line B will not have changed for the bottom half.
-    LineAStepU = 0.0f;
-    LineAStepV = 0.0f;
-    LineAStepW = 0.0f;
+        for (; X < Layout.Width; ++X)
+        {
+            ColorPixels[RowOffset + XGTileLayout::GetColumnOffset(X)] = olc::BLACK;
+        }
+    }
+}
 
-    if (LineADeltaY > 0)
+void XGEngine::DrawFilledTriangle(const XGTriangleSetup& Setup, const XGTexture* Texture, const XGLightmapMapping* LightmapMapping)
+{
+    // Pick the span loop for the depth format and whether the triangle is textured once per triangle, so the loop
+    // itself never branches on either of them
+    const bool IsTextured = Texture != nullptr;
+    switch (DepthBuffer.GetFormat())
     {
-        LineAStepX = static_cast<float>(LineADeltaX) / static_cast<float>(std::abs(LineADeltaY));
-        LineAStepU = LineADeltaU / static_cast<float>(std::abs(LineADeltaY));
-        LineAStepV = LineADeltaV / static_cast<float>(std::abs(LineADeltaY));
-        LineAStepW = LineADeltaW / static_cast<float>(std::abs(LineADeltaY));
+    case Unorm16Depth:
+        if (IsTextured)
+        {
+            DrawTriangleSpans<XGUnorm16DepthTraits, true>(Setup, Texture, LightmapMapping);
+        }
+        else
+        {
+            DrawTriangleSpans<XGUnorm16DepthTraits, false>(Setup, nullptr, nullptr);
+        }
+        break;
+    case Fixed24Stencil8Depth:
+        if (IsTextured)
+        {
+            DrawTriangleSpans<XGFixed24Stencil8DepthTraits, true>(Setup, Texture, LightmapMapping);
+        }
+        else
+        {
+            DrawTriangleSpans<XGFixed24Stencil8DepthTraits, false>(Setup, nullptr, nullptr);
+        }
+        break;
+    default:
+        if (IsTextured)
+        {
+            DrawTriangleSpans<XGFloat32DepthTraits, true>(Setup, Texture, LightmapMapping);
+        }
+        else
+        {
+            DrawTriangleSpans<XGFloat32DepthTraits, false>(Setup, nullptr, nullptr);
+        }
+        break;
     }
+}
 
-    // Draw the bottom half of the triangle as long as Line A isn't flat
-    if (LineADeltaY > 0)
+template <typename DepthTraits, bool IsTextured>
+void XGEngine::DrawTriangleSpans(const XGTriangleSetup& Setup, const XGTexture* Texture, const XGLightmapMapping* LightmapMapping)
+{
+    // Only pay for multiplying texels by the triangle's color when it would change them
+    const bool IsTinted = IsTextured && Setup.Color != olc::WHITE;
+
+    const float DepthEncodeScale = DepthBuffer.GetEncodeScale();
+
+    // The render target and the depth buffer are the same size, so they share a tile layout
+    const XGTileLayout& Layout = RenderTarget.GetLayout();
+    olc::Pixel* const ColorPixels = RenderTarget.GetPixels();
+    typename DepthTraits::ValueType* const DepthPixels = DepthBuffer.GetPixels<DepthTraits>();
+
+    Setup.ForEachSpan([&](int Y, int StartX, int EndX)
     {
-        // For each row in the bottom half of the triangle,
-        for (int Y = Y2; Y <= Y3; Y++)
+        // Find the attributes at the start of the span. From there, they change by a constant step per pixel.
+        const float SpanOffsetX = static_cast<float>(StartX - Setup.X[0]);
+        const float SpanOffsetY = static_cast<float>(Y - Setup.Y[0]);
+        float TexW = Setup.InvW + SpanOffsetX * Setup.InvWStepX + SpanOffsetY * Setup.InvWStepY;
+        float TexU = Setup.UOverW + SpanOffsetX * Setup.UOverWStepX + SpanOffsetY * Setup.UOverWStepY;
+        float TexV = Setup.VOverW + SpanOffsetX * Setup.VOverWStepX + SpanOffsetY * Setup.VOverWStepY;
+
+        // The mip level is only worked out once a pixel of the span is known to be visible
+        float LevelOfDetail = -1.0f;
+
+        // Visible pixels are gathered into batches, so the texture can filter several of them in one call
+        float BatchU[XGTexture::SampleBatchSize];
+        float BatchV[XGTexture::SampleBatchSize];
+        size_t BatchOffsets[XGTexture::SampleBatchSize];
+        olc::Pixel BatchColors[XGTexture::SampleBatchSize];
+        int BatchCount = 0;
+
+        const auto ShadeBatch = [&]()
         {
-            const auto CurrentLineADeltaY = static_cast<float>(Y - Y2);
-            const auto CurrentLineBDeltaY = static_cast<float>(Y - Y1);
-            
-            int LineAX = X2 + static_cast<int>(CurrentLineADeltaY * LineAStepX);
-            int LineBX = X1 + static_cast<int>(CurrentLineBDeltaY * LineBStepX);
-
-            float UStart = U2 + CurrentLineADeltaY * LineAStepU;
-            float VStart = V2 + CurrentLineADeltaY * LineAStepV;
-            float WStart = W2 + CurrentLineADeltaY * LineAStepW;
-        
-            float UEnd = U1 + CurrentLineBDeltaY * LineBStepU;
-            float VEnd = V1 + CurrentLineBDeltaY * LineBStepV;
-            float WEnd = W1 + CurrentLineBDeltaY * LineBStepW;
+            Texture->SampleBatch(TextureFilter, LevelOfDetail, BatchU, BatchV, BatchCount, BatchColors);
+            if (LightmapMapping != nullptr)
+            {
+                Lightmap.ApplyBatch(*LightmapMapping, BatchU, BatchV, BatchCount, BatchColors);
+            }
 
-            // Sort our variables to make sure we're always going from a smaller X value to a larger one
-            if (LineAX > LineBX)
+            for (int BatchIndex = 0; BatchIndex < BatchCount; ++BatchIndex)
             {
-                std::swap(LineAX, LineBX);
-                std::swap(UStart, UEnd);
-                std::swap(VStart, VEnd);
-                std::swap(WStart, WEnd);
+                ColorPixels[BatchOffsets[BatchIndex]] = IsTinted ? BatchColors[BatchIndex] * Setup.Color : BatchColors[BatchIndex];
             }
 
-            float TStep = 1.0f / static_cast<float>(LineBX - LineAX);
-            float T = 0.0f;
+            BatchCount = 0;
+        };
 
-            for (int X = LineAX; X < LineBX; X++)
-            {
-                TexU = (1.0f - T) * UStart + T * UEnd;
-                TexV = (1.0f - T) * VStart + T * VEnd;
-                TexW = (1.0f - T) * WStart + T * WEnd;
+        const size_t RowOffset = Layout.GetRowOffset(Y);
 
-                // If the depth buffer has pixels that are closer to the screen than this one, don't draw it
-                if (TexW < DepthBuffer[Y * ScreenWidth() + X])
+        for (int X = StartX; X < EndX; X++)
+        {
+            // If the depth buffer has pixels that are closer to the screen than this one, don't draw it. Depth is
+            // tested before the texture is sampled, so hidden pixels cost as little as possible. Flat shaded
+            // triangles only need 1/W, and the texture coordinates are left for the compiler to drop.
+            const size_t PixelOffset = RowOffset + XGTileLayout::GetColumnOffset(X);
+            const typename DepthTraits::ValueType Depth = DepthTraits::Encode(TexW, DepthEncodeScale);
+            if (DepthTraits::IsCloser(Depth, DepthPixels[PixelOffset]))
+            {
+                if (IsTextured)
                 {
-                    const olc::Pixel SampledColor = TextureSprite.Sample(TexU / TexW, TexV / TexW);
-                    Draw(X, Y, SampledColor);
-
-                    DepthBuffer[Y * ScreenWidth() + X] = TexW;
+                    if (LevelOfDetail < 0.0f)
+                    {
+                        LevelOfDetail = GetSpanLevelOfDetail(*Texture, Setup, Y, StartX, EndX);
+                    }
+
+                    BatchU[BatchCount] = TexU / TexW;
+                    BatchV[BatchCount] = TexV / TexW;
+                    BatchOffsets[BatchCount] = PixelOffset;
+                    if (++BatchCount == XGTexture::SampleBatchSize)
+                    {
+                        ShadeBatch();
+                    }
+                }
+                else
+                {
+                    ColorPixels[PixelOffset] = Setup.Color;
                 }
-            
-                T += TStep;
+
+                DepthTraits::Write(DepthPixels[PixelOffset], Depth);
             }
+
+            TexW += Setup.InvWStepX;
+            TexU += Setup.UOverWStepX;
+            TexV += Setup.VOverWStepX;
         }
-    }
+
+        if (IsTextured && BatchCount > 0)
+        {
+            ShadeBatch();
+        }
+    });
+}
+
+float XGEngine::GetSpanLevelOfDetail(const XGTexture& Texture, const XGTriangleSetup& Setup, int Y, int StartX, int EndX)
+{
+    // U = (U/W) / (1/W), and both parts change linearly across the screen, so the quotient rule gives the change in U
+    // per pixel from the steps of each part
+    const float OffsetX = 0.5f * static_cast<float>(StartX + EndX - 1) - static_cast<float>(Setup.X[0]);
+    const float OffsetY = static_cast<float>(Y - Setup.Y[0]);
+    const float InvW = Setup.InvW + OffsetX * Setup.InvWStepX + OffsetY * Setup.InvWStepY;
+    const float UOverW = Setup.UOverW + OffsetX * Setup.UOverWStepX + OffsetY * Setup.UOverWStepY;
+    const float VOverW = Setup.VOverW + OffsetX * Setup.VOverWStepX + OffsetY * Setup.VOverWStepY;
+    const float InvWSquaredReciprocal = 1.0f / (InvW * InvW);
+
+    return Texture.GetLevelOfDetail(
+        (Setup.UOverWStepX * InvW - UOverW * Setup.InvWStepX) * InvWSquaredReciprocal,
+        (Setup.VOverWStepX * InvW - VOverW * Setup.InvWStepX) * InvWSquaredReciprocal,
+        (Setup.UOverWStepY * InvW - UOverW * Setup.InvWStepY) * InvWSquaredReciprocal,
+        (Setup.VOverWStepY * InvW - VOverW * Setup.InvWStepY) * InvWSquaredReciprocal
+    );
 }
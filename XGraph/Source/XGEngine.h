@@ -6,8 +6,24 @@
 #pragma once
 
 #include "../ThirdParty/olcPixelGameEngine.h"
+#include "XGDepthBuffer.h"
+#include "XGFrameArena.h"
+#include "XGLightmap.h"
 #include "XGMatrix4x4.h"
+#include "XGMemoryTracker.h"
 #include "XGMesh.h"
+#include "XGMeshInstance.h"
+#include "XGOcclusionBuffer.h"
+#include "XGRadixSort.h"
+#include "XGRenderTarget.h"
+#include "XGResolutionGovernor.h"
+#include "XGSceneGraph.h"
+#include "XGSpanBuffer.h"
+#include "XGTexture.h"
+#include "XGTextureLoader.h"
+#include "XGTextureResidency.h"
+#include "XGScreenTriangle.h"
+#include "XGTriangleSetup.h"
 #include "XGVector3D.h"
 
 /**
@@ -26,6 +42,7 @@ public:
     XGEngine() : XGEngine("") {}
     XGEngine(const std::string& MeshFilePath) : XGEngine(MeshFilePath, "") {}
     XGEngine(const std::string& MeshFilePath, const std::string& TextureFilePath, bool InvertUVMapping = false);
+    ~XGEngine() override;
 
     /**
      * \brief The type of rendering the engine should perform
@@ -47,8 +64,139 @@ public:
      */
     XGVector3D LightDirection;
 
+    /**
+     * \brief The placements of the mesh to draw each frame. The mesh's triangles are shared by every instance.
+     * \details When empty, the mesh is drawn once, just in front of the camera's starting position.
+     */
+    std::vector<XGMeshInstance> MeshInstances;
+
+    /**
+     * \brief The transform hierarchy that mesh instances can be attached to
+     */
+    XGSceneGraph SceneGraph;
+
+    /**
+     * \brief Whether mesh clusters hidden behind closer geometry should be skipped before they are transformed
+     */
+    bool ShouldCullOccludedClusters = true;
+
+    /**
+     * \brief The resolution of the occlusion buffer. Changes take effect in OnUserCreate.
+     */
+    int OcclusionBufferWidth = 256;
+    int OcclusionBufferHeight = 128;
+
+    /**
+     * \brief Whether the mesh's vertices should be stored as 16-bit integers instead of floats, which saves memory and
+     * bandwidth at the cost of some precision. Changes take effect in OnUserCreate.
+     */
+    bool ShouldQuantizeMesh = false;
+
+    /**
+     * \brief Whether the memory used by each category should be drawn in the top left corner of the screen
+     */
+    bool ShouldDrawMemoryOverlay = false;
+
+    /**
+     * \brief How the depth buffer stores the depth of each pixel. Changes take effect in OnUserCreate.
+     */
+    XGDepthFormat DepthFormat = Float32Depth;
+
+    /**
+     * \brief Whether textured and flat shaded frames should be rendered at a lower resolution and scaled up to fill the
+     * screen when they take longer than the governor's target. Wireframes are always drawn at the full resolution.
+     */
+    bool ShouldScaleResolution = false;
+
+    /**
+     * \brief Picks the resolution filled frames are rendered at when ShouldScaleResolution is set
+     */
+    XGResolutionGovernor ResolutionGovernor;
+
+    /**
+     * \brief Whether filled triangles should be sorted front to back and resolved with the span buffer instead of the
+     * depth buffer, so every pixel is shaded and written exactly once
+     */
+    bool ShouldUseSpanBuffer = false;
+
+    /**
+     * \brief How the texture is filtered in Textured mode. The mip level is chosen once per span.
+     */
+    XGTextureFilter TextureFilter = NearestFilter;
+
+    /**
+     * \brief How the textures are stored. Compressed formats are decoded a block at a time as they are sampled.
+     * Changes take effect in OnUserCreate, and a texture can't be decompressed once it has been compressed.
+     */
+    XGTextureFormat TextureFormat = UncompressedFormat;
+
+    /**
+     * \brief Whether textures should be loaded on a worker thread, drawing a placeholder in their place until they are
+     * ready, rather than before the first frame. Changes take effect in OnUserCreate.
+     */
+    bool ShouldLoadTexturesAsync = true;
+
+    /**
+     * \brief Whether filled triangles should be drawn grouped by material, so each texture stays in the cache while its
+     * triangles are drawn. Within a material, triangles keep their front to back order. The span buffer shades pixels
+     * in screen order, so it ignores this.
+     */
+    bool ShouldSortByMaterial = true;
+
+    /**
+     * \brief Whether textured triangles should be multiplied by a lightmap baked from the mesh, which lights them with
+     * shadows and sky occlusion for the cost of one extra sample per pixel. Changes take effect in OnUserCreate.
+     */
+    bool ShouldUseLightmap = false;
+
+    /**
+     * \brief The file the lightmap is loaded from. If the file is missing or was baked for a different mesh, the
+     * lightmap is baked and saved to it, so only the first run pays for the bake. When empty, the lightmap is baked on
+     * every run. Changes take effect in OnUserCreate.
+     */
+    std::string LightmapFilePath;
+
+    /**
+     * \brief How the lightmap is baked when it can't be loaded. Changes take effect in OnUserCreate.
+     */
+    XGLightmapBakeSettings LightmapBakeSettings;
+
     bool OnUserCreate() override;
     bool OnUserUpdate(float fElapsedTime) override;
+    bool OnUserDestroy() override;
+
+    /**
+     * \brief Returns the statistics gathered by the occlusion culling stage during the last frame
+     */
+    const XGOcclusionStats& GetOcclusionStats() const { return OcclusionStats; }
+
+    /**
+     * \brief Returns the statistics gathered by the span buffer during the last frame it was used
+     */
+    const XGSpanBufferStats& GetSpanBufferStats() const { return SpanBuffer.GetStats(); }
+
+    /**
+     * \brief Returns the arena that transient rendering data is allocated from each frame
+     */
+    const XGFrameArena& GetFrameArena() const { return FrameArena; }
+
+    /**
+     * \brief Returns the memory used by every buffer the engine owns. Budgets for each category can be set on it.
+     */
+    XGMemoryTracker& GetMemoryTracker() { return MemoryTracker; }
+    const XGMemoryTracker& GetMemoryTracker() const { return MemoryTracker; }
+
+    /**
+     * \brief Returns the loader that textures are loaded with when ShouldLoadTexturesAsync is set
+     */
+    XGTextureLoader& GetTextureLoader() { return TextureLoader; }
+    const XGTextureLoader& GetTextureLoader() const { return TextureLoader; }
+
+    /**
+     * \brief Returns what the texture residency manager did during the last frame. The textures are held to the
+     * budget of TextureMemory on the memory tracker.
+     */
+    const XGTextureResidencyStats& GetTextureResidencyStats() const { return TextureResidency.GetStats(); }
 
 private:
     /**
@@ -57,9 +205,40 @@ private:
     XGMesh MeshToRender;
 
     /**
-     * \brief The texture to apply to all triangles of the mesh
+     * \brief The texture to apply to the triangles of the mesh whose material doesn't have a texture of its own
+     */
+    XGTexture* TextureToRender = nullptr;
+
+    /**
+     * \brief The file TextureToRender is loaded from in OnUserCreate
+     */
+    std::string TextureToRenderPath;
+
+    /**
+     * \brief Loads textures on a worker thread when ShouldLoadTexturesAsync is set
+     */
+    XGTextureLoader TextureLoader;
+
+    /**
+     * \brief Keeps every texture loaded from a file within the texture memory budget
+     */
+    XGTextureResidency TextureResidency;
+
+    /**
+     * \brief The textures loaded for the mesh's materials. Materials that share a texture share one copy of it.
      */
-    olc::Sprite* TextureToRender;
+    std::vector<XGTexture*> MaterialTextures;
+
+    /**
+     * \brief The texture to apply to the triangles of each of the mesh's materials, which is TextureToRender for
+     * materials without a texture of their own
+     */
+    std::vector<const XGTexture*> TexturesByMaterial;
+
+    /**
+     * \brief The lighting baked for the mesh when ShouldUseLightmap is set. Empty otherwise.
+     */
+    XGLightmap Lightmap;
 
     /**
      * \brief Perspective projection matrix
@@ -84,9 +263,58 @@ private:
     XGVector3D CameraLookDirection = { 0.0f, 0.0f, 1.0f };
 
     /**
-     * \brief The depth value (W) of the texture being drawn at each pixel on the screen
+     * \brief The depth value (1/W) of the texture being drawn at each pixel on the screen, stored in DepthFormat
+     */
+    XGDepthBuffer DepthBuffer;
+
+    /**
+     * \brief The color of each pixel on the screen while filled triangles are drawn. It is stored in tiles like the
+     * depth buffer, and copied into the draw target once every triangle has been drawn.
+     */
+    XGRenderTarget RenderTarget;
+
+    /**
+     * \brief The visible spans of each row, used instead of the depth buffer when ShouldUseSpanBuffer is set
+     */
+    XGSpanBuffer SpanBuffer;
+
+    /**
+     * \brief The size of the image triangles are projected onto during the current frame. This is the screen size unless
+     * the resolution is being scaled.
+     */
+    int RenderWidth = 0;
+    int RenderHeight = 0;
+
+    /**
+     * \brief Low resolution depth buffer that visible clusters are rasterized into to occlude the clusters behind them
+     */
+    XGOcclusionBuffer OcclusionBuffer;
+
+    /**
+     * \brief Statistics from the most recent run of the occlusion culling stage
+     */
+    XGOcclusionStats OcclusionStats;
+
+    /**
+     * \brief Holds the projected triangles, clipped triangles and sort keys of the current frame
+     * \details Reset at the start of every frame, so nothing allocated from it may be kept until the next one
+     */
+    XGFrameArena FrameArena;
+
+    /**
+     * \brief The number of triangles projected during the last frame
+     */
+    size_t LastFrameTriangleCount = 0;
+
+    /**
+     * \brief The memory used by every buffer the engine owns, by category
+     */
+    XGMemoryTracker MemoryTracker;
+
+    /**
+     * \brief Orders sort entries by key, and entries with equal keys by index
      */
-    float* DepthBuffer = nullptr;
+    static bool CompareSortEntries(const XGSortEntry& Entry1, const XGSortEntry& Entry2);
 
     /**
      * \brief Create a grayscale color
@@ -95,37 +323,218 @@ private:
      */
     static olc::Pixel CreateGrayscaleColor(const float& Brightness);
 
+    /**
+     * \brief Loads the texture of each of the mesh's materials and fills TexturesByMaterial
+     */
+    void LoadMaterialTextures();
+
+    /**
+     * \brief Loads a texture that tiles, either right away or on the texture loader, compresses it to TextureFormat and
+     * hands it to the texture residency manager
+     * \return False if the texture was loaded right away and its file couldn't be loaded
+     */
+    bool LoadTexture(XGTexture& Texture, const std::string& FilePath);
+
+    /**
+     * \brief Loads the lightmap from LightmapFilePath, or bakes it and saves it there if it can't be loaded
+     */
+    void LoadLightmap();
+
+    /**
+     * \brief Returns the texture to apply to the triangles of a material, or null if they aren't textured
+     */
+    const XGTexture* GetMaterialTexture(uint32_t MaterialIndex) const
+    {
+        return MaterialIndex < TexturesByMaterial.size() ? TexturesByMaterial[MaterialIndex] : TextureToRender;
+    }
+
+    /**
+     * \brief Reports the current size of every buffer the engine owns to the memory tracker
+     */
+    void UpdateMemoryUsage();
+
+    /**
+     * \brief Draws the current and highest memory use of each category on the screen
+     */
+    void DrawMemoryOverlay();
+
+    /**
+     * \brief Frees the render target, the depth buffer, the textures and the lightmap
+     */
+    void ReleaseBuffers();
+
     /**
      * \brief Move the camera based on keyboard input
      */
     void ProcessKeyboardInput(const float& SecondsElapsedThisFrame);
 
+    /**
+     * \brief Cull instances of a mesh against the view frustum, then transform and project the rest into screen space
+     * \param Mesh The mesh shared by all of the instances
+     * \param Instances The first instance to draw
+     * \param InstanceCount The number of instances to draw
+     * \param ViewMatrix The matrix used to convert the triangles from world space to view space (camera space)
+     * \param OutProjectedTriangles The triangles of every visible instance are appended to this list
+     * \param OutTriangleMaterials The material index of each triangle appended to OutProjectedTriangles
+     * \param OutSourceTriangles The index of the mesh triangle each triangle appended to OutProjectedTriangles came
+     * from. Only filled when the mesh has a lightmap.
+     */
+    void SubmitMeshInstances(
+        const XGMesh& Mesh,
+        const XGMeshInstance* Instances,
+        size_t InstanceCount,
+        const XGMatrix4x4& ViewMatrix,
+        XGFrameArray<XGScreenTriangle>& OutProjectedTriangles,
+        XGFrameArray<uint32_t>& OutTriangleMaterials,
+        XGFrameArray<uint32_t>& OutSourceTriangles
+    );
+
+    /**
+     * \brief Determines whether any part of a bounding box could be inside the view frustum
+     * \param Bounds The bounding box in model space
+     * \param WorldViewMatrix The matrix used to convert the bounds from model space to view space
+     * \return False if the whole box is outside one of the planes of the view frustum
+     */
+    bool IsInsideViewFrustum(const XGBoundingBox& Bounds, const XGMatrix4x4& WorldViewMatrix) const;
+
     /**
      * \brief Transform and project triangles from world space to screen space
      * \param Mesh The mesh to get the triangles from
+     * \param FirstTriangle The index of the first triangle to transform
+     * \param TriangleCount The number of triangles to transform
+     * \param MaterialIndex The index of the material every one of the triangles uses
      * \param WorldMatrix The matrix used to convert the triangles from model space to world space
      * \param ViewMatrix The matrix used to convert the triangles from world space to view space (camera space)
-     * \param OutProjectedTriangles The triangles projected into screen space (perspective projection)
+     * \param Tint The color the triangles' colors are multiplied by, along with their material's color
+     * \param OutProjectedTriangles The triangles projected into screen space (perspective projection) are appended to
+     * this list
+     * \param OutTriangleMaterials MaterialIndex is appended to this list once for each projected triangle
+     * \param OutSourceTriangles The index of the mesh triangle each projected triangle came from is appended to this
+     * list. Only filled when the mesh has a lightmap.
      */
     void TransformAndProjectTriangles(
+        const XGMesh& Mesh,
+        unsigned int FirstTriangle,
+        unsigned int TriangleCount,
+        unsigned int MaterialIndex,
+        const XGMatrix4x4& WorldMatrix,
+        const XGMatrix4x4& ViewMatrix,
+        const olc::Pixel& Tint,
+        XGFrameArray<XGScreenTriangle>& OutProjectedTriangles,
+        XGFrameArray<uint32_t>& OutTriangleMaterials,
+        XGFrameArray<uint32_t>& OutSourceTriangles
+    );
+
+    /**
+     * \brief Transform and project the clusters of a mesh front to back, skipping clusters that are outside the
+     * screen or hidden behind clusters that were already projected
+     * \param Mesh The mesh to get the clusters from
+     * \param WorldMatrix The matrix used to convert the triangles from model space to world space
+     * \param ViewMatrix The matrix used to convert the triangles from world space to view space (camera space)
+     * \param Tint The color the triangles' colors are multiplied by
+     * \param OutProjectedTriangles The triangles projected into screen space are appended to this list
+     * \param OutTriangleMaterials The material index of each triangle appended to OutProjectedTriangles
+     * \param OutSourceTriangles The index of the mesh triangle each triangle appended to OutProjectedTriangles came
+     * from. Only filled when the mesh has a lightmap.
+     */
+    void CullAndTransformClusters(
         const XGMesh& Mesh,
         const XGMatrix4x4& WorldMatrix,
         const XGMatrix4x4& ViewMatrix,
-        std::vector<XGTriangle>& OutProjectedTriangles
+        const olc::Pixel& Tint,
+        XGFrameArray<XGScreenTriangle>& OutProjectedTriangles,
+        XGFrameArray<uint32_t>& OutTriangleMaterials,
+        XGFrameArray<uint32_t>& OutSourceTriangles
     );
 
+    /**
+     * \brief Determines whether a cluster's bounds could be visible, given what is in the occlusion buffer
+     * \param Bounds The bounds of the cluster in model space
+     * \param WorldViewMatrix The matrix used to convert the bounds from model space to view space
+     * \return True if any part of the bounds may be visible
+     */
+    bool IsClusterVisible(const XGBoundingBox& Bounds, const XGMatrix4x4& WorldViewMatrix);
+
     /**
      * \brief Clip triangles that are outside the view frustum and rasterize them onto the screen
+     * \details In textured and flat shaded modes, triangles are drawn into the render target, which is resolved into
+     * the draw target at the end. Wireframes are drawn after that, so they stay on top of the triangles.
      * \param Triangles The triangles to clip and rasterize. These are assumed to be in screen space already.
+     * \param TriangleMaterials The material index of each triangle, which picks the texture it is filled with
+     * \param SourceTriangles The index of the mesh triangle each triangle came from, which picks its lightmap mapping.
+     * Only read when the mesh has a lightmap.
+     * \param DrawOrder If not null, the index of each triangle in the order they should be drawn. Otherwise, the
+     * triangles are drawn in the order they are listed.
      */
     void ClipAndRasterizeTriangles(
-        const std::vector<XGTriangle>& Triangles
+        const XGFrameArray<XGScreenTriangle>& Triangles,
+        const XGFrameArray<uint32_t>& TriangleMaterials,
+        const XGFrameArray<uint32_t>& SourceTriangles,
+        const XGSortEntry* DrawOrder = nullptr
+    );
+
+    /**
+     * \brief Returns true if filled triangles are resolved with the span buffer this frame
+     */
+    bool IsUsingSpanBuffer() const { return ShouldUseSpanBuffer && RenderMode != Wireframe; }
+
+    /**
+     * \brief Adds the spans of a triangle to the span buffer
+     * \param Setup The setup of the triangle (in screen space)
+     * \param TriangleId The index of the setup in the list that is later passed to ShadeSpans
+     */
+    void InsertTriangleSpans(const XGTriangleSetup& Setup, uint32_t TriangleId);
+
+    /**
+     * \brief Writes every pixel of the render target once, from the spans left in the span buffer. Pixels that no span
+     * covers are cleared to black.
+     * \param Triangles The setups of the triangles the spans were inserted for
+     * \param Textures The texture of each triangle in Triangles, or null for triangles filled with their color
+     * \param LightmapMappings The lightmap mapping of each triangle in Triangles, or null for triangles that aren't lit
+     * by the lightmap
+     */
+    void ShadeSpans(
+        const XGFrameArray<XGTriangleSetup>& Triangles,
+        const XGFrameArray<const XGTexture*>& Textures,
+        const XGFrameArray<const XGLightmapMapping*>& LightmapMappings
     );
 
     /**
-     * \brief Draws the given triangle on the screen with the given texture
-     * \param Triangle The triangle to draw (in screen space)
-     * \param TextureSprite The texture to apply to the triangle
+     * \brief Draws the outline of the given triangle on the screen in white
+     */
+    void DrawWireframeTriangle(const XGScreenTriangle& Triangle);
+
+    /**
+     * \brief Draws the given triangle into the render target, filled with its texture or with its color, and keeps
+     * only the pixels that pass the depth test
+     * \param Setup The setup of the triangle to draw (in screen space)
+     * \param Texture The texture to fill the triangle with, or null to fill it with its color
+     * \param LightmapMapping The map from the triangle's texture coordinates to the lightmap, or null if the triangle
+     * isn't lit by the lightmap
+     */
+    void DrawFilledTriangle(const XGTriangleSetup& Setup, const XGTexture* Texture, const XGLightmapMapping* LightmapMapping);
+
+    /**
+     * \brief Walks the spans of a triangle, testing and writing depth at each pixel
+     * \tparam DepthTraits The depth test and write for the depth buffer's format
+     * \tparam IsTextured Whether the pixels are sampled from the texture and multiplied by the triangle's color, rather
+     * than filled with the triangle's color
+     * \param Setup The setup of the triangle to draw (in screen space)
+     * \param Texture The texture to apply to the triangle. Only used when IsTextured is true.
+     * \param LightmapMapping The map from the triangle's texture coordinates to the lightmap, or null if the triangle
+     * isn't lit by the lightmap. Only used when IsTextured is true.
+     */
+    template <typename DepthTraits, bool IsTextured>
+    void DrawTriangleSpans(const XGTriangleSetup& Setup, const XGTexture* Texture, const XGLightmapMapping* LightmapMapping);
+
+    /**
+     * \brief Finds the mip level to sample for a span of a triangle, from how fast its texture coordinates change at
+     * the middle of the span
+     * \param Texture The texture applied to the triangle
+     * \param Setup The setup of the triangle (in screen space)
+     * \param Y The row of the span
+     * \param StartX The first pixel of the span
+     * \param EndX The pixel just past the end of the span
      */
-    void DrawTexturedTriangle(const XGTriangle& Triangle, const olc::Sprite& TextureSprite);
+    static float GetSpanLevelOfDetail(const XGTexture& Texture, const XGTriangleSetup& Setup, int Y, int StartX, int EndX);
 };
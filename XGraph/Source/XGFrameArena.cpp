@@ -0,0 +1,111 @@
+﻿// XGFrameArena.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGFrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+XGFrameArena::~XGFrameArena()
+{
+    for (unsigned char* Block : OverflowBlocks)
+    {
+        delete[] Block;
+    }
+    delete[] Buffer;
+}
+
+void XGFrameArena::Reset()
+{
+    // Once the block fits the largest frame so far, any frame that needed no more than that must have been served
+    // from the block alone
+    assert(!IsWarmedUp || FrameBytesUsed > HighWaterMark || FrameHeapAllocationCount == 0);
+
+    HighWaterMark = std::max(HighWaterMark, FrameBytesUsed);
+
+    // If this frame overflowed, replace every block with one that fits the largest frame so far. Some headroom is
+    // added, so a frame that is only slightly bigger doesn't immediately overflow again.
+    if (!OverflowBlocks.empty())
+    {
+        for (unsigned char* Block : OverflowBlocks)
+        {
+            delete[] Block;
+        }
+        OverflowBlocks.clear();
+        OverflowBytes = 0;
+
+        delete[] Buffer;
+        Capacity = std::max(HighWaterMark + HighWaterMark / 4, Capacity + Capacity / 4);
+        Buffer = new unsigned char[Capacity];
+        HeapAllocationCount++;
+    }
+
+    CurrentBlock = Buffer;
+    CurrentBlockSize = Capacity;
+    CurrentOffset = 0;
+    FrameBytesUsed = 0;
+    FrameHeapAllocationCount = 0;
+    IsWarmedUp = HighWaterMark <= Capacity;
+}
+
+void* XGFrameArena::Allocate(size_t Size, size_t Alignment)
+{
+    const uintptr_t BlockStart = reinterpret_cast<uintptr_t>(CurrentBlock);
+    uintptr_t AlignedStart = (BlockStart + CurrentOffset + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+
+    if (CurrentBlock == nullptr || AlignedStart + Size > BlockStart + CurrentBlockSize)
+    {
+        // Take a new block from the heap that is big enough for this allocation and plenty of the ones after it. The
+        // memory this frame already used is kept, because allocations made from it are still alive.
+        const size_t BlockSize = std::max({ Size + Alignment, CurrentBlockSize * 2, static_cast<size_t>(64 * 1024) });
+        unsigned char* Block = new unsigned char[BlockSize];
+        OverflowBlocks.push_back(Block);
+        OverflowBytes += BlockSize;
+        HeapAllocationCount++;
+        FrameHeapAllocationCount++;
+
+        CurrentBlock = Block;
+        CurrentBlockSize = BlockSize;
+        CurrentOffset = 0;
+        AlignedStart = (reinterpret_cast<uintptr_t>(Block) + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+    }
+
+    CurrentOffset = AlignedStart + Size - reinterpret_cast<uintptr_t>(CurrentBlock);
+
+    // Count the allocation as if every allocation of the frame came from one block, which is what a frame would take
+    // from a block big enough for it. Blocks are only aligned to max_align_t, so a stricter alignment may need up to
+    // Alignment - 1 bytes of padding wherever the allocation lands.
+    if (Alignment > alignof(std::max_align_t))
+    {
+        FrameBytesUsed += Alignment - 1;
+    }
+    else
+    {
+        FrameBytesUsed = (FrameBytesUsed + Alignment - 1) & ~(Alignment - 1);
+    }
+    FrameBytesUsed += Size;
+
+    return reinterpret_cast<void*>(AlignedStart);
+}
+
+bool XGFrameArena::TryGrow(void* Allocation, size_t OldSize, size_t NewSize)
+{
+    unsigned char* AllocationEnd = static_cast<unsigned char*>(Allocation) + OldSize;
+    if (AllocationEnd != CurrentBlock + CurrentOffset)
+    {
+        return false;
+    }
+
+    const size_t NewOffset = CurrentOffset - OldSize + NewSize;
+    if (NewOffset > CurrentBlockSize)
+    {
+        return false;
+    }
+
+    FrameBytesUsed += NewSize - OldSize;
+    CurrentOffset = NewOffset;
+    return true;
+}
@@ -0,0 +1,195 @@
+﻿// XGFrameArena.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/**
+ * \brief A linear allocator for memory that only has to live until the end of the current frame
+ * \details Allocating moves an offset forward, and Reset moves it back to the start, so nothing is freed one
+ * allocation at a time. When a frame needs more memory than the arena holds, extra blocks are taken from the heap, and
+ * the next Reset replaces all of them with a single block big enough for the largest frame so far. Frames that fit in
+ * that block never touch the heap.
+ */
+class XGFrameArena
+{
+public:
+    XGFrameArena() = default;
+    ~XGFrameArena();
+
+    XGFrameArena(const XGFrameArena&) = delete;
+    XGFrameArena& operator=(const XGFrameArena&) = delete;
+
+    /**
+     * \brief Releases every allocation made since the last reset. Pointers into the arena become invalid.
+     */
+    void Reset();
+
+    /**
+     * \brief Returns Size bytes of uninitialized memory aligned to Alignment, which must be a power of two
+     */
+    void* Allocate(size_t Size, size_t Alignment = alignof(std::max_align_t));
+
+    /**
+     * \brief Extends the most recent allocation in place if there is room for it in the current block
+     * \param Allocation The memory returned by the most recent call to Allocate
+     * \param OldSize The size the allocation was made with
+     * \param NewSize The size the allocation should have
+     * \return False if the allocation couldn't be extended. It is left unchanged in that case.
+     */
+    bool TryGrow(void* Allocation, size_t OldSize, size_t NewSize);
+
+    /**
+     * \brief Returns uninitialized storage for Count objects of type T
+     */
+    template <typename T>
+    T* AllocateArray(size_t Count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "The frame arena never runs destructors");
+        return static_cast<T*>(Allocate(Count * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * \brief The number of bytes allocated since the last reset, including padding for alignment
+     * \details This is what the frame's allocations take from a single block, even when the frame overflowed into
+     * several, so it is what the block has to hold for the same frame to fit next time.
+     */
+    size_t GetBytesUsed() const { return FrameBytesUsed; }
+
+    /**
+     * \brief The size of the block frames are allocated from when they don't overflow it
+     */
+    size_t GetCapacity() const { return Capacity; }
+
+    /**
+     * \brief The number of bytes the arena currently holds from the heap, including blocks taken when a frame overflowed
+     */
+    size_t GetReservedBytes() const { return Capacity + OverflowBytes; }
+
+    /**
+     * \brief The most bytes any single frame has used
+     */
+    size_t GetHighWaterMark() const { return HighWaterMark; }
+
+    /**
+     * \brief The number of blocks the arena has taken from the heap since it was created
+     */
+    size_t GetHeapAllocationCount() const { return HeapAllocationCount; }
+
+private:
+    /**
+     * \brief The block frames are allocated from, which is sized to fit the largest frame so far
+     */
+    unsigned char* Buffer = nullptr;
+    size_t Capacity = 0;
+
+    /**
+     * \brief Blocks taken from the heap during the current frame because Buffer ran out of room
+     */
+    std::vector<unsigned char*> OverflowBlocks;
+    size_t OverflowBytes = 0;
+
+    /**
+     * \brief The block allocations are currently made from, which is either Buffer or the last overflow block
+     */
+    unsigned char* CurrentBlock = nullptr;
+    size_t CurrentBlockSize = 0;
+    size_t CurrentOffset = 0;
+
+    size_t FrameBytesUsed = 0;
+    size_t HighWaterMark = 0;
+    size_t HeapAllocationCount = 0;
+
+    /**
+     * \brief The number of blocks taken from the heap during the current frame
+     */
+    size_t FrameHeapAllocationCount = 0;
+
+    /**
+     * \brief Whether the block fit the largest frame so far when the current frame started
+     */
+    bool IsWarmedUp = false;
+};
+
+/**
+ * \brief A growable array whose elements live in a frame arena
+ * \details Elements are never constructed or destroyed, so T must be trivially copyable. Growing tries to extend the
+ * array in place first, and otherwise copies it to a new allocation with twice the capacity. The old allocation is
+ * reclaimed when the arena is reset.
+ */
+template <typename T>
+class XGFrameArray
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Frame arrays are moved around with memcpy");
+
+public:
+    explicit XGFrameArray(XGFrameArena& Arena, size_t InitialCapacity = 0) : Arena(Arena)
+    {
+        Reserve(InitialCapacity);
+    }
+
+    void Reserve(size_t NewCapacity)
+    {
+        if (NewCapacity <= Capacity)
+        {
+            return;
+        }
+
+        if (Data == nullptr || !Arena.TryGrow(Data, Capacity * sizeof(T), NewCapacity * sizeof(T)))
+        {
+            T* NewData = Arena.AllocateArray<T>(NewCapacity);
+            if (Size > 0)
+            {
+                std::memcpy(NewData, Data, Size * sizeof(T));
+            }
+            Data = NewData;
+        }
+        Capacity = NewCapacity;
+    }
+
+    /**
+     * \brief Changes the number of elements. New elements are left uninitialized.
+     */
+    void Resize(size_t NewSize)
+    {
+        Reserve(NewSize);
+        Size = NewSize;
+    }
+
+    void Add(const T& Element)
+    {
+        if (Size == Capacity)
+        {
+            Reserve(Capacity < 16 ? 16 : Capacity * 2);
+        }
+        Data[Size++] = Element;
+    }
+
+    void Clear() { Size = 0; }
+
+    size_t GetSize() const { return Size; }
+    bool IsEmpty() const { return Size == 0; }
+
+    T* GetData() { return Data; }
+    const T* GetData() const { return Data; }
+
+    T& operator[](size_t Index) { return Data[Index]; }
+    const T& operator[](size_t Index) const { return Data[Index]; }
+
+    T* begin() { return Data; }
+    T* end() { return Data + Size; }
+    const T* begin() const { return Data; }
+    const T* end() const { return Data + Size; }
+
+private:
+    XGFrameArena& Arena;
+    T* Data = nullptr;
+    size_t Size = 0;
+    size_t Capacity = 0;
+};
@@ -0,0 +1,647 @@
+﻿// XGLightmap.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGLightmap.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "XGTriangle.h"
+
+namespace
+{
+    constexpr uint32_t LightmapFileMagic = 0x4D4C4758; // "XGLM"
+    constexpr uint32_t LightmapFileVersion = 1;
+
+    /**
+     * \brief The start of a lightmap file. The texels follow it, row by row.
+     */
+    struct XGLightmapFileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t Width;
+        uint32_t Height;
+
+        /**
+         * \brief The triangle count of the mesh the lightmap was baked for, and the rectangle it covers
+         */
+        uint32_t TriangleCount;
+        float OriginX;
+        float OriginZ;
+        float SizeX;
+        float SizeZ;
+    };
+
+    /**
+     * \brief The most triangles a leaf of the bake's bounding volume hierarchy holds
+     */
+    constexpr size_t MaxTrianglesPerLeaf = 4;
+
+    /**
+     * \brief A node of the bounding volume hierarchy rays are traced through while baking
+     */
+    struct XGBakeNode
+    {
+        XGBoundingBox Bounds;
+
+        /**
+         * \brief For a leaf, its first triangle. Otherwise, the first of its two children, which are next to each other.
+         */
+        uint32_t First;
+
+        /**
+         * \brief The number of triangles in a leaf, or zero for a node with children
+         */
+        uint32_t TriangleCount;
+    };
+
+    /**
+     * \brief The triangles of a mesh in model space, ordered so each leaf's triangles are contiguous, and the hierarchy
+     * of boxes around them
+     */
+    struct XGBakeScene
+    {
+        std::vector<XGTriangle> Triangles;
+        std::vector<XGBakeNode> Nodes;
+    };
+
+    /**
+     * \brief Splits a range of triangles in half at the median of their centroids along the longest axis of their
+     * bounds, until each range is small enough to be a leaf
+     * \param TriangleOrder The indices of the mesh's triangles, reordered in place
+     */
+    void BuildBakeNode(const std::vector<XGTriangle>& Triangles, const std::vector<XGVector3D>& Centroids, std::vector<uint32_t>& TriangleOrder, size_t NodeIndex, size_t First, size_t Count, std::vector<XGBakeNode>& Nodes)
+    {
+        XGBoundingBox Bounds;
+        XGBoundingBox CentroidBounds;
+        for (size_t OrderIndex = First; OrderIndex < First + Count; ++OrderIndex)
+        {
+            const XGTriangle& Triangle = Triangles[TriangleOrder[OrderIndex]];
+            Bounds.Expand(Triangle.Points[0]);
+            Bounds.Expand(Triangle.Points[1]);
+            Bounds.Expand(Triangle.Points[2]);
+            CentroidBounds.Expand(Centroids[TriangleOrder[OrderIndex]]);
+        }
+
+        Nodes[NodeIndex].Bounds = Bounds;
+        if (Count <= MaxTrianglesPerLeaf)
+        {
+            Nodes[NodeIndex].First = static_cast<uint32_t>(First);
+            Nodes[NodeIndex].TriangleCount = static_cast<uint32_t>(Count);
+            return;
+        }
+
+        const XGVector3D CentroidSize = CentroidBounds.GetSize();
+        const int Axis = CentroidSize.X >= CentroidSize.Y && CentroidSize.X >= CentroidSize.Z ? 0 : (CentroidSize.Y >= CentroidSize.Z ? 1 : 2);
+        const size_t HalfCount = Count / 2;
+        std::nth_element(
+            TriangleOrder.begin() + static_cast<std::ptrdiff_t>(First),
+            TriangleOrder.begin() + static_cast<std::ptrdiff_t>(First + HalfCount),
+            TriangleOrder.begin() + static_cast<std::ptrdiff_t>(First + Count),
+            [&](uint32_t Triangle1, uint32_t Triangle2)
+            {
+                const XGVector3D& Centroid1 = Centroids[Triangle1];
+                const XGVector3D& Centroid2 = Centroids[Triangle2];
+                return Axis == 0 ? Centroid1.X < Centroid2.X : (Axis == 1 ? Centroid1.Y < Centroid2.Y : Centroid1.Z < Centroid2.Z);
+            }
+        );
+
+        const size_t ChildIndex = Nodes.size();
+        Nodes[NodeIndex].First = static_cast<uint32_t>(ChildIndex);
+        Nodes[NodeIndex].TriangleCount = 0;
+        Nodes.resize(Nodes.size() + 2);
+        BuildBakeNode(Triangles, Centroids, TriangleOrder, ChildIndex, First, HalfCount, Nodes);
+        BuildBakeNode(Triangles, Centroids, TriangleOrder, ChildIndex + 1, First + HalfCount, Count - HalfCount, Nodes);
+    }
+
+    /**
+     * \brief Builds the bounding volume hierarchy of a mesh's triangles
+     */
+    void BuildBakeScene(const XGMesh& Mesh, XGBakeScene& OutScene)
+    {
+        std::vector<XGTriangle> Triangles;
+        std::vector<XGVector3D> Centroids;
+        std::vector<uint32_t> TriangleOrder;
+        Triangles.reserve(Mesh.GetTriangleCount());
+        Centroids.reserve(Mesh.GetTriangleCount());
+        for (size_t TriangleIndex = 0; TriangleIndex < Mesh.GetTriangleCount(); ++TriangleIndex)
+        {
+            Triangles.push_back(Mesh.GetTriangle(TriangleIndex));
+            Centroids.push_back((Triangles.back().Points[0] + Triangles.back().Points[1] + Triangles.back().Points[2]) / 3.0f);
+            TriangleOrder.push_back(static_cast<uint32_t>(TriangleIndex));
+        }
+
+        OutScene.Nodes.reserve(Mesh.GetTriangleCount() * 2 / MaxTrianglesPerLeaf + 1);
+        OutScene.Nodes.resize(1);
+        BuildBakeNode(Triangles, Centroids, TriangleOrder, 0, 0, Triangles.size(), OutScene.Nodes);
+
+        OutScene.Triangles.reserve(Triangles.size());
+        for (uint32_t TriangleIndex : TriangleOrder)
+        {
+            OutScene.Triangles.push_back(Triangles[TriangleIndex]);
+        }
+    }
+
+    /**
+     * \brief Returns true if a ray passes through a box before it has travelled MaxDistance
+     * \param InverseDirection One over each component of the ray's direction
+     */
+    bool DoesRayHitBox(const XGVector3D& Origin, const XGVector3D& InverseDirection, const XGBoundingBox& Box, float MaxDistance)
+    {
+        float NearDistance = 0.0f;
+        float FarDistance = MaxDistance;
+        const float Origins[3] = { Origin.X, Origin.Y, Origin.Z };
+        const float InverseDirections[3] = { InverseDirection.X, InverseDirection.Y, InverseDirection.Z };
+        const float Mins[3] = { Box.Min.X, Box.Min.Y, Box.Min.Z };
+        const float Maxes[3] = { Box.Max.X, Box.Max.Y, Box.Max.Z };
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            float Distance1 = (Mins[Axis] - Origins[Axis]) * InverseDirections[Axis];
+            float Distance2 = (Maxes[Axis] - Origins[Axis]) * InverseDirections[Axis];
+            if (Distance1 > Distance2)
+            {
+                std::swap(Distance1, Distance2);
+            }
+
+            // A ray parallel to the slab gives NaN when it starts on one of its planes, which is ignored here
+            NearDistance = Distance1 > NearDistance ? Distance1 : NearDistance;
+            FarDistance = Distance2 < FarDistance ? Distance2 : FarDistance;
+            if (NearDistance > FarDistance)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Finds where a ray crosses a triangle, from either side
+     * \param OutDistance The distance along the ray to the crossing, when there is one
+     * \return False if the ray misses the triangle or crosses it behind its origin
+     */
+    bool DoesRayHitTriangle(const XGVector3D& Origin, const XGVector3D& Direction, const XGTriangle& Triangle, float& OutDistance)
+    {
+        const XGVector3D Side1 = Triangle.Points[1] - Triangle.Points[0];
+        const XGVector3D Side2 = Triangle.Points[2] - Triangle.Points[0];
+        const XGVector3D DirectionCrossSide2 = Direction.CrossProduct(Side2);
+        const float Determinant = Side1.DotProduct(DirectionCrossSide2);
+        if (std::fabs(Determinant) < 1e-12f)
+        {
+            return false;
+        }
+
+        const float InverseDeterminant = 1.0f / Determinant;
+        const XGVector3D OriginOffset = Origin - Triangle.Points[0];
+        const float Weight1 = OriginOffset.DotProduct(DirectionCrossSide2) * InverseDeterminant;
+        if (Weight1 < 0.0f || Weight1 > 1.0f)
+        {
+            return false;
+        }
+
+        const XGVector3D OffsetCrossSide1 = OriginOffset.CrossProduct(Side1);
+        const float Weight2 = Direction.DotProduct(OffsetCrossSide1) * InverseDeterminant;
+        if (Weight2 < 0.0f || Weight1 + Weight2 > 1.0f)
+        {
+            return false;
+        }
+
+        OutDistance = Side2.DotProduct(OffsetCrossSide1) * InverseDeterminant;
+        return OutDistance > 0.0f;
+    }
+
+    /**
+     * \brief Finds the first triangle a ray hits before it has travelled MaxDistance
+     * \param ShouldStopAtAnyHit True when only whether something is hit matters, not what is hit first
+     * \return The index of the triangle in the scene, or -1 if nothing is hit
+     */
+    int CastRay(const XGBakeScene& Scene, const XGVector3D& Origin, const XGVector3D& Direction, float MaxDistance, bool ShouldStopAtAnyHit, float& OutDistance)
+    {
+        const XGVector3D InverseDirection = { 1.0f / Direction.X, 1.0f / Direction.Y, 1.0f / Direction.Z };
+        int HitTriangle = -1;
+        OutDistance = MaxDistance;
+
+        // The hierarchy is balanced, so its depth is at most the number of bits in a triangle index
+        uint32_t NodeStack[64];
+        int StackSize = 0;
+        NodeStack[StackSize++] = 0;
+        while (StackSize > 0)
+        {
+            const XGBakeNode& Node = Scene.Nodes[NodeStack[--StackSize]];
+            if (!DoesRayHitBox(Origin, InverseDirection, Node.Bounds, OutDistance))
+            {
+                continue;
+            }
+
+            if (Node.TriangleCount == 0)
+            {
+                NodeStack[StackSize++] = Node.First;
+                NodeStack[StackSize++] = Node.First + 1;
+                continue;
+            }
+
+            for (uint32_t TriangleIndex = Node.First; TriangleIndex < Node.First + Node.TriangleCount; ++TriangleIndex)
+            {
+                float Distance;
+                if (DoesRayHitTriangle(Origin, Direction, Scene.Triangles[TriangleIndex], Distance) && Distance < OutDistance)
+                {
+                    HitTriangle = static_cast<int>(TriangleIndex);
+                    OutDistance = Distance;
+                    if (ShouldStopAtAnyHit)
+                    {
+                        return HitTriangle;
+                    }
+                }
+            }
+        }
+
+        return HitTriangle;
+    }
+
+    /**
+     * \brief Returns the bits of an integer in reverse order, as a fraction from 0 to 1, which spreads successive
+     * integers evenly over the range
+     */
+    float GetRadicalInverse(uint32_t Bits)
+    {
+        Bits = (Bits << 16) | (Bits >> 16);
+        Bits = ((Bits & 0x55555555u) << 1) | ((Bits & 0xAAAAAAAAu) >> 1);
+        Bits = ((Bits & 0x33333333u) << 2) | ((Bits & 0xCCCCCCCCu) >> 2);
+        Bits = ((Bits & 0x0F0F0F0Fu) << 4) | ((Bits & 0xF0F0F0F0u) >> 4);
+        Bits = ((Bits & 0x00FF00FFu) << 8) | ((Bits & 0xFF00FF00u) >> 8);
+        return static_cast<float>(Bits) * 2.3283064365386963e-10f;
+    }
+
+    /**
+     * \brief Returns a fraction from 0 to 1 that looks random but is always the same for the same texel
+     */
+    float HashTexel(int X, int Y)
+    {
+        uint32_t Hash = static_cast<uint32_t>(X) * 0x8DA6B343u ^ static_cast<uint32_t>(Y) * 0xD8163841u;
+        Hash ^= Hash >> 15;
+        Hash *= 0x2C1B3C6Du;
+        Hash ^= Hash >> 12;
+        return static_cast<float>(Hash >> 8) * (1.0f / 16777216.0f);
+    }
+}
+
+bool XGLightmap::Bake(const XGMesh& Mesh, const XGVector3D& LightDirection, const XGLightmapBakeSettings& Settings)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    using Milliseconds = std::chrono::duration<float, std::milli>;
+    const Clock::time_point BakeStartTime = Clock::now();
+
+    Release();
+    if (Mesh.GetTriangleCount() == 0 || Settings.Width <= 0 || Settings.Height <= 0)
+    {
+        return false;
+    }
+
+    // Rays start on the surface, inside the bounds of the mesh's clusters, so they are traced through a hierarchy of
+    // much smaller boxes instead
+    XGBakeScene Scene;
+    BuildBakeScene(Mesh, Scene);
+
+    Width = Settings.Width;
+    Height = Settings.Height;
+    SetBounds(Mesh.Bounds);
+    std::vector<uint8_t> Brightnesses(static_cast<size_t>(Width) * static_cast<size_t>(Height), 0);
+
+    // Rays leave the surface from just above it, so they don't hit the triangle they start on
+    const float MeshExtent = Mesh.Bounds.GetSize().GetLength();
+    const float SurfaceOffset = MeshExtent * 1e-4f;
+    const float SkyRayLength = Settings.SkyRayLength > 0.0f ? Settings.SkyRayLength : MeshExtent;
+    const int SkyRayCount = std::max(Settings.SkyRayCount, 0);
+
+    std::vector<bool> IsTexelCovered(Brightnesses.size(), false);
+    for (int TexelY = 0; TexelY < Height; ++TexelY)
+    {
+        for (int TexelX = 0; TexelX < Width; ++TexelX)
+        {
+            // Find the surface under the middle of the texel
+            const XGVector3D DownOrigin = {
+                OriginX + (static_cast<float>(TexelX) + 0.5f) * SizeX / static_cast<float>(Width),
+                Mesh.Bounds.Max.Y + 1.0f,
+                OriginZ + (static_cast<float>(TexelY) + 0.5f) * SizeZ / static_cast<float>(Height)
+            };
+            const XGVector3D Down = { 0.0f, -1.0f, 0.0f };
+            float SurfaceDistance;
+            const int SurfaceTriangle = CastRay(Scene, DownOrigin, Down, FLT_MAX, false, SurfaceDistance);
+            if (SurfaceTriangle < 0)
+            {
+                continue;
+            }
+
+            // The surface is seen from above, so its normal points up whichever way the triangle is wound
+            XGVector3D Normal = Scene.Triangles[static_cast<size_t>(SurfaceTriangle)].GetNormal();
+            if (Normal.Y < 0.0f)
+            {
+                Normal *= -1.0f;
+            }
+
+            const XGVector3D SurfacePoint = DownOrigin + Down * SurfaceDistance + Normal * SurfaceOffset;
+
+            float LightAmount = std::max(0.0f, Normal.DotProduct(LightDirection));
+            float HitDistance;
+            if (LightAmount > 0.0f && CastRay(Scene, SurfacePoint, LightDirection, FLT_MAX, true, HitDistance) >= 0)
+            {
+                LightAmount = 0.0f;
+            }
+
+            // Sky rays are spread over the hemisphere around the normal, denser toward the normal the way the sky's
+            // light falls on a surface. Each texel turns the pattern by its own angle, so neighbouring texels don't
+            // share the same gaps.
+            const XGVector3D Helper = std::fabs(Normal.X) < 0.9f ? XGVector3D(1.0f, 0.0f, 0.0f) : XGVector3D(0.0f, 1.0f, 0.0f);
+            const XGVector3D Tangent = Helper.CrossProduct(Normal).GetNormalizedCopy();
+            const XGVector3D Bitangent = Normal.CrossProduct(Tangent);
+            const float PatternAngle = HashTexel(TexelX, TexelY);
+            int VisibleSkyRays = 0;
+            for (int RayIndex = 0; RayIndex < SkyRayCount; ++RayIndex)
+            {
+                const float RadiusSquared = (static_cast<float>(RayIndex) + 0.5f) / static_cast<float>(SkyRayCount);
+                const float Angle = 6.2831853f * (GetRadicalInverse(static_cast<uint32_t>(RayIndex)) + PatternAngle);
+                const float Radius = std::sqrt(RadiusSquared);
+                const XGVector3D RayDirection =
+                    Tangent * (Radius * std::cos(Angle)) +
+                    Bitangent * (Radius * std::sin(Angle)) +
+                    Normal * std::sqrt(1.0f - RadiusSquared);
+                if (CastRay(Scene, SurfacePoint, RayDirection, SkyRayLength, true, HitDistance) < 0)
+                {
+                    ++VisibleSkyRays;
+                }
+            }
+
+            const float SkyAmount = SkyRayCount > 0 ? static_cast<float>(VisibleSkyRays) / static_cast<float>(SkyRayCount) : 1.0f;
+            const float Brightness = std::min(1.0f, Settings.SkyIntensity * SkyAmount + Settings.LightIntensity * LightAmount);
+            const size_t TexelIndex = static_cast<size_t>(TexelY) * static_cast<size_t>(Width) + static_cast<size_t>(TexelX);
+            Brightnesses[TexelIndex] = static_cast<uint8_t>(Brightness * 255.0f + 0.5f);
+            IsTexelCovered[TexelIndex] = true;
+        }
+    }
+
+    // Texels that no part of the mesh lies under are still blended into the ones next to them by bilinear filtering,
+    // so they are grown into from their covered neighbours until none are left
+    bool IsAnyTexelCovered = std::find(IsTexelCovered.begin(), IsTexelCovered.end(), true) != IsTexelCovered.end();
+    if (!IsAnyTexelCovered)
+    {
+        std::fill(Brightnesses.begin(), Brightnesses.end(), 255);
+    }
+
+    std::vector<bool> IsNextTexelCovered;
+    while (IsAnyTexelCovered && std::find(IsTexelCovered.begin(), IsTexelCovered.end(), false) != IsTexelCovered.end())
+    {
+        IsNextTexelCovered = IsTexelCovered;
+        for (int TexelY = 0; TexelY < Height; ++TexelY)
+        {
+            for (int TexelX = 0; TexelX < Width; ++TexelX)
+            {
+                const size_t TexelIndex = static_cast<size_t>(TexelY) * static_cast<size_t>(Width) + static_cast<size_t>(TexelX);
+                if (IsTexelCovered[TexelIndex])
+                {
+                    continue;
+                }
+
+                int BrightnessSum = 0;
+                int NeighbourCount = 0;
+                for (int NeighbourY = std::max(TexelY - 1, 0); NeighbourY <= std::min(TexelY + 1, Height - 1); ++NeighbourY)
+                {
+                    for (int NeighbourX = std::max(TexelX - 1, 0); NeighbourX <= std::min(TexelX + 1, Width - 1); ++NeighbourX)
+                    {
+                        const size_t NeighbourIndex = static_cast<size_t>(NeighbourY) * static_cast<size_t>(Width) + static_cast<size_t>(NeighbourX);
+                        if (IsTexelCovered[NeighbourIndex])
+                        {
+                            BrightnessSum += Brightnesses[NeighbourIndex];
+                            ++NeighbourCount;
+                        }
+                    }
+                }
+
+                if (NeighbourCount > 0)
+                {
+                    Brightnesses[TexelIndex] = static_cast<uint8_t>((BrightnessSum + NeighbourCount / 2) / NeighbourCount);
+                    IsNextTexelCovered[TexelIndex] = true;
+                }
+            }
+        }
+
+        IsTexelCovered.swap(IsNextTexelCovered);
+    }
+
+    SetTexels(Brightnesses.data());
+    BuildMappings(Mesh);
+
+    std::cout << "XGLightmap::Bake: " << Width << "x" << Height << " texels, " << SkyRayCount << " sky rays each, in "
+        << Milliseconds(Clock::now() - BakeStartTime).count() << " ms" << std::endl;
+
+    return true;
+}
+
+bool XGLightmap::LoadFromFile(const std::string& FilePath, const XGMesh& Mesh)
+{
+    Release();
+
+    std::ifstream File(FilePath, std::ios::binary);
+    XGLightmapFileHeader Header;
+    if (!File.read(reinterpret_cast<char*>(&Header), sizeof(Header)) || Header.Magic != LightmapFileMagic ||
+        Header.Version != LightmapFileVersion || Header.Width == 0 || Header.Height == 0 ||
+        Header.TriangleCount != static_cast<uint32_t>(Mesh.GetTriangleCount()))
+    {
+        return false;
+    }
+
+    // A lightmap baked for a different mesh with the same number of triangles would still be lit wrongly
+    SetBounds(Mesh.Bounds);
+    if (Header.OriginX != OriginX || Header.OriginZ != OriginZ || Header.SizeX != SizeX || Header.SizeZ != SizeZ)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> Brightnesses(static_cast<size_t>(Header.Width) * static_cast<size_t>(Header.Height));
+    if (!File.read(reinterpret_cast<char*>(Brightnesses.data()), static_cast<std::streamsize>(Brightnesses.size())))
+    {
+        return false;
+    }
+
+    Width = static_cast<int>(Header.Width);
+    Height = static_cast<int>(Header.Height);
+    SetTexels(Brightnesses.data());
+    BuildMappings(Mesh);
+    return true;
+}
+
+bool XGLightmap::SaveToFile(const std::string& FilePath) const
+{
+    if (IsEmpty())
+    {
+        return false;
+    }
+
+    std::ofstream File(FilePath, std::ios::binary);
+    if (!File)
+    {
+        return false;
+    }
+
+    const XGLightmapFileHeader Header = {
+        LightmapFileMagic,
+        LightmapFileVersion,
+        static_cast<uint32_t>(Width),
+        static_cast<uint32_t>(Height),
+        static_cast<uint32_t>(Mappings.size()),
+        OriginX,
+        OriginZ,
+        SizeX,
+        SizeZ
+    };
+    File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+
+    // The border is rebuilt when the file is loaded, so only the texels inside it are saved
+    const size_t PaddedWidth = static_cast<size_t>(Width) + 2;
+    for (int Y = 0; Y < Height; ++Y)
+    {
+        File.write(reinterpret_cast<const char*>(&Texels[(static_cast<size_t>(Y) + 1) * PaddedWidth + 1]), static_cast<std::streamsize>(Width));
+    }
+
+    return static_cast<bool>(File);
+}
+
+void XGLightmap::Release()
+{
+    Width = 0;
+    Height = 0;
+    std::vector<uint8_t>().swap(Texels);
+    std::vector<XGLightmapMapping>().swap(Mappings);
+}
+
+size_t XGLightmap::GetMemoryUsage() const
+{
+    return Texels.capacity() * sizeof(uint8_t) + Mappings.capacity() * sizeof(XGLightmapMapping);
+}
+
+XGVector2D XGLightmap::GetTextureCoordinate(const XGVector3D& ModelPosition) const
+{
+    XGVector2D TextureCoordinate;
+    TextureCoordinate.U = (ModelPosition.X - OriginX) / SizeX;
+    TextureCoordinate.V = (ModelPosition.Z - OriginZ) / SizeZ;
+    return TextureCoordinate;
+}
+
+void XGLightmap::ApplyBatch(const XGLightmapMapping& Mapping, const float* U, const float* V, int Count, olc::Pixel* InOutColors) const
+{
+    // Clamping to just inside the border keeps the texel to the right of and below every sample inside it too. The
+    // border shifts every texel over by one, so coordinates are moved over to match, which also makes them positive so
+    // truncating them rounds down.
+    const uint8_t* const PaddedTexels = Texels.data();
+    const size_t PaddedWidth = static_cast<size_t>(Width) + 2;
+    const float MaxTexelX = static_cast<float>(Width) - 1.0f / 256.0f;
+    const float MaxTexelY = static_cast<float>(Height) - 1.0f / 256.0f;
+    for (int Index = 0; Index < Count; ++Index)
+    {
+        const float MappedX = Mapping.TexelXFromU * U[Index] + Mapping.TexelXFromV * V[Index] + Mapping.TexelXOffset;
+        const float MappedY = Mapping.TexelYFromU * U[Index] + Mapping.TexelYFromV * V[Index] + Mapping.TexelYOffset;
+        const float TexelX = std::min(std::max(MappedX, -1.0f), MaxTexelX) + 1.0f;
+        const float TexelY = std::min(std::max(MappedY, -1.0f), MaxTexelY) + 1.0f;
+        const int X0 = static_cast<int>(TexelX);
+        const int Y0 = static_cast<int>(TexelY);
+        const int WeightX = static_cast<int>((TexelX - static_cast<float>(X0)) * 256.0f);
+        const int WeightY = static_cast<int>((TexelY - static_cast<float>(Y0)) * 256.0f);
+
+        const uint8_t* Row0 = PaddedTexels + static_cast<size_t>(Y0) * PaddedWidth + static_cast<size_t>(X0);
+        const uint8_t* Row1 = Row0 + PaddedWidth;
+        const int Top = Row0[0] * (256 - WeightX) + Row0[1] * WeightX;
+        const int Bottom = Row1[0] * (256 - WeightX) + Row1[1] * WeightX;
+        const int Brightness = (Top * (256 - WeightY) + Bottom * WeightY + (1 << 15)) >> 16;
+
+        // Scale 0 to 255 up to 0 to 256, so a fully lit texel leaves the color exactly as it is after the shift
+        // The color is changed in a copy and written back whole, since writing single bytes of the batch would make the
+        // compiler assume any of them could have changed the texels
+        const int Scale = Brightness + (Brightness >> 7);
+        olc::Pixel Color = InOutColors[Index];
+        Color.r = static_cast<uint8_t>((Color.r * Scale) >> 8);
+        Color.g = static_cast<uint8_t>((Color.g * Scale) >> 8);
+        Color.b = static_cast<uint8_t>((Color.b * Scale) >> 8);
+        InOutColors[Index] = Color;
+    }
+}
+
+void XGLightmap::SetBounds(const XGBoundingBox& Bounds)
+{
+    // A mesh that is flat along one axis still needs a rectangle with some size to divide by
+    OriginX = Bounds.Min.X;
+    OriginZ = Bounds.Min.Z;
+    SizeX = std::max(Bounds.Max.X - Bounds.Min.X, FLT_MIN);
+    SizeZ = std::max(Bounds.Max.Z - Bounds.Min.Z, FLT_MIN);
+}
+
+void XGLightmap::BuildMappings(const XGMesh& Mesh)
+{
+    Mappings.resize(Mesh.GetTriangleCount());
+    for (size_t TriangleIndex = 0; TriangleIndex < Mesh.GetTriangleCount(); ++TriangleIndex)
+    {
+        // Find where each point lies in the lightmap, in texels, with texel centers at whole numbers so bilinear
+        // sampling can use the coordinates as they are
+        const XGTriangle Triangle = Mesh.GetTriangle(TriangleIndex);
+        float TexelX[3];
+        float TexelY[3];
+        for (int PointIndex = 0; PointIndex < 3; ++PointIndex)
+        {
+            const XGVector2D LightmapCoordinate = GetTextureCoordinate(Triangle.Points[PointIndex]);
+            TexelX[PointIndex] = LightmapCoordinate.U * static_cast<float>(Width) - 0.5f;
+            TexelY[PointIndex] = LightmapCoordinate.V * static_cast<float>(Height) - 0.5f;
+        }
+
+        // Solve for the map that takes each point's texture coordinates to its texel position
+        const XGVector2D* TextureCoordinates = Triangle.TextureCoordinates;
+        const float Side1U = TextureCoordinates[1].U - TextureCoordinates[0].U;
+        const float Side1V = TextureCoordinates[1].V - TextureCoordinates[0].V;
+        const float Side2U = TextureCoordinates[2].U - TextureCoordinates[0].U;
+        const float Side2V = TextureCoordinates[2].V - TextureCoordinates[0].V;
+        const float Determinant = Side1U * Side2V - Side2U * Side1V;
+
+        XGLightmapMapping& Mapping = Mappings[TriangleIndex];
+        if (std::fabs(Determinant) < 1e-12f)
+        {
+            Mapping.TexelXFromU = 0.0f;
+            Mapping.TexelXFromV = 0.0f;
+            Mapping.TexelXOffset = (TexelX[0] + TexelX[1] + TexelX[2]) / 3.0f;
+            Mapping.TexelYFromU = 0.0f;
+            Mapping.TexelYFromV = 0.0f;
+            Mapping.TexelYOffset = (TexelY[0] + TexelY[1] + TexelY[2]) / 3.0f;
+            continue;
+        }
+
+        const float InverseDeterminant = 1.0f / Determinant;
+        const float Side1X = TexelX[1] - TexelX[0];
+        const float Side2X = TexelX[2] - TexelX[0];
+        const float Side1Y = TexelY[1] - TexelY[0];
+        const float Side2Y = TexelY[2] - TexelY[0];
+        Mapping.TexelXFromU = (Side1X * Side2V - Side2X * Side1V) * InverseDeterminant;
+        Mapping.TexelXFromV = (Side2X * Side1U - Side1X * Side2U) * InverseDeterminant;
+        Mapping.TexelXOffset = TexelX[0] - Mapping.TexelXFromU * TextureCoordinates[0].U - Mapping.TexelXFromV * TextureCoordinates[0].V;
+        Mapping.TexelYFromU = (Side1Y * Side2V - Side2Y * Side1V) * InverseDeterminant;
+        Mapping.TexelYFromV = (Side2Y * Side1U - Side1Y * Side2U) * InverseDeterminant;
+        Mapping.TexelYOffset = TexelY[0] - Mapping.TexelYFromU * TextureCoordinates[0].U - Mapping.TexelYFromV * TextureCoordinates[0].V;
+    }
+}
+
+void XGLightmap::SetTexels(const uint8_t* Brightnesses)
+{
+    const size_t PaddedWidth = static_cast<size_t>(Width) + 2;
+    Texels.resize(PaddedWidth * (static_cast<size_t>(Height) + 2));
+    for (int PaddedY = 0; PaddedY < Height + 2; ++PaddedY)
+    {
+        const size_t SourceRow = static_cast<size_t>(std::min(std::max(PaddedY - 1, 0), Height - 1)) * static_cast<size_t>(Width);
+        for (int PaddedX = 0; PaddedX < Width + 2; ++PaddedX)
+        {
+            const size_t SourceX = static_cast<size_t>(std::min(std::max(PaddedX - 1, 0), Width - 1));
+            Texels[static_cast<size_t>(PaddedY) * PaddedWidth + static_cast<size_t>(PaddedX)] = Brightnesses[SourceRow + SourceX];
+        }
+    }
+}
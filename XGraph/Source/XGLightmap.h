@@ -0,0 +1,166 @@
+﻿// XGLightmap.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+#include "XGMesh.h"
+#include "XGVector2D.h"
+#include "XGVector3D.h"
+
+/**
+ * \brief How a lightmap is baked
+ */
+struct XGLightmapBakeSettings
+{
+    /**
+     * \brief The number of texels along each side of the lightmap
+     */
+    int Width = 256;
+    int Height = 256;
+
+    /**
+     * \brief The number of rays cast toward the sky from each texel to find how much of the sky the mesh hides from it
+     */
+    int SkyRayCount = 32;
+
+    /**
+     * \brief How far a sky ray may travel before it counts as reaching the sky. Zero lets rays cross the whole mesh.
+     */
+    float SkyRayLength = 0.0f;
+
+    /**
+     * \brief How bright a texel is when the whole sky is visible from it, and when the light shines straight onto it
+     * without being blocked. The two are added together, and the sum is clamped to 1.
+     */
+    float SkyIntensity = 0.4f;
+    float LightIntensity = 0.6f;
+};
+
+/**
+ * \brief The affine map from a triangle's texture coordinates to the lightmap texel they lie over
+ * \details Both sets of coordinates are linear across a triangle, so each is an affine function of the other. Clipping
+ * a triangle doesn't change the map, so it is worked out once per mesh triangle rather than once per frame.
+ */
+struct XGLightmapMapping
+{
+    float TexelXFromU;
+    float TexelXFromV;
+    float TexelXOffset;
+
+    float TexelYFromU;
+    float TexelYFromV;
+    float TexelYOffset;
+};
+
+/**
+ * \brief The lighting of a static mesh, baked ahead of time into a single channel texture that textured triangles are
+ * multiplied by as they are drawn
+ * \details The lightmap covers the mesh's bounds as seen from above, so its texture coordinates, the mesh's second set,
+ * are the X and Z of each point in model space scaled to the bounds. This suits terrain, where every point can be seen
+ * from above. Each texel is lit where a ray cast straight down first hits the mesh: by the light, unless the mesh
+ * casts a shadow over it, and by the sky, scaled by how much of the sky the mesh hides from it.
+ *
+ * Baking casts many rays per texel, so a lightmap is meant to be baked once, saved, and loaded on later runs. Drawing
+ * with it costs one bilinear sample of one channel per pixel, whatever the lighting it holds, and no lighting is
+ * worked out per frame. The light direction is in model space, so instances that are rotated keep the lighting baked
+ * for the mesh.
+ */
+class XGLightmap
+{
+public:
+    /**
+     * \brief Bakes the lighting of a mesh
+     * \param LightDirection The unit direction from the mesh toward the light, in model space
+     * \return False if the mesh has no triangles or the settings have no texels
+     */
+    bool Bake(const XGMesh& Mesh, const XGVector3D& LightDirection, const XGLightmapBakeSettings& Settings);
+
+    /**
+     * \brief Loads a lightmap saved by SaveToFile
+     * \return False if the file can't be read or was baked for a mesh with different bounds or triangles
+     */
+    bool LoadFromFile(const std::string& FilePath, const XGMesh& Mesh);
+
+    bool SaveToFile(const std::string& FilePath) const;
+
+    /**
+     * \brief Frees the texels and mappings, leaving the lightmap empty
+     */
+    void Release();
+
+    bool IsEmpty() const { return Texels.empty(); }
+
+    int GetWidth() const { return Width; }
+    int GetHeight() const { return Height; }
+
+    /**
+     * \brief Returns the bytes held by the texels and the mapping of every triangle
+     */
+    size_t GetMemoryUsage() const;
+
+    /**
+     * \brief Returns the lightmap texture coordinate of a point in model space, from 0 to 1 across the mesh's bounds
+     */
+    XGVector2D GetTextureCoordinate(const XGVector3D& ModelPosition) const;
+
+    /**
+     * \brief Returns the map from the texture coordinates of one of the mesh's triangles to the lightmap
+     */
+    const XGLightmapMapping& GetMapping(size_t TriangleIndex) const { return Mappings[TriangleIndex]; }
+
+    /**
+     * \brief Multiplies a batch of texels by the lightmap, filtered bilinearly, at the texture coordinates they were
+     * sampled at. Alpha is left as it is.
+     * \param Mapping The map of the triangle the texels belong to
+     * \param Count The number of texels, up to XGTexture::SampleBatchSize
+     */
+    void ApplyBatch(const XGLightmapMapping& Mapping, const float* U, const float* V, int Count, olc::Pixel* InOutColors) const;
+
+private:
+    int Width = 0;
+    int Height = 0;
+
+    /**
+     * \brief The rectangle of the XZ plane, in model space, that the lightmap is stretched over
+     */
+    float OriginX = 0.0f;
+    float OriginZ = 0.0f;
+    float SizeX = 0.0f;
+    float SizeZ = 0.0f;
+
+    /**
+     * \brief The brightness of each texel, row by row, from 0 for unlit to 255 for fully lit
+     * \details The texels are surrounded by a border one texel wide that repeats the texels at the edges, so bilinear
+     * filtering only has to clamp the coordinate it is given, not each of the four texels it reads.
+     */
+    std::vector<uint8_t> Texels;
+
+    /**
+     * \brief The map of each of the mesh's triangles, in the order of its indices
+     */
+    std::vector<XGLightmapMapping> Mappings;
+
+    /**
+     * \brief Fits the lightmap's rectangle to the bounds of a mesh
+     */
+    void SetBounds(const XGBoundingBox& Bounds);
+
+    /**
+     * \brief Works out the map of each of a mesh's triangles. Triangles whose texture coordinates don't span an area
+     * are lit by the lightmap at their centroid.
+     */
+    void BuildMappings(const XGMesh& Mesh);
+
+    /**
+     * \brief Fills Texels, and their border, from Width by Height brightnesses stored row by row without a border
+     */
+    void SetTexels(const uint8_t* Brightnesses);
+};
@@ -0,0 +1,86 @@
+﻿// XGMaterial.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGMaterial.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+bool XGMaterial::LoadFromMaterialFile(const std::string& FilePath, std::vector<XGMaterial>& OutMaterials)
+{
+    std::ifstream FileStream(FilePath);
+    if (!FileStream.is_open())
+    {
+        std::cout << "ERROR: XGMaterial::LoadFromMaterialFile: Failed to open file stream at file path: " << FilePath << std::endl;
+        return false;
+    }
+
+    const size_t FolderEnd = FilePath.find_last_of("/\\");
+    const std::string Folder = FolderEnd == std::string::npos ? std::string() : FilePath.substr(0, FolderEnd + 1);
+
+    // Properties that appear before the first newmtl line don't belong to any material, so they are ignored
+    XGMaterial* CurrentMaterial = nullptr;
+
+    std::string Line;
+    while (std::getline(FileStream, Line))
+    {
+        std::istringstream LineStream(Line);
+        std::string Keyword;
+        LineStream >> Keyword;
+
+        if (Keyword == "newmtl")
+        {
+            // Example line:
+            // newmtl Rock
+            OutMaterials.emplace_back();
+            CurrentMaterial = &OutMaterials.back();
+            LineStream >> CurrentMaterial->Name;
+        }
+        else if (CurrentMaterial == nullptr)
+        {
+            continue;
+        }
+        else if (Keyword == "Kd")
+        {
+            // Example line:
+            // Kd 0.80000 0.75000 0.60000
+            float Red = 1.0f;
+            float Green = 1.0f;
+            float Blue = 1.0f;
+            LineStream >> Red >> Green >> Blue;
+
+            const auto ToChannel = [](float Value)
+            {
+                return static_cast<uint8_t>(std::max(0.0f, std::min(Value, 1.0f)) * 255.0f + 0.5f);
+            };
+            CurrentMaterial->DiffuseColor = olc::Pixel(ToChannel(Red), ToChannel(Green), ToChannel(Blue));
+        }
+        else if (Keyword == "map_Kd")
+        {
+            // Example line:
+            // map_Kd Textures/Rock.png
+            std::string TexturePath;
+            std::getline(LineStream >> std::ws, TexturePath);
+            while (!TexturePath.empty() && std::isspace(static_cast<unsigned char>(TexturePath.back())))
+            {
+                TexturePath.pop_back();
+            }
+
+            // Texture options like -s and -o aren't supported. When there are any, the path is taken to be the last
+            // word on the line.
+            if (TexturePath.rfind('-', 0) == 0)
+            {
+                TexturePath = TexturePath.substr(TexturePath.find_last_of(" \t") + 1);
+            }
+
+            const bool IsAbsolute = !TexturePath.empty() && (TexturePath[0] == '/' || TexturePath[0] == '\\' || TexturePath.find(':') != std::string::npos);
+            CurrentMaterial->DiffuseTexturePath = IsAbsolute ? TexturePath : Folder + TexturePath;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,39 @@
+﻿// XGMaterial.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+
+/**
+ * \brief How the triangles of a mesh that use this material look, as read from a Wavefront MTL file
+ */
+struct XGMaterial
+{
+    /**
+     * \brief The name the mesh's usemtl lines refer to the material by
+     */
+    std::string Name;
+
+    /**
+     * \brief The material's color (Kd), which its texels and flat shaded triangles are multiplied by
+     */
+    olc::Pixel DiffuseColor = olc::WHITE;
+
+    /**
+     * \brief The path of the material's texture (map_Kd), or empty if it has none. Relative paths in the file are
+     * resolved against the folder of the file.
+     */
+    std::string DiffuseTexturePath;
+
+    /**
+     * \brief Reads every material defined in an MTL file and appends them to OutMaterials
+     * \return False if the file couldn't be opened
+     */
+    static bool LoadFromMaterialFile(const std::string& FilePath, std::vector<XGMaterial>& OutMaterials);
+};
@@ -63,6 +63,16 @@ XGMatrix4x4 XGMatrix4x4::Translation(const XGVector3D& TranslationVector)
     return Translation;
 }
 
+XGMatrix4x4 XGMatrix4x4::Scale(const XGVector3D& ScaleVector)
+{
+    XGMatrix4x4 Scale;
+    Scale.Values[0][0] = ScaleVector.X;
+    Scale.Values[1][1] = ScaleVector.Y;
+    Scale.Values[2][2] = ScaleVector.Z;
+    Scale.Values[3][3] = 1.0f;
+    return Scale;
+}
+
 XGMatrix4x4 XGMatrix4x4::PerspectiveProjection(
     const float& FieldOfViewDegrees,
     const float& AspectRatio,
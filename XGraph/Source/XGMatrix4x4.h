@@ -17,6 +17,7 @@ struct XGMatrix4x4
     static XGMatrix4x4 RotationY(const float& AngleRadians);
     static XGMatrix4x4 RotationZ(const float& AngleRadians);
     static XGMatrix4x4 Translation(const XGVector3D& TranslationVector);
+    static XGMatrix4x4 Scale(const XGVector3D& ScaleVector);
     
     static XGMatrix4x4 PerspectiveProjection(
         const float& FieldOfViewDegrees,
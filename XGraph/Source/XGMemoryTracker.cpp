@@ -0,0 +1,89 @@
+﻿// XGMemoryTracker.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGMemoryTracker.h"
+
+#include <algorithm>
+#include <iostream>
+
+void XGMemoryTracker::SetBufferSize(XGMemoryCategory Category, const void* Buffer, size_t Bytes)
+{
+    XGCategoryUsage& Usage = Categories[Category];
+
+    auto Entry = std::find_if(Usage.Buffers.begin(), Usage.Buffers.end(), [Buffer](const std::pair<const void*, size_t>& Pair)
+    {
+        return Pair.first == Buffer;
+    });
+
+    size_t OldBytes = 0;
+    if (Entry != Usage.Buffers.end())
+    {
+        OldBytes = Entry->second;
+        if (Bytes > 0)
+        {
+            Entry->second = Bytes;
+        }
+        else
+        {
+            Usage.Buffers.erase(Entry);
+        }
+    }
+    else if (Bytes > 0)
+    {
+        Usage.Buffers.emplace_back(Buffer, Bytes);
+    }
+
+    Usage.CurrentBytes = Usage.CurrentBytes - OldBytes + Bytes;
+    Usage.HighWaterBytes = std::max(Usage.HighWaterBytes, Usage.CurrentBytes);
+
+    TotalBytes = TotalBytes - OldBytes + Bytes;
+    TotalHighWaterBytes = std::max(TotalHighWaterBytes, TotalBytes);
+
+    CheckBudget(Category);
+}
+
+void XGMemoryTracker::SetBudget(XGMemoryCategory Category, size_t Bytes)
+{
+    Categories[Category].Budget = Bytes;
+    Categories[Category].IsOverBudget = false;
+    CheckBudget(Category);
+}
+
+const char* XGMemoryTracker::GetCategoryName(XGMemoryCategory Category)
+{
+    switch (Category)
+    {
+    case MeshMemory:
+        return "Mesh";
+    case TextureMemory:
+        return "Texture";
+    case ColorBufferMemory:
+        return "Color buffer";
+    case DepthBufferMemory:
+        return "Depth buffer";
+    case OcclusionBufferMemory:
+        return "Occlusion buffer";
+    case FrameScratchMemory:
+        return "Frame scratch";
+    case SceneMemory:
+        return "Scene";
+    default:
+        return "Unknown";
+    }
+}
+
+void XGMemoryTracker::CheckBudget(XGMemoryCategory Category)
+{
+    XGCategoryUsage& Usage = Categories[Category];
+    const bool IsOverBudget = Usage.Budget > 0 && Usage.CurrentBytes > Usage.Budget;
+
+    if (IsOverBudget && !Usage.IsOverBudget)
+    {
+        std::cout << "WARNING: XGMemoryTracker: " << GetCategoryName(Category) << " uses " << Usage.CurrentBytes
+            << " bytes, which is over its budget of " << Usage.Budget << " bytes" << std::endl;
+    }
+
+    Usage.IsOverBudget = IsOverBudget;
+}
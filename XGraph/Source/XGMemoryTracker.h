@@ -0,0 +1,78 @@
+﻿// XGMemoryTracker.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief The kinds of memory the engine keeps track of
+ */
+enum XGMemoryCategory
+{
+    MeshMemory,
+    TextureMemory,
+    ColorBufferMemory,
+    DepthBufferMemory,
+    OcclusionBufferMemory,
+    FrameScratchMemory,
+    SceneMemory,
+    MemoryCategoryCount
+};
+
+/**
+ * \brief Keeps a running total of the memory held by every buffer the engine owns, grouped by category
+ * \details Each buffer reports its current size under its own address, so resizing a buffer replaces its old size
+ * instead of adding to it. A category that goes over its budget writes a warning to the console once, and again only
+ * after it has dropped back under the budget.
+ */
+class XGMemoryTracker
+{
+public:
+    /**
+     * \brief Records the size of one buffer
+     * \param Category The category the buffer belongs to
+     * \param Buffer Identifies the buffer. Any address that stays the same for the life of the buffer works.
+     * \param Bytes The number of bytes the buffer holds now. Zero removes the buffer.
+     */
+    void SetBufferSize(XGMemoryCategory Category, const void* Buffer, size_t Bytes);
+
+    /**
+     * \brief Sets the number of bytes a category may use before a warning is written. Zero means no budget.
+     */
+    void SetBudget(XGMemoryCategory Category, size_t Bytes);
+
+    size_t GetBudget(XGMemoryCategory Category) const { return Categories[Category].Budget; }
+    size_t GetCurrentBytes(XGMemoryCategory Category) const { return Categories[Category].CurrentBytes; }
+    size_t GetHighWaterBytes(XGMemoryCategory Category) const { return Categories[Category].HighWaterBytes; }
+
+    size_t GetTotalBytes() const { return TotalBytes; }
+    size_t GetTotalHighWaterBytes() const { return TotalHighWaterBytes; }
+
+    static const char* GetCategoryName(XGMemoryCategory Category);
+
+private:
+    struct XGCategoryUsage
+    {
+        /**
+         * \brief The address and size of every buffer in the category
+         */
+        std::vector<std::pair<const void*, size_t>> Buffers;
+
+        size_t CurrentBytes = 0;
+        size_t HighWaterBytes = 0;
+        size_t Budget = 0;
+        bool IsOverBudget = false;
+    };
+
+    XGCategoryUsage Categories[MemoryCategoryCount];
+
+    size_t TotalBytes = 0;
+    size_t TotalHighWaterBytes = 0;
+
+    void CheckBudget(XGMemoryCategory Category);
+};
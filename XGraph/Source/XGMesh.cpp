@@ -7,8 +7,105 @@
 
 #include "XGMesh.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <limits>
 #include <strstream>
+#include <unordered_map>
+
+#include "XGVertexCacheOptimizer.h"
+
+namespace
+{
+    /**
+     * \brief Renumbers the vertices in the order the triangles first use them, so the vertex fetches of each cluster
+     * walk forward through memory. Vertices that no triangle uses are dropped.
+     */
+    void ReorderVerticesByFirstUse(std::vector<XGVertex>& Vertices, std::vector<unsigned int>& Indices)
+    {
+        constexpr unsigned int UnusedVertex = 0xFFFFFFFF;
+        std::vector<unsigned int> NewVertexIndices(Vertices.size(), UnusedVertex);
+        std::vector<XGVertex> ReorderedVertices;
+        ReorderedVertices.reserve(Vertices.size());
+        for (unsigned int& Index : Indices)
+        {
+            if (NewVertexIndices[Index] == UnusedVertex)
+            {
+                NewVertexIndices[Index] = static_cast<unsigned int>(ReorderedVertices.size());
+                ReorderedVertices.push_back(Vertices[Index]);
+            }
+            Index = NewVertexIndices[Index];
+        }
+        Vertices.swap(ReorderedVertices);
+    }
+
+    /**
+     * \brief Reorders the triangles so the triangles of each material are next to each other, and fills OutGroups
+     * with the range of each material
+     * \param TriangleMaterials The index into Materials of each triangle's material
+     * \param NoMaterial The index given to triangles without a material, which are given a plain white one
+     */
+    void GroupTrianglesByMaterial(
+        std::vector<XGMaterial>& Materials,
+        const std::vector<XGVertex>& Vertices,
+        std::vector<unsigned int>& Indices,
+        std::vector<unsigned int>& TriangleMaterials,
+        unsigned int NoMaterial,
+        std::vector<XGMeshCluster>& OutGroups)
+    {
+        // Triangles without a material of their own share a plain white one
+        if (std::find(TriangleMaterials.begin(), TriangleMaterials.end(), NoMaterial) != TriangleMaterials.end())
+        {
+            const auto DefaultMaterialIndex = static_cast<unsigned int>(Materials.size());
+            Materials.emplace_back();
+            std::replace(TriangleMaterials.begin(), TriangleMaterials.end(), NoMaterial, DefaultMaterialIndex);
+        }
+
+        // Counting sort the triangles by material, which keeps the triangles of each material in their original order
+        std::vector<unsigned int> GroupStarts(Materials.size() + 1, 0);
+        for (const unsigned int MaterialIndex : TriangleMaterials)
+        {
+            GroupStarts[MaterialIndex + 1]++;
+        }
+
+        for (size_t MaterialIndex = 0; MaterialIndex < Materials.size(); ++MaterialIndex)
+        {
+            GroupStarts[MaterialIndex + 1] += GroupStarts[MaterialIndex];
+        }
+
+        OutGroups.clear();
+        for (size_t MaterialIndex = 0; MaterialIndex < Materials.size(); ++MaterialIndex)
+        {
+            const unsigned int TriangleCount = GroupStarts[MaterialIndex + 1] - GroupStarts[MaterialIndex];
+            if (TriangleCount > 0)
+            {
+                XGMeshCluster Group;
+                Group.FirstTriangle = GroupStarts[MaterialIndex];
+                Group.TriangleCount = TriangleCount;
+                Group.MaterialIndex = static_cast<unsigned int>(MaterialIndex);
+                OutGroups.push_back(Group);
+            }
+        }
+
+        std::vector<unsigned int> ReorderedIndices(Indices.size());
+        for (size_t TriangleIndex = 0; TriangleIndex < TriangleMaterials.size(); ++TriangleIndex)
+        {
+            const unsigned int NewTriangleIndex = GroupStarts[TriangleMaterials[TriangleIndex]]++;
+            std::copy(&Indices[TriangleIndex * 3], &Indices[TriangleIndex * 3] + 3, &ReorderedIndices[NewTriangleIndex * 3]);
+        }
+        Indices.swap(ReorderedIndices);
+
+        for (XGMeshCluster& Group : OutGroups)
+        {
+            for (unsigned int i = Group.FirstTriangle * 3; i < (Group.FirstTriangle + Group.TriangleCount) * 3; ++i)
+            {
+                Group.Bounds.Expand(Vertices[Indices[i]].Position);
+            }
+        }
+    }
+}
 
 bool XGMesh::LoadFromObjectFile(const std::string& FilePath, bool HasTexture, bool InvertUVMapping)
 {
@@ -19,9 +116,52 @@ bool XGMesh::LoadFromObjectFile(const std::string& FilePath, bool HasTexture, bo
         return false;
     }
 
-    std::vector<XGVector3D> Vertices;
+    std::vector<XGVector3D> Positions;
     std::vector<XGVector2D> TextureCoordinates;
 
+    // Each unique pair of position and texture coordinate indices becomes one vertex of the mesh. The file's indices
+    // are base-1, so subtract one from each before looking it up.
+    std::unordered_map<unsigned long long, unsigned int> VertexIndices;
+    const auto GetVertexIndex = [&](int PositionIndex, int TextureCoordinateIndex)
+    {
+        const unsigned long long Key = (static_cast<unsigned long long>(PositionIndex) << 32) | static_cast<unsigned int>(TextureCoordinateIndex);
+        const auto ExistingVertex = VertexIndices.find(Key);
+        if (ExistingVertex != VertexIndices.end())
+        {
+            return ExistingVertex->second;
+        }
+
+        XGVertex Vertex;
+        Vertex.Position = Positions[PositionIndex - 1];
+        if (TextureCoordinateIndex > 0)
+        {
+            Vertex.TextureCoordinate = TextureCoordinates[TextureCoordinateIndex - 1];
+        }
+
+        const auto NewVertexIndex = static_cast<unsigned int>(Vertices.size());
+        Vertices.push_back(Vertex);
+        VertexIndices.emplace(Key, NewVertexIndex);
+        return NewVertexIndex;
+    };
+
+    // The material of every triangle, in the order they appear in the file. Triangles are only grouped by material
+    // once the whole file has been read.
+    constexpr unsigned int NoMaterial = 0xFFFFFFFF;
+    std::vector<unsigned int> TriangleMaterials;
+    unsigned int CurrentMaterialIndex = NoMaterial;
+
+    const size_t FolderEnd = FilePath.find_last_of("/\\");
+    const std::string Folder = FolderEnd == std::string::npos ? std::string() : FilePath.substr(0, FolderEnd + 1);
+
+    // Reads the name at the end of an mtllib or usemtl line
+    const auto GetLineArgument = [](const char* Line, size_t KeywordLength)
+    {
+        std::string Argument = Line + KeywordLength;
+        Argument.erase(0, Argument.find_first_not_of(" \t"));
+        Argument.erase(Argument.find_last_not_of(" \t\r") + 1);
+        return Argument;
+    };
+
     while (!FileStream.eof())
     {
         // WARNING: Assumption that each line in the file is no longer than 128 characters
@@ -63,7 +203,38 @@ bool XGMesh::LoadFromObjectFile(const std::string& FilePath, bool HasTexture, bo
                 // v 0.00045 -3.00465 1.11046
                 LineStream >> Unused >> Vertex.X >> Vertex.Y >> Vertex.Z;
 
-                Vertices.push_back(Vertex);
+                Positions.push_back(Vertex);
+            }
+        }
+        else if (std::strncmp(Line, "mtllib ", 7) == 0)
+        {
+            // Example line:
+            // mtllib Terrain.mtl
+            XGMaterial::LoadFromMaterialFile(Folder + GetLineArgument(Line, 7), Materials);
+        }
+        else if (std::strncmp(Line, "usemtl ", 7) == 0)
+        {
+            // Every face after this line uses the named material, until the next usemtl line
+            // Example line:
+            // usemtl Rock
+            const std::string MaterialName = GetLineArgument(Line, 7);
+            const auto Material = std::find_if(Materials.begin(), Materials.end(), [&](const XGMaterial& Candidate)
+            {
+                return Candidate.Name == MaterialName;
+            });
+
+            if (Material != Materials.end())
+            {
+                CurrentMaterialIndex = static_cast<unsigned int>(Material - Materials.begin());
+            }
+            else
+            {
+                // Files exported without their material library still name materials, which isn't worth reporting
+                if (!Materials.empty())
+                {
+                    std::cout << "ERROR: XGMesh::LoadFromObjectFile: Unknown material: " << MaterialName << std::endl;
+                }
+                CurrentMaterialIndex = NoMaterial;
             }
         }
         else if (Line[0] == 'f')
@@ -95,27 +266,17 @@ bool XGMesh::LoadFromObjectFile(const std::string& FilePath, bool HasTexture, bo
                 }
 
                 Tokens[TokenCount].pop_back();
-                
-                Triangles.push_back({
-                    Vertices[stoi(Tokens[0]) - 1],
-                    Vertices[stoi(Tokens[2]) - 1],
-                    Vertices[stoi(Tokens[4]) - 1],
-                    TextureCoordinates[stoi(Tokens[1]) - 1],
-                    TextureCoordinates[stoi(Tokens[3]) - 1],
-                    TextureCoordinates[stoi(Tokens[5]) - 1]
-                });
+
+                Indices.push_back(GetVertexIndex(stoi(Tokens[0]), stoi(Tokens[1])));
+                Indices.push_back(GetVertexIndex(stoi(Tokens[2]), stoi(Tokens[3])));
+                Indices.push_back(GetVertexIndex(stoi(Tokens[4]), stoi(Tokens[5])));
 
                 // This line defined a quad, so add the second triangle
                 if (TokenCount == 7)
                 {
-                    Triangles.push_back({
-                        Vertices[stoi(Tokens[0]) - 1],
-                        Vertices[stoi(Tokens[4]) - 1],
-                        Vertices[stoi(Tokens[6]) - 1],
-                        TextureCoordinates[stoi(Tokens[1]) - 1],
-                        TextureCoordinates[stoi(Tokens[5]) - 1],
-                        TextureCoordinates[stoi(Tokens[7]) - 1]
-                    });
+                    Indices.push_back(GetVertexIndex(stoi(Tokens[0]), stoi(Tokens[1])));
+                    Indices.push_back(GetVertexIndex(stoi(Tokens[4]), stoi(Tokens[5])));
+                    Indices.push_back(GetVertexIndex(stoi(Tokens[6]), stoi(Tokens[7])));
                 }
             }
             else
@@ -124,26 +285,497 @@ bool XGMesh::LoadFromObjectFile(const std::string& FilePath, bool HasTexture, bo
                 // Example line:
                 // f 2 4 1
                 
-                // This line defines a face, so we'll create an instance of XGTriangle and add it to this mesh
-                int VertexIndices[3];
+                // This line defines a face, so we'll add a triangle to this mesh
+                int PositionIndices[3];
 
-                // Read the contents of LineStream into VertexIndices, throwing out the initial 'f' character
+                // Read the contents of LineStream into PositionIndices, throwing out the initial 'f' character
                 // Example .obj file line:
                 // f 5 9 14
-                LineStream >> Unused >> VertexIndices[0] >> VertexIndices[1] >> VertexIndices[2];
-
-                // Create a triangle using the vertex indices we read in. Subtract one from each index before we look it
-                // up in Vertices, because .obj files use base-1 vertex indices instead of base-0.
-                XGTriangle Face = XGTriangle(
-                    XGVector3D(Vertices[VertexIndices[0] - 1]),
-                    XGVector3D(Vertices[VertexIndices[1] - 1]),
-                    XGVector3D(Vertices[VertexIndices[2] - 1])
-                );
+                LineStream >> Unused >> PositionIndices[0] >> PositionIndices[1] >> PositionIndices[2];
 
-                Triangles.push_back(Face);
+                Indices.push_back(GetVertexIndex(PositionIndices[0], 0));
+                Indices.push_back(GetVertexIndex(PositionIndices[1], 0));
+                Indices.push_back(GetVertexIndex(PositionIndices[2], 0));
             }
+
+            TriangleMaterials.resize(GetTriangleCount(), CurrentMaterialIndex);
         }
     }
+
+    if (!Materials.empty())
+    {
+        GroupTrianglesByMaterial(Materials, Vertices, Indices, TriangleMaterials, NoMaterial, MaterialGroups);
+    }
+
+    ComputeBounds();
     
     return true;
 }
+
+size_t XGMesh::GetMemoryUsage() const
+{
+    return Vertices.capacity() * sizeof(XGVertex) +
+        QuantizedVertices.capacity() * sizeof(XGQuantizedVertex) +
+        Indices.capacity() * sizeof(unsigned int) +
+        Clusters.capacity() * sizeof(XGMeshCluster) +
+        Materials.capacity() * sizeof(XGMaterial) +
+        MaterialGroups.capacity() * sizeof(XGMeshCluster);
+}
+
+XGVertex XGMesh::GetVertex(size_t VertexIndex) const
+{
+    if (!IsQuantized())
+    {
+        return Vertices[VertexIndex];
+    }
+
+    const XGQuantizedVertex& QuantizedVertex = QuantizedVertices[VertexIndex];
+    const XGVector3D QuantizedPosition = {
+        static_cast<float>(QuantizedVertex.Position[0]),
+        static_cast<float>(QuantizedVertex.Position[1]),
+        static_cast<float>(QuantizedVertex.Position[2])
+    };
+
+    return { DequantizationMatrix * QuantizedPosition, DecodeTextureCoordinate(QuantizedVertex) };
+}
+
+XGTriangle XGMesh::GetTriangle(size_t TriangleIndex) const
+{
+    const XGVertex Vertex1 = GetVertex(Indices[TriangleIndex * 3]);
+    const XGVertex Vertex2 = GetVertex(Indices[TriangleIndex * 3 + 1]);
+    const XGVertex Vertex3 = GetVertex(Indices[TriangleIndex * 3 + 2]);
+
+    return {
+        Vertex1.Position,
+        Vertex2.Position,
+        Vertex3.Position,
+        Vertex1.TextureCoordinate,
+        Vertex2.TextureCoordinate,
+        Vertex3.TextureCoordinate
+    };
+}
+
+void XGMesh::AddTriangle(const XGTriangle& Triangle)
+{
+    for (int PointIndex = 0; PointIndex < 3; ++PointIndex)
+    {
+        Indices.push_back(static_cast<unsigned int>(Vertices.size()));
+        Vertices.push_back({ Triangle.Points[PointIndex], Triangle.TextureCoordinates[PointIndex] });
+        if (!MaterialGroups.empty())
+        {
+            MaterialGroups.back().Bounds.Expand(Triangle.Points[PointIndex]);
+        }
+    }
+
+    if (!MaterialGroups.empty())
+    {
+        MaterialGroups.back().TriangleCount++;
+    }
+}
+
+void XGMesh::ComputeBounds()
+{
+    Bounds = XGBoundingBox();
+    for (const XGVertex& Vertex : Vertices)
+    {
+        Bounds.Expand(Vertex.Position);
+    }
+}
+
+void XGMesh::BuildClusters(unsigned int MaxTrianglesPerCluster)
+{
+    Clusters.clear();
+    if (Indices.empty() || MaxTrianglesPerCluster == 0)
+    {
+        return;
+    }
+
+    const auto TriangleCount = static_cast<unsigned int>(GetTriangleCount());
+
+    std::vector<XGVector3D> Centroids(TriangleCount);
+    std::vector<unsigned int> Order(TriangleCount);
+    for (unsigned int TriangleIndex = 0; TriangleIndex < TriangleCount; ++TriangleIndex)
+    {
+        Centroids[TriangleIndex] = (
+            Vertices[Indices[TriangleIndex * 3]].Position +
+            Vertices[Indices[TriangleIndex * 3 + 1]].Position +
+            Vertices[Indices[TriangleIndex * 3 + 2]].Position
+        ) / 3.0f;
+        Order[TriangleIndex] = TriangleIndex;
+    }
+
+    const auto GetAxisValue = [](const XGVector3D& Vector, int Axis)
+    {
+        return Axis == 0 ? Vector.X : (Axis == 1 ? Vector.Y : Vector.Z);
+    };
+
+    // Split ranges of triangles at the median centroid along their longest axis. Ranges are processed depth first,
+    // with the lower half of each split handled first, so the resulting clusters are also in spatial order. Each
+    // material group starts as its own range, so clusters stay in material order too.
+    std::vector<XGMeshCluster> PendingRanges;
+    if (MaterialGroups.empty())
+    {
+        XGMeshCluster WholeMesh;
+        WholeMesh.TriangleCount = TriangleCount;
+        PendingRanges.push_back(WholeMesh);
+    }
+    else
+    {
+        PendingRanges.assign(MaterialGroups.rbegin(), MaterialGroups.rend());
+    }
+
+    while (!PendingRanges.empty())
+    {
+        XGMeshCluster Range = PendingRanges.back();
+        PendingRanges.pop_back();
+
+        if (Range.TriangleCount <= MaxTrianglesPerCluster)
+        {
+            Clusters.push_back(Range);
+            continue;
+        }
+
+        XGBoundingBox CentroidBounds;
+        for (unsigned int i = Range.FirstTriangle; i < Range.FirstTriangle + Range.TriangleCount; ++i)
+        {
+            CentroidBounds.Expand(Centroids[Order[i]]);
+        }
+
+        const XGVector3D CentroidExtent = CentroidBounds.GetSize();
+        int SplitAxis = 0;
+        if (CentroidExtent.Y > CentroidExtent.X && CentroidExtent.Y >= CentroidExtent.Z)
+        {
+            SplitAxis = 1;
+        }
+        else if (CentroidExtent.Z > CentroidExtent.X && CentroidExtent.Z > CentroidExtent.Y)
+        {
+            SplitAxis = 2;
+        }
+
+        const unsigned int SplitIndex = Range.FirstTriangle + Range.TriangleCount / 2;
+        std::nth_element(
+            Order.begin() + Range.FirstTriangle,
+            Order.begin() + SplitIndex,
+            Order.begin() + Range.FirstTriangle + Range.TriangleCount,
+            [&](const unsigned int Triangle1, const unsigned int Triangle2)
+            {
+                return GetAxisValue(Centroids[Triangle1], SplitAxis) < GetAxisValue(Centroids[Triangle2], SplitAxis);
+            }
+        );
+
+        XGMeshCluster UpperRange;
+        UpperRange.FirstTriangle = SplitIndex;
+        UpperRange.TriangleCount = Range.FirstTriangle + Range.TriangleCount - SplitIndex;
+        UpperRange.MaterialIndex = Range.MaterialIndex;
+        PendingRanges.push_back(UpperRange);
+
+        XGMeshCluster LowerRange;
+        LowerRange.FirstTriangle = Range.FirstTriangle;
+        LowerRange.TriangleCount = SplitIndex - Range.FirstTriangle;
+        LowerRange.MaterialIndex = Range.MaterialIndex;
+        PendingRanges.push_back(LowerRange);
+    }
+
+    // Store the triangles in cluster order so each cluster is a contiguous range
+    std::vector<unsigned int> ReorderedIndices;
+    ReorderedIndices.reserve(Indices.size());
+    for (const unsigned int TriangleIndex : Order)
+    {
+        ReorderedIndices.push_back(Indices[TriangleIndex * 3]);
+        ReorderedIndices.push_back(Indices[TriangleIndex * 3 + 1]);
+        ReorderedIndices.push_back(Indices[TriangleIndex * 3 + 2]);
+    }
+    Indices.swap(ReorderedIndices);
+
+    for (XGMeshCluster& Cluster : Clusters)
+    {
+        for (unsigned int i = Cluster.FirstTriangle * 3; i < (Cluster.FirstTriangle + Cluster.TriangleCount) * 3; ++i)
+        {
+            Cluster.Bounds.Expand(Vertices[Indices[i]].Position);
+        }
+    }
+
+    ComputeBounds();
+}
+
+XGVertexCacheReport XGMesh::OptimizeVertexCache()
+{
+    XGVertexCacheReport Report;
+    if (Indices.empty())
+    {
+        return Report;
+    }
+
+    // The engine starts every cluster with an empty post-transform cache, so triangles are reordered and measured one
+    // cluster at a time. A mesh without clusters is treated as one cluster per material group, or a single cluster.
+    std::vector<XGMeshCluster> Ranges = Clusters.empty() ? MaterialGroups : Clusters;
+    if (Ranges.empty())
+    {
+        XGMeshCluster WholeMesh;
+        WholeMesh.TriangleCount = static_cast<unsigned int>(GetTriangleCount());
+        Ranges.push_back(WholeMesh);
+    }
+
+    const auto CalculateACMR = [&]()
+    {
+        size_t CacheMisses = 0;
+        for (const XGMeshCluster& Range : Ranges)
+        {
+            CacheMisses += XGVertexCacheOptimizer::CountCacheMisses(&Indices[Range.FirstTriangle * 3], Range.TriangleCount);
+        }
+        return static_cast<float>(CacheMisses) / static_cast<float>(GetTriangleCount());
+    };
+
+    Report.OriginalACMR = CalculateACMR();
+
+    for (const XGMeshCluster& Range : Ranges)
+    {
+        XGVertexCacheOptimizer::OptimizeTriangleOrder(&Indices[Range.FirstTriangle * 3], Range.TriangleCount);
+    }
+
+    Report.TriangleOrderACMR = CalculateACMR();
+
+    ReorderVerticesByFirstUse(Vertices, Indices);
+
+    Report.VertexOrderACMR = CalculateACMR();
+
+    std::cout << "XGMesh::OptimizeVertexCache: ACMR " << Report.OriginalACMR
+        << " before, " << Report.TriangleOrderACMR
+        << " after reordering triangles, " << Report.VertexOrderACMR
+        << " after reordering vertices" << std::endl;
+
+    return Report;
+}
+
+void XGMesh::OptimizeOverdraw(float CacheMissThreshold)
+{
+    if (Indices.empty())
+    {
+        return;
+    }
+
+    // Triangles are never moved out of their cluster, or their material group when there are no clusters
+    std::vector<XGMeshCluster> Ranges = Clusters.empty() ? MaterialGroups : Clusters;
+    if (Ranges.empty())
+    {
+        XGMeshCluster WholeMesh;
+        WholeMesh.TriangleCount = static_cast<unsigned int>(GetTriangleCount());
+        Ranges.push_back(WholeMesh);
+    }
+
+    // A run of triangles that stays together when the triangles of a cluster are reordered
+    struct XGTriangleRun
+    {
+        unsigned int FirstTriangle = 0;
+        unsigned int TriangleCount = 0;
+        float OccluderScore = 0.0f;
+    };
+
+    const XGVector3D MeshCenter = Bounds.GetCenter();
+    std::vector<XGTriangleRun> Runs;
+    std::vector<unsigned int> ReorderedIndices;
+    size_t CacheMissesBefore = 0;
+    size_t CacheMissesAfter = 0;
+    size_t RunCount = 0;
+
+    for (const XGMeshCluster& Range : Ranges)
+    {
+        unsigned int* RangeIndices = &Indices[Range.FirstTriangle * 3];
+        const size_t RangeCacheMisses = XGVertexCacheOptimizer::CountCacheMisses(RangeIndices, Range.TriangleCount);
+        const float RangeACMR = static_cast<float>(RangeCacheMisses) / static_cast<float>(std::max(1u, Range.TriangleCount));
+        CacheMissesBefore += RangeCacheMisses;
+
+        // Split the cluster into runs. A run ends wherever the vertex cache order already starts over (a triangle
+        // that shares no vertices with the one before it), or as soon as the run on its own would cost no more than
+        // CacheMissThreshold times the cluster's cache miss ratio. The run's misses are counted as its triangles are
+        // added, so each triangle is only looked up in the cache once.
+        Runs.clear();
+        XGTriangleRun CurrentRun;
+        XGPostTransformCacheModel RunCache;
+        for (unsigned int TriangleIndex = 0; TriangleIndex < Range.TriangleCount; ++TriangleIndex)
+        {
+            const unsigned int* Triangle = RangeIndices + TriangleIndex * 3;
+            if (CurrentRun.TriangleCount > 0)
+            {
+                const unsigned int* PreviousTriangle = Triangle - 3;
+                bool SharesVertex = false;
+                for (int i = 0; i < 3; ++i)
+                {
+                    SharesVertex |= Triangle[i] == PreviousTriangle[0] || Triangle[i] == PreviousTriangle[1] || Triangle[i] == PreviousTriangle[2];
+                }
+
+                const float RunACMR = static_cast<float>(RunCache.GetMissCount()) / static_cast<float>(CurrentRun.TriangleCount);
+
+                if (!SharesVertex || RunACMR <= RangeACMR * CacheMissThreshold)
+                {
+                    Runs.push_back(CurrentRun);
+                    CurrentRun = XGTriangleRun();
+                    CurrentRun.FirstTriangle = TriangleIndex;
+                    RunCache.Clear();
+                }
+            }
+            RunCache.AddTriangle(Triangle);
+            CurrentRun.TriangleCount++;
+        }
+        Runs.push_back(CurrentRun);
+        RunCount += Runs.size();
+
+        // Runs on the outside of the mesh facing away from its centre are the most likely to hide the rest of it from
+        // any viewpoint, so they are drawn first (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+        // Locality and Reduced Overdraw")
+        for (XGTriangleRun& Run : Runs)
+        {
+            XGVector3D AreaWeightedNormal = { 0.0f, 0.0f, 0.0f };
+            XGVector3D Centroid = { 0.0f, 0.0f, 0.0f };
+            float TotalArea = 0.0f;
+            for (unsigned int TriangleIndex = Run.FirstTriangle; TriangleIndex < Run.FirstTriangle + Run.TriangleCount; ++TriangleIndex)
+            {
+                const unsigned int* Triangle = RangeIndices + TriangleIndex * 3;
+                const XGVector3D& Point1 = Vertices[Triangle[0]].Position;
+                const XGVector3D& Point2 = Vertices[Triangle[1]].Position;
+                const XGVector3D& Point3 = Vertices[Triangle[2]].Position;
+
+                // The cross product's length is twice the triangle's area, so it weights the normal by area already
+                const XGVector3D Normal = (Point2 - Point1).CrossProduct(Point3 - Point1);
+                const float Area = Normal.GetLength() * 0.5f;
+                AreaWeightedNormal += Normal;
+                Centroid += (Point1 + Point2 + Point3) * (Area / 3.0f);
+                TotalArea += Area;
+            }
+
+            const float NormalLength = AreaWeightedNormal.GetLength();
+            if (TotalArea > 0.0f && NormalLength > 0.0f)
+            {
+                Centroid /= TotalArea;
+                Run.OccluderScore = (Centroid - MeshCenter).DotProduct(AreaWeightedNormal) / NormalLength;
+            }
+        }
+
+        std::stable_sort(Runs.begin(), Runs.end(), [](const XGTriangleRun& Run1, const XGTriangleRun& Run2)
+        {
+            return Run1.OccluderScore > Run2.OccluderScore;
+        });
+
+        ReorderedIndices.clear();
+        for (const XGTriangleRun& Run : Runs)
+        {
+            ReorderedIndices.insert(
+                ReorderedIndices.end(),
+                RangeIndices + Run.FirstTriangle * 3,
+                RangeIndices + (Run.FirstTriangle + Run.TriangleCount) * 3
+            );
+        }
+        std::copy(ReorderedIndices.begin(), ReorderedIndices.end(), RangeIndices);
+    }
+
+    ReorderVerticesByFirstUse(Vertices, Indices);
+
+    for (const XGMeshCluster& Range : Ranges)
+    {
+        CacheMissesAfter += XGVertexCacheOptimizer::CountCacheMisses(&Indices[Range.FirstTriangle * 3], Range.TriangleCount);
+    }
+
+    std::cout << "XGMesh::OptimizeOverdraw: " << RunCount << " runs sorted, ACMR "
+        << static_cast<float>(CacheMissesBefore) / static_cast<float>(GetTriangleCount()) << " before, "
+        << static_cast<float>(CacheMissesAfter) / static_cast<float>(GetTriangleCount()) << " after" << std::endl;
+}
+
+XGQuantizationReport XGMesh::Quantize()
+{
+    XGQuantizationReport Report;
+    if (Vertices.empty())
+    {
+        return Report;
+    }
+
+    constexpr float MaxQuantizedValue = 65535.0f;
+
+    // Spread the 16-bit range evenly over the bounds of the mesh on each axis. Axes where the mesh is flat get a step
+    // of zero, so every vertex decodes to the exact value.
+    ComputeBounds();
+    const XGVector3D PositionSize = Bounds.GetSize();
+    const XGVector3D PositionStep = PositionSize / MaxQuantizedValue;
+    DequantizationMatrix = XGMatrix4x4::Scale(PositionStep) * XGMatrix4x4::Translation(Bounds.Min);
+
+    float MinU = Vertices[0].TextureCoordinate.U;
+    float MinV = Vertices[0].TextureCoordinate.V;
+    float MaxU = MinU;
+    float MaxV = MinV;
+    for (const XGVertex& Vertex : Vertices)
+    {
+        MinU = std::min(MinU, Vertex.TextureCoordinate.U);
+        MinV = std::min(MinV, Vertex.TextureCoordinate.V);
+        MaxU = std::max(MaxU, Vertex.TextureCoordinate.U);
+        MaxV = std::max(MaxV, Vertex.TextureCoordinate.V);
+    }
+    TextureCoordinateOffsetU = MinU;
+    TextureCoordinateOffsetV = MinV;
+    TextureCoordinateScaleU = (MaxU - MinU) / MaxQuantizedValue;
+    TextureCoordinateScaleV = (MaxV - MinV) / MaxQuantizedValue;
+
+    const auto QuantizeValue = [MaxQuantizedValue](float Value, float Min, float Step)
+    {
+        if (Step <= 0.0f)
+        {
+            return static_cast<uint16_t>(0);
+        }
+
+        const float Quantized = std::round((Value - Min) / Step);
+        return static_cast<uint16_t>(std::max(0.0f, std::min(MaxQuantizedValue, Quantized)));
+    };
+
+    QuantizedVertices.resize(Vertices.size());
+    for (size_t VertexIndex = 0; VertexIndex < Vertices.size(); ++VertexIndex)
+    {
+        const XGVertex& Vertex = Vertices[VertexIndex];
+        XGQuantizedVertex& QuantizedVertex = QuantizedVertices[VertexIndex];
+        QuantizedVertex.Position[0] = QuantizeValue(Vertex.Position.X, Bounds.Min.X, PositionStep.X);
+        QuantizedVertex.Position[1] = QuantizeValue(Vertex.Position.Y, Bounds.Min.Y, PositionStep.Y);
+        QuantizedVertex.Position[2] = QuantizeValue(Vertex.Position.Z, Bounds.Min.Z, PositionStep.Z);
+        QuantizedVertex.TextureCoordinate[0] = QuantizeValue(Vertex.TextureCoordinate.U, MinU, TextureCoordinateScaleU);
+        QuantizedVertex.TextureCoordinate[1] = QuantizeValue(Vertex.TextureCoordinate.V, MinV, TextureCoordinateScaleV);
+    }
+
+    // Measure the errors by decoding every vertex the same way the engine does
+    for (size_t VertexIndex = 0; VertexIndex < Vertices.size(); ++VertexIndex)
+    {
+        const XGVertex& Original = Vertices[VertexIndex];
+        const XGVertex Decoded = GetVertex(VertexIndex);
+
+        Report.MaxPositionError = std::max({
+            Report.MaxPositionError,
+            std::abs(Decoded.Position.X - Original.Position.X),
+            std::abs(Decoded.Position.Y - Original.Position.Y),
+            std::abs(Decoded.Position.Z - Original.Position.Z)
+        });
+        Report.MaxTextureCoordinateError = std::max({
+            Report.MaxTextureCoordinateError,
+            std::abs(Decoded.TextureCoordinate.U - Original.TextureCoordinate.U),
+            std::abs(Decoded.TextureCoordinate.V - Original.TextureCoordinate.V)
+        });
+    }
+
+    // Rounding to the nearest step is off by at most half a step, and decoding in floats can add up to one rounding
+    // error of the largest decoded value on top of that
+    const float LargestPosition = std::max({
+        std::abs(Bounds.Min.X), std::abs(Bounds.Min.Y), std::abs(Bounds.Min.Z),
+        std::abs(Bounds.Max.X), std::abs(Bounds.Max.Y), std::abs(Bounds.Max.Z)
+    });
+    const float LargestTextureCoordinate = std::max({ std::abs(MinU), std::abs(MinV), std::abs(MaxU), std::abs(MaxV) });
+    Report.PositionErrorBound = 0.5f * std::max({ PositionStep.X, PositionStep.Y, PositionStep.Z }) +
+        std::numeric_limits<float>::epsilon() * LargestPosition;
+    Report.TextureCoordinateErrorBound = 0.5f * std::max(TextureCoordinateScaleU, TextureCoordinateScaleV) +
+        std::numeric_limits<float>::epsilon() * LargestTextureCoordinate;
+    Report.BytesBefore = Vertices.size() * sizeof(XGVertex);
+    Report.BytesAfter = QuantizedVertices.size() * sizeof(XGQuantizedVertex);
+
+    // Release the full precision vertices
+    std::vector<XGVertex>().swap(Vertices);
+
+    std::cout << "XGMesh::Quantize: " << QuantizedVertices.size() << " vertices use " << Report.BytesAfter
+        << " bytes instead of " << Report.BytesBefore << ". Max position error " << Report.MaxPositionError
+        << " (bound " << Report.PositionErrorBound << "), max texture coordinate error "
+        << Report.MaxTextureCoordinateError << " (bound " << Report.TextureCoordinateErrorBound << ")" << std::endl;
+
+    return Report;
+}
@@ -5,14 +5,220 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "XGBoundingBox.h"
+#include "XGMaterial.h"
+#include "XGMatrix4x4.h"
 #include "XGTriangle.h"
+#include "XGVector2D.h"
+#include "XGVector3D.h"
+
+/**
+ * \brief A single vertex of a mesh, which may be shared by any number of its triangles
+ */
+struct XGVertex
+{
+    XGVector3D Position;
+    XGVector2D TextureCoordinate;
+};
+
+/**
+ * \brief A vertex stored as 16-bit integers spread evenly over the range of its mesh's positions and texture coordinates
+ */
+struct XGQuantizedVertex
+{
+    uint16_t Position[3];
+    uint16_t TextureCoordinate[2];
+};
+
+/**
+ * \brief The memory used by a mesh's vertices before and after Quantize, and the largest errors it introduced
+ * \details Errors are measured per axis, in model space for positions and in texture space for texture coordinates.
+ * The bounds are half of the largest quantization step plus the rounding of decoding in floats, which no vertex can
+ * exceed.
+ */
+struct XGQuantizationReport
+{
+    size_t BytesBefore = 0;
+    size_t BytesAfter = 0;
+
+    float MaxPositionError = 0.0f;
+    float PositionErrorBound = 0.0f;
+
+    float MaxTextureCoordinateError = 0.0f;
+    float TextureCoordinateErrorBound = 0.0f;
+};
+
+/**
+ * \brief A spatially compact, contiguous range of a mesh's triangles that can be culled as a unit
+ */
+struct XGMeshCluster
+{
+    /**
+     * \brief The index of the first triangle of this cluster. Its indices start at XGMesh::Indices[FirstTriangle * 3].
+     */
+    unsigned int FirstTriangle = 0;
+
+    /**
+     * \brief The number of triangles in this cluster
+     */
+    unsigned int TriangleCount = 0;
+
+    /**
+     * \brief The bounds of this cluster's triangles in model space
+     */
+    XGBoundingBox Bounds;
+
+    /**
+     * \brief The index into XGMesh::Materials of the material every triangle of this cluster uses
+     */
+    unsigned int MaterialIndex = 0;
+};
+
+/**
+ * \brief The average cache miss ratio (transformed vertices per triangle) of a mesh at each step of OptimizeVertexCache
+ */
+struct XGVertexCacheReport
+{
+    float OriginalACMR = 0.0f;
+    float TriangleOrderACMR = 0.0f;
+    float VertexOrderACMR = 0.0f;
+};
 
 struct XGMesh
 {
-    std::vector<XGTriangle> Triangles;
+    /**
+     * \brief The unique vertices of the mesh. Empty once the mesh has been quantized.
+     */
+    std::vector<XGVertex> Vertices;
+
+    /**
+     * \brief The unique vertices of the mesh after Quantize, in the same order Vertices had
+     */
+    std::vector<XGQuantizedVertex> QuantizedVertices;
 
+    /**
+     * \brief Converts the integer positions of QuantizedVertices back into model space
+     * \details Fold this into the world matrix, so decoding costs nothing extra per vertex
+     */
+    XGMatrix4x4 DequantizationMatrix = XGMatrix4x4::Identity();
+
+    /**
+     * \brief Converts the integer texture coordinates of QuantizedVertices back into texture space
+     */
+    float TextureCoordinateOffsetU = 0.0f;
+    float TextureCoordinateOffsetV = 0.0f;
+    float TextureCoordinateScaleU = 1.0f;
+    float TextureCoordinateScaleV = 1.0f;
+
+    /**
+     * \brief Three indices into Vertices for every triangle of the mesh
+     */
+    std::vector<unsigned int> Indices;
+
+    /**
+     * \brief The clusters that partition the triangles. Empty until BuildClusters is called.
+     */
+    std::vector<XGMeshCluster> Clusters;
+
+    /**
+     * \brief The materials read from the mesh's MTL files
+     */
+    std::vector<XGMaterial> Materials;
+
+    /**
+     * \brief A contiguous range of triangles for each material that has any, in the order of Materials. Empty when
+     * the mesh has no materials. Clusters never cross from one range into the next.
+     */
+    std::vector<XGMeshCluster> MaterialGroups;
+
+    /**
+     * \brief The bounds of the whole mesh in model space
+     */
+    XGBoundingBox Bounds;
+
+    /**
+     * \brief Loads the triangles of an OBJ file, along with the materials of any MTL files it references
+     * \details Triangles are grouped by the material they use (usemtl). Triangles that come before the first usemtl
+     * line, or that use a material no MTL file defines, get a plain white material.
+     */
     bool LoadFromObjectFile(const std::string& FilePath, bool HasTexture = false, bool InvertUVMapping = false);
+
+    size_t GetTriangleCount() const { return Indices.size() / 3; }
+
+    bool IsQuantized() const { return !QuantizedVertices.empty(); }
+
+    size_t GetVertexCount() const { return IsQuantized() ? QuantizedVertices.size() : Vertices.size(); }
+
+    /**
+     * \brief Returns the number of bytes allocated for the vertices, indices and clusters
+     */
+    size_t GetMemoryUsage() const;
+
+    /**
+     * \brief Returns a copy of one of the mesh's vertices, decoded if the mesh is quantized
+     */
+    XGVertex GetVertex(size_t VertexIndex) const;
+
+    XGVector2D DecodeTextureCoordinate(const XGQuantizedVertex& Vertex) const
+    {
+        XGVector2D TextureCoordinate;
+        TextureCoordinate.U = TextureCoordinateOffsetU + static_cast<float>(Vertex.TextureCoordinate[0]) * TextureCoordinateScaleU;
+        TextureCoordinate.V = TextureCoordinateOffsetV + static_cast<float>(Vertex.TextureCoordinate[1]) * TextureCoordinateScaleV;
+        return TextureCoordinate;
+    }
+
+    /**
+     * \brief Assembles a copy of one of the mesh's triangles from its vertices
+     */
+    XGTriangle GetTriangle(size_t TriangleIndex) const;
+
+    /**
+     * \brief Appends a triangle to the mesh, with three new vertices that aren't shared with any other triangle
+     * \details The triangle uses the material of the last material group, if there is one
+     */
+    void AddTriangle(const XGTriangle& Triangle);
+
+    /**
+     * \brief Recalculates Bounds from the current vertices
+     */
+    void ComputeBounds();
+
+    /**
+     * \brief Reorders the triangles into spatially compact clusters and fills Clusters
+     * \details Each material group is split recursively at the median of its triangles' centroids along the longest
+     * axis until each range holds at most MaxTrianglesPerCluster triangles
+     * \param MaxTrianglesPerCluster The largest number of triangles a single cluster may contain
+     */
+    void BuildClusters(unsigned int MaxTrianglesPerCluster = 128);
+
+    /**
+     * \brief Reorders triangles so vertices are reused while they are still in the engine's post-transform cache, then
+     * renumbers vertices in the order they are first used so they are fetched sequentially
+     * \details Triangles are only reordered within their own cluster. Call this after BuildClusters, which reorders
+     * triangles spatially. The cache miss ratio before and after each step is written to the console.
+     * \return The cache miss ratios before and after optimizing
+     */
+    XGVertexCacheReport OptimizeVertexCache();
+
+    /**
+     * \brief Reorders the triangles of each cluster so the ones most likely to hide the rest of the mesh are drawn first
+     * \details Each cluster's vertex cache friendly order is cut into runs, which are then sorted outermost first
+     * without being broken up. Call this after OptimizeVertexCache.
+     * \param CacheMissThreshold How much worse than its cluster's cache miss ratio a run may be before it is cut off.
+     * Larger values make shorter runs, which reduce overdraw further at the cost of more transformed vertices.
+     */
+    void OptimizeOverdraw(float CacheMissThreshold = 1.05f);
+
+    /**
+     * \brief Replaces Vertices with QuantizedVertices, storing each position as three 16-bit integers relative to
+     * Bounds and each texture coordinate as two 16-bit integers relative to the range of the mesh's texture coordinates
+     * \details Every other function that reorders or reads Vertices has to be called before this one. The memory saved
+     * and the errors introduced are written to the console.
+     * \return The memory used and the errors introduced
+     */
+    XGQuantizationReport Quantize();
 };
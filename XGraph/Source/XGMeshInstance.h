@@ -0,0 +1,33 @@
+﻿// XGMeshInstance.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+#include "XGMatrix4x4.h"
+
+/**
+ * \brief One placement of a shared mesh in the world
+ * \details Instances only hold their own transform and tint, so drawing a mesh many times costs no more memory than
+ * the instances themselves
+ */
+struct XGMeshInstance
+{
+    /**
+     * \brief The matrix used to convert the mesh from model space to world space for this instance
+     */
+    XGMatrix4x4 WorldMatrix = XGMatrix4x4::Identity();
+
+    /**
+     * \brief The color that this instance's triangles are multiplied by
+     */
+    olc::Pixel Tint = olc::WHITE;
+
+    /**
+     * \brief The index of the XGEngine::SceneGraph node this instance follows, or -1 to use WorldMatrix as it is
+     * \details When set, WorldMatrix is overwritten with the node's world matrix every frame
+     */
+    int SceneNode = -1;
+};
@@ -0,0 +1,119 @@
+﻿// XGOcclusionBuffer.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGOcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+void XGOcclusionBuffer::Resize(int NewWidth, int NewHeight)
+{
+    Width = NewWidth;
+    Height = NewHeight;
+    Depth.assign(static_cast<size_t>(Width) * static_cast<size_t>(Height), 0.0f);
+}
+
+void XGOcclusionBuffer::Clear()
+{
+    std::fill(Depth.begin(), Depth.end(), 0.0f);
+}
+
+void XGOcclusionBuffer::RasterizeOccluder(const XGScreenTriangle& Triangle, const float& ScreenToBufferX, const float& ScreenToBufferY)
+{
+    float X[3];
+    float Y[3];
+    for (int PointIndex = 0; PointIndex < 3; ++PointIndex)
+    {
+        X[PointIndex] = Triangle.Vertices[PointIndex].X * ScreenToBufferX;
+        Y[PointIndex] = Triangle.Vertices[PointIndex].Y * ScreenToBufferY;
+    }
+
+    // Make sure the points wind the same way for every triangle, so the edge functions below are positive inside
+    const float DoubleArea = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+    if (DoubleArea == 0.0f)
+    {
+        return;
+    }
+
+    if (DoubleArea < 0.0f)
+    {
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+    }
+
+    // The whole triangle is written at the depth of its farthest point, which can only under-estimate occlusion
+    const float FarthestDepth = std::max({
+        Triangle.Vertices[0].InvW,
+        Triangle.Vertices[1].InvW,
+        Triangle.Vertices[2].InvW
+    });
+
+    const int MinTexelX = std::max(0, static_cast<int>(std::floor(std::min({ X[0], X[1], X[2] }))));
+    const int MinTexelY = std::max(0, static_cast<int>(std::floor(std::min({ Y[0], Y[1], Y[2] }))));
+    const int MaxTexelX = std::min(Width - 1, static_cast<int>(std::ceil(std::max({ X[0], X[1], X[2] }))) - 1);
+    const int MaxTexelY = std::min(Height - 1, static_cast<int>(std::ceil(std::max({ Y[0], Y[1], Y[2] }))) - 1);
+
+    // Edge function coefficients, E(X, Y) = A * X + B * Y + C
+    float EdgeA[3];
+    float EdgeB[3];
+    float EdgeC[3];
+
+    for (int EdgeIndex = 0; EdgeIndex < 3; ++EdgeIndex)
+    {
+        const int Start = EdgeIndex;
+        const int End = (EdgeIndex + 1) % 3;
+        EdgeA[EdgeIndex] = Y[Start] - Y[End];
+        EdgeB[EdgeIndex] = X[End] - X[Start];
+        EdgeC[EdgeIndex] = X[Start] * Y[End] - X[End] * Y[Start];
+    }
+
+    // Texels are covered when their centre is inside the triangle. Centres that lie exactly on an edge are covered by
+    // both triangles that share it, so neighbouring occluders never leave cracks between them.
+
+    for (int TexelY = MinTexelY; TexelY <= MaxTexelY; ++TexelY)
+    {
+        const float CenterY = static_cast<float>(TexelY) + 0.5f;
+        for (int TexelX = MinTexelX; TexelX <= MaxTexelX; ++TexelX)
+        {
+            const float CenterX = static_cast<float>(TexelX) + 0.5f;
+            if (EdgeA[0] * CenterX + EdgeB[0] * CenterY + EdgeC[0] >= 0.0f &&
+                EdgeA[1] * CenterX + EdgeB[1] * CenterY + EdgeC[1] >= 0.0f &&
+                EdgeA[2] * CenterX + EdgeB[2] * CenterY + EdgeC[2] >= 0.0f)
+            {
+                float& TexelDepth = Depth[TexelY * Width + TexelX];
+                TexelDepth = std::min(TexelDepth, FarthestDepth);
+            }
+        }
+    }
+}
+
+bool XGOcclusionBuffer::IsRectangleOccluded(const float& MinX, const float& MinY, const float& MaxX, const float& MaxY, const float& NearestDepth) const
+{
+    // Occluders cover texels by their centres, so an occluder's silhouette can be up to half a texel off. Growing the
+    // rectangle by a texel on every side makes sure the texels just outside a silhouette are tested as well.
+    const int MinTexelX = std::max(0, static_cast<int>(std::floor(MinX)) - 1);
+    const int MinTexelY = std::max(0, static_cast<int>(std::floor(MinY)) - 1);
+    const int MaxTexelX = std::min(Width - 1, static_cast<int>(std::ceil(MaxX)));
+    const int MaxTexelY = std::min(Height - 1, static_cast<int>(std::ceil(MaxY)));
+
+    if (MinTexelX > MaxTexelX || MinTexelY > MaxTexelY)
+    {
+        return false;
+    }
+
+    for (int TexelY = MinTexelY; TexelY <= MaxTexelY; ++TexelY)
+    {
+        for (int TexelX = MinTexelX; TexelX <= MaxTexelX; ++TexelX)
+        {
+            // Smaller depth values are closer to the camera
+            if (Depth[TexelY * Width + TexelX] >= NearestDepth)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,71 @@
+﻿// XGOcclusionBuffer.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <vector>
+
+#include "XGScreenTriangle.h"
+
+/**
+ * \brief Counters and timings gathered by the occlusion culling stage during a single frame
+ */
+struct XGOcclusionStats
+{
+    int ClustersTested = 0;
+    int ClustersFrustumCulled = 0;
+    int ClustersOccluded = 0;
+    int OccluderTrianglesRasterized = 0;
+
+    /**
+     * \brief Time spent culling clusters, which covers sorting them, testing their bounds, transforming the visible ones
+     * and rasterizing those into the occlusion buffer. Each pass over a mesh is timed as a whole, since reading the clock
+     * around every cluster would cost a noticeable share of the time being measured.
+     */
+    float CullMilliseconds = 0.0f;
+};
+
+/**
+ * \brief A small, conservative depth buffer used to reject geometry that is hidden behind occluders
+ * \details Depth is stored as 1/W like the main depth buffer, so smaller values are closer to the camera and a cleared
+ * texel (0) is infinitely far away. Occluders always write the depth of their farthest point, so the buffer never
+ * claims geometry is closer than it really is.
+ */
+class XGOcclusionBuffer
+{
+public:
+    void Resize(int NewWidth, int NewHeight);
+
+    int GetWidth() const { return Width; }
+    int GetHeight() const { return Height; }
+
+    size_t GetMemoryUsage() const { return Depth.capacity() * sizeof(float); }
+
+    void Clear();
+
+    /**
+     * \brief Rasterizes a screen space triangle into the buffer
+     * \param Triangle The triangle in screen space
+     * \param ScreenToBufferX The factor to convert screen space X coordinates to buffer texels
+     * \param ScreenToBufferY The factor to convert screen space Y coordinates to buffer texels
+     */
+    void RasterizeOccluder(const XGScreenTriangle& Triangle, const float& ScreenToBufferX, const float& ScreenToBufferY);
+
+    /**
+     * \brief Returns true if every texel in the given rectangle holds an occluder that is closer than NearestDepth
+     * \param MinX The left edge of the rectangle in buffer texels
+     * \param MinY The top edge of the rectangle in buffer texels
+     * \param MaxX The right edge of the rectangle in buffer texels
+     * \param MaxY The bottom edge of the rectangle in buffer texels
+     * \param NearestDepth The depth (1/W) of the closest point of the geometry being tested
+     */
+    bool IsRectangleOccluded(const float& MinX, const float& MinY, const float& MaxX, const float& MaxY, const float& NearestDepth) const;
+
+private:
+    int Width = 0;
+    int Height = 0;
+
+    std::vector<float> Depth;
+};
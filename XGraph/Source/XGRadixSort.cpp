@@ -0,0 +1,75 @@
+﻿// XGRadixSort.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGRadixSort.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint32_t XGRadixSort::FloatToKey(const float& Value)
+{
+    uint32_t Bits;
+    std::memcpy(&Bits, &Value, sizeof(Bits));
+
+    // Positive floats already sort correctly as integers once their sign bit is set. Negative floats sort backwards,
+    // so all of their bits are flipped.
+    const uint32_t Mask = (Bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+    return Bits ^ Mask;
+}
+
+void XGRadixSort::Sort(XGSortEntry* Entries, XGSortEntry* Scratch, size_t Count)
+{
+    if (Count < 2)
+    {
+        return;
+    }
+
+    // Count the occurrences of every byte value at every position of the key in a single pass
+    size_t Histograms[4][256] = {};
+    for (size_t i = 0; i < Count; ++i)
+    {
+        const uint32_t Key = Entries[i].Key;
+        Histograms[0][Key & 0xFF]++;
+        Histograms[1][(Key >> 8) & 0xFF]++;
+        Histograms[2][(Key >> 16) & 0xFF]++;
+        Histograms[3][Key >> 24]++;
+    }
+
+    XGSortEntry* Source = Entries;
+    XGSortEntry* Destination = Scratch;
+
+    for (int Pass = 0; Pass < 4; ++Pass)
+    {
+        const int Shift = Pass * 8;
+        size_t* Histogram = Histograms[Pass];
+
+        // When every key has the same byte at this position, the pass wouldn't move anything
+        if (Histogram[(Source[0].Key >> Shift) & 0xFF] == Count)
+        {
+            continue;
+        }
+
+        // Turn the counts into the offset each byte value's entries start at
+        size_t Offset = 0;
+        for (int ByteValue = 0; ByteValue < 256; ++ByteValue)
+        {
+            const size_t ByteCount = Histogram[ByteValue];
+            Histogram[ByteValue] = Offset;
+            Offset += ByteCount;
+        }
+
+        for (size_t i = 0; i < Count; ++i)
+        {
+            Destination[Histogram[(Source[i].Key >> Shift) & 0xFF]++] = Source[i];
+        }
+
+        std::swap(Source, Destination);
+    }
+
+    if (Source != Entries)
+    {
+        std::copy(Source, Source + Count, Entries);
+    }
+}
@@ -0,0 +1,37 @@
+﻿// XGRadixSort.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief A 32-bit sort key paired with the index of the item it was computed for
+ */
+struct XGSortEntry
+{
+    uint32_t Key = 0;
+    uint32_t Index = 0;
+};
+
+/**
+ * \brief Sorts key and index pairs in linear time, one byte of the key at a time
+ */
+struct XGRadixSort
+{
+    /**
+     * \brief Converts a float into a key whose unsigned integer order matches the order of the floats
+     */
+    static uint32_t FloatToKey(const float& Value);
+
+    /**
+     * \brief Sorts entries by ascending key. Entries with equal keys keep their relative order.
+     * \param Entries The entries to sort. They are sorted in place.
+     * \param Scratch Temporary storage with room for at least Count entries
+     * \param Count The number of entries
+     */
+    static void Sort(XGSortEntry* Entries, XGSortEntry* Scratch, size_t Count);
+};
@@ -0,0 +1,122 @@
+﻿// XGRenderTarget.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGRenderTarget.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XG_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+void XGRenderTarget::Resize(int NewWidth, int NewHeight)
+{
+    Layout.Resize(NewWidth, NewHeight);
+
+    // Swap with a new vector rather than calling assign, so shrinking the target gives the memory back
+    std::vector<olc::Pixel>(Layout.GetPaddedPixelCount(), olc::BLACK).swap(Pixels);
+}
+
+void XGRenderTarget::SetSize(int NewWidth, int NewHeight)
+{
+    Layout.Resize(NewWidth, NewHeight);
+    if (Layout.GetPaddedPixelCount() > Pixels.size())
+    {
+        Pixels.resize(Layout.GetPaddedPixelCount());
+    }
+}
+
+void XGRenderTarget::Release()
+{
+    std::vector<olc::Pixel>().swap(Pixels);
+    Layout.Resize(0, 0);
+}
+
+void XGRenderTarget::Clear(olc::Pixel Color)
+{
+    std::fill(Pixels.begin(), Pixels.begin() + Layout.GetPaddedPixelCount(), Color);
+}
+
+void XGRenderTarget::Resolve(olc::Sprite& Target)
+{
+    if (Layout.Width != Target.width || Layout.Height != Target.height)
+    {
+        ResolveScaled(Target);
+        return;
+    }
+
+    const int WholeTileCount = Layout.Width >> XGTileLayout::TileSizeShift;
+    const int RemainingPixelCount = Layout.Width & XGTileLayout::TileSizeMask;
+
+    for (int Y = 0; Y < Layout.Height; ++Y)
+    {
+        const olc::Pixel* Source = Pixels.data() + Layout.GetRowOffset(Y);
+        olc::Pixel* Destination = Target.pColData.data() + static_cast<size_t>(Y) * static_cast<size_t>(Target.width);
+
+        // Each tile holds eight pixels of this row next to each other, which is two 16 byte copies
+        for (int TileIndex = 0; TileIndex < WholeTileCount; ++TileIndex)
+        {
+#ifdef XG_USE_SSE2
+            const __m128i Left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source));
+            const __m128i Right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(Destination), Left);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(Destination + 4), Right);
+#else
+            std::memcpy(Destination, Source, XGTileLayout::TileSize * sizeof(olc::Pixel));
+#endif
+            Source += XGTileLayout::TilePixelCount;
+            Destination += XGTileLayout::TileSize;
+        }
+
+        // The last tile of the row is only partly on screen when the width isn't a multiple of the tile size
+        std::memcpy(Destination, Source, static_cast<size_t>(RemainingPixelCount) * sizeof(olc::Pixel));
+    }
+}
+
+void XGRenderTarget::ResolveScaled(olc::Sprite& Target)
+{
+    if (Layout.Width <= 0 || Layout.Height <= 0)
+    {
+        return;
+    }
+
+    // Each pixel of the sprite samples the target at its centre
+    if (SourceColumnWidth != Layout.Width || SourceColumnOffsets.size() != static_cast<size_t>(Target.width))
+    {
+        SourceColumnOffsets.resize(static_cast<size_t>(Target.width));
+        for (int X = 0; X < Target.width; ++X)
+        {
+            const int SourceX = static_cast<int>((static_cast<long long>(2 * X + 1) * Layout.Width) / (2LL * Target.width));
+            SourceColumnOffsets[X] = XGTileLayout::GetColumnOffset(SourceX);
+        }
+        SourceColumnWidth = Layout.Width;
+    }
+
+    const size_t TargetRowSize = static_cast<size_t>(Target.width);
+    int PreviousSourceY = -1;
+
+    for (int Y = 0; Y < Target.height; ++Y)
+    {
+        olc::Pixel* Destination = Target.pColData.data() + static_cast<size_t>(Y) * TargetRowSize;
+        const int SourceY = static_cast<int>((static_cast<long long>(2 * Y + 1) * Layout.Height) / (2LL * Target.height));
+
+        // Neighbouring rows of the sprite often sample the same row of the target, and then the row above can be copied
+        if (SourceY == PreviousSourceY)
+        {
+            std::memcpy(Destination, Destination - TargetRowSize, TargetRowSize * sizeof(olc::Pixel));
+            continue;
+        }
+
+        const olc::Pixel* Source = Pixels.data() + Layout.GetRowOffset(SourceY);
+        for (size_t X = 0; X < TargetRowSize; ++X)
+        {
+            Destination[X] = Source[SourceColumnOffsets[X]];
+        }
+
+        PreviousSourceY = SourceY;
+    }
+}
@@ -0,0 +1,78 @@
+﻿// XGRenderTarget.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+#include "XGTileLayout.h"
+
+/**
+ * \brief The color of each pixel of the screen, stored in 8x8 tiles while triangles are being rasterized
+ * \details Once every triangle has been drawn, Resolve copies the tiles into an ordinary row by row sprite, such as
+ * the engine's draw target. The target may be smaller than the sprite, in which case it is scaled up to cover it.
+ */
+class XGRenderTarget
+{
+public:
+    /**
+     * \brief Reallocates the target. Its contents are cleared to black.
+     */
+    void Resize(int NewWidth, int NewHeight);
+
+    /**
+     * \brief Changes the size of the target. Memory is only reallocated when the target has to grow past the largest
+     * size it has had, so the size can change every frame. Its contents are undefined afterwards.
+     */
+    void SetSize(int NewWidth, int NewHeight);
+
+    /**
+     * \brief Frees the target
+     */
+    void Release();
+
+    /**
+     * \brief Sets every pixel to the given color
+     */
+    void Clear(olc::Pixel Color);
+
+    /**
+     * \brief Copies the tiles into a sprite, one row at a time
+     * \details When the sprite is the same size as the target, rows are copied straight across. Otherwise every pixel
+     * of the sprite takes the color of the nearest pixel of the target.
+     * \param Target The sprite to copy into
+     */
+    void Resolve(olc::Sprite& Target);
+
+    int GetWidth() const { return Layout.Width; }
+    int GetHeight() const { return Layout.Height; }
+    const XGTileLayout& GetLayout() const { return Layout; }
+
+    /**
+     * \brief Returns the first pixel of the target. Pixels are found through the layout returned by GetLayout.
+     */
+    olc::Pixel* GetPixels() { return Pixels.data(); }
+
+    size_t GetMemoryUsage() const { return Pixels.capacity() * sizeof(olc::Pixel); }
+
+private:
+    XGTileLayout Layout;
+
+    std::vector<olc::Pixel> Pixels;
+
+    /**
+     * \brief When scaling up, the offset within a tile row of the pixel each column of the sprite is copied from. Kept
+     * between frames, and only rebuilt when the width of the target or the sprite changes.
+     */
+    std::vector<size_t> SourceColumnOffsets;
+    int SourceColumnWidth = 0;
+
+    /**
+     * \brief Copies the tiles into a sprite of a different size with nearest neighbour filtering
+     */
+    void ResolveScaled(olc::Sprite& Target);
+};
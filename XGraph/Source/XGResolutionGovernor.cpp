@@ -0,0 +1,84 @@
+﻿// XGResolutionGovernor.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGResolutionGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /**
+     * \brief How much of each new frame time is blended into the smoothed frame time
+     */
+    constexpr float SmoothingFactor = 0.2f;
+
+    /**
+     * \brief The resolution drops when frames take this much longer than the target...
+     */
+    constexpr float OverBudgetRatio = 1.05f;
+
+    /**
+     * \brief ...and rises when they take less than this much of the target
+     */
+    constexpr float UnderBudgetRatio = 0.85f;
+
+    /**
+     * \brief The most the scale may change by in a single step, so a spike doesn't halve the resolution at once
+     */
+    constexpr float MaxScaleStep = 0.1f;
+
+    /**
+     * \brief The number of frames the smoothed frame time needs to settle after the resolution has changed
+     */
+    constexpr int FramesBetweenChanges = 8;
+}
+
+void XGResolutionGovernor::Reset(int NewFullWidth, int NewFullHeight)
+{
+    FullWidth = NewFullWidth;
+    FullHeight = NewFullHeight;
+    SmoothedFrameMilliseconds = 0.0f;
+    CooldownFrames = 0;
+    ApplyScale(MaxScale);
+}
+
+void XGResolutionGovernor::Update(float FrameMilliseconds)
+{
+    SmoothedFrameMilliseconds = SmoothedFrameMilliseconds > 0.0f
+        ? SmoothedFrameMilliseconds + (FrameMilliseconds - SmoothedFrameMilliseconds) * SmoothingFactor
+        : FrameMilliseconds;
+
+    if (CooldownFrames > 0)
+    {
+        --CooldownFrames;
+        return;
+    }
+
+    const float LoadRatio = SmoothedFrameMilliseconds / TargetFrameMilliseconds;
+    if (LoadRatio <= OverBudgetRatio && LoadRatio >= UnderBudgetRatio)
+    {
+        return;
+    }
+
+    // Aim for the middle of the band rather than its edge, so the next small change in load doesn't cross back out
+    const float DesiredScale = Scale * std::sqrt((OverBudgetRatio + UnderBudgetRatio) * 0.5f / LoadRatio);
+    const float NewScale = std::max(Scale - MaxScaleStep, std::min(Scale + MaxScaleStep, DesiredScale));
+    const int PreviousWidth = Width;
+    const int PreviousHeight = Height;
+    ApplyScale(NewScale);
+
+    if (Width != PreviousWidth || Height != PreviousHeight)
+    {
+        CooldownFrames = FramesBetweenChanges;
+    }
+}
+
+void XGResolutionGovernor::ApplyScale(float NewScale)
+{
+    Scale = std::max(MinScale, std::min(MaxScale, NewScale));
+    Width = std::max(1, static_cast<int>(std::lround(static_cast<float>(FullWidth) * Scale)));
+    Height = std::max(1, static_cast<int>(std::lround(static_cast<float>(FullHeight) * Scale)));
+}
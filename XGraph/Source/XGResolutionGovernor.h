@@ -0,0 +1,71 @@
+﻿// XGResolutionGovernor.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+/**
+ * \brief Picks the resolution frames are rendered at, so the time they take stays close to a target
+ * \details Rendering time is treated as proportional to the number of pixels drawn, so each change scales both sides
+ * of the resolution by the square root of the ratio between the target and the measured time. Frame times are smoothed
+ * first, and the resolution is left alone for a few frames after each change, so a single slow frame doesn't make the
+ * image flicker between sizes. The resolution drops as soon as frames run over the target, but only rises again once
+ * there is clear headroom.
+ */
+class XGResolutionGovernor
+{
+public:
+    /**
+     * \brief The time each frame should take to render, in milliseconds
+     */
+    float TargetFrameMilliseconds = 16.0f;
+
+    /**
+     * \brief The smallest fraction of the full resolution frames may be rendered at
+     */
+    float MinScale = 0.5f;
+
+    /**
+     * \brief The largest fraction of the full resolution frames may be rendered at
+     */
+    float MaxScale = 1.0f;
+
+    /**
+     * \brief Starts rendering at the full resolution again
+     * \param NewFullWidth The width of the screen the frames are scaled up to
+     * \param NewFullHeight The height of the screen the frames are scaled up to
+     */
+    void Reset(int NewFullWidth, int NewFullHeight);
+
+    /**
+     * \brief Adjusts the resolution of the next frame, given how long the last one took to render
+     */
+    void Update(float FrameMilliseconds);
+
+    /**
+     * \brief The fraction of the full resolution the next frame should be rendered at
+     */
+    float GetScale() const { return Scale; }
+
+    int GetWidth() const { return Width; }
+    int GetHeight() const { return Height; }
+
+    float GetSmoothedFrameMilliseconds() const { return SmoothedFrameMilliseconds; }
+
+private:
+    int FullWidth = 0;
+    int FullHeight = 0;
+    int Width = 0;
+    int Height = 0;
+    float Scale = 1.0f;
+
+    float SmoothedFrameMilliseconds = 0.0f;
+
+    /**
+     * \brief The number of frames to wait before the resolution may change again
+     */
+    int CooldownFrames = 0;
+
+    void ApplyScale(float NewScale);
+};
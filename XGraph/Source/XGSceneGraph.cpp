@@ -0,0 +1,97 @@
+﻿// XGSceneGraph.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGSceneGraph.h"
+
+#include <algorithm>
+#include <iostream>
+
+int XGSceneGraph::AddNode(int ParentIndex)
+{
+    if (ParentIndex < -1 || ParentIndex >= GetNodeCount())
+    {
+        std::cout << "ERROR: XGSceneGraph::AddNode: Parent index " << ParentIndex << " does not refer to an existing node" << std::endl;
+        return -1;
+    }
+
+    const int NodeIndex = GetNodeCount();
+    ParentIndices.push_back(ParentIndex);
+    LocalMatrices.push_back(XGMatrix4x4::Identity());
+    WorldMatrices.push_back(XGMatrix4x4::Identity());
+    DirtyFlags.push_back(0);
+    MarkDirty(NodeIndex);
+
+    return NodeIndex;
+}
+
+void XGSceneGraph::SetLocalTransform(int NodeIndex, const XGVector3D& Translation, const XGVector3D& RotationRadians)
+{
+    // Vectors are multiplied on the left of matrices, so the leftmost matrix is applied first
+    SetLocalMatrix(
+        NodeIndex,
+        XGMatrix4x4::RotationZ(RotationRadians.Z) *
+        XGMatrix4x4::RotationX(RotationRadians.X) *
+        XGMatrix4x4::RotationY(RotationRadians.Y) *
+        XGMatrix4x4::Translation(Translation)
+    );
+}
+
+void XGSceneGraph::SetLocalMatrix(int NodeIndex, const XGMatrix4x4& LocalMatrix)
+{
+    LocalMatrices[NodeIndex] = LocalMatrix;
+    MarkDirty(NodeIndex);
+}
+
+size_t XGSceneGraph::GetMemoryUsage() const
+{
+    return ParentIndices.capacity() * sizeof(int) +
+        LocalMatrices.capacity() * sizeof(XGMatrix4x4) +
+        WorldMatrices.capacity() * sizeof(XGMatrix4x4) +
+        DirtyFlags.capacity() * sizeof(unsigned char);
+}
+
+int XGSceneGraph::UpdateWorldMatrices()
+{
+    const int NodeCount = GetNodeCount();
+    int RecalculatedCount = 0;
+
+    // Parents always come before their children, so by the time a node is reached, its parent's world matrix is up to
+    // date and its dirty flag says whether it changed during this pass
+    for (int NodeIndex = FirstDirtyNode; NodeIndex < NodeCount; ++NodeIndex)
+    {
+        const int ParentIndex = ParentIndices[NodeIndex];
+        const bool IsParentDirty = ParentIndex >= 0 && DirtyFlags[ParentIndex];
+        if (!DirtyFlags[NodeIndex] && !IsParentDirty)
+        {
+            continue;
+        }
+
+        if (ParentIndex >= 0)
+        {
+            WorldMatrices[NodeIndex] = LocalMatrices[NodeIndex] * WorldMatrices[ParentIndex];
+        }
+        else
+        {
+            WorldMatrices[NodeIndex] = LocalMatrices[NodeIndex];
+        }
+
+        DirtyFlags[NodeIndex] = 1;
+        RecalculatedCount++;
+    }
+
+    if (FirstDirtyNode < NodeCount)
+    {
+        std::fill(DirtyFlags.begin() + FirstDirtyNode, DirtyFlags.end(), static_cast<unsigned char>(0));
+    }
+    FirstDirtyNode = NodeCount;
+
+    return RecalculatedCount;
+}
+
+void XGSceneGraph::MarkDirty(int NodeIndex)
+{
+    DirtyFlags[NodeIndex] = 1;
+    FirstDirtyNode = std::min(FirstDirtyNode, NodeIndex);
+}
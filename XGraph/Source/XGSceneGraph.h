@@ -0,0 +1,80 @@
+﻿// XGSceneGraph.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "XGMatrix4x4.h"
+#include "XGVector3D.h"
+
+/**
+ * \brief A hierarchy of transforms whose world matrices are cached and only recalculated when they change
+ * \details Nodes are stored in arrays in the order they were added. A node's parent always has to be added before it,
+ * so every parent comes before its children and all world matrices can be brought up to date in a single pass.
+ */
+class XGSceneGraph
+{
+public:
+    /**
+     * \brief Adds a node with an identity local transform
+     * \param ParentIndex The index of the node's parent, or -1 for a root node. The parent must already exist.
+     * \return The index of the new node, or -1 if ParentIndex doesn't refer to an existing node
+     */
+    int AddNode(int ParentIndex = -1);
+
+    /**
+     * \brief Sets the transform of a node relative to its parent
+     * \param NodeIndex The node to update
+     * \param Translation The offset of the node from its parent
+     * \param RotationRadians The rotation of the node around the X, Y and Z axes, applied in Z, X, Y order
+     */
+    void SetLocalTransform(int NodeIndex, const XGVector3D& Translation, const XGVector3D& RotationRadians);
+
+    /**
+     * \brief Sets the matrix that converts from a node's space to its parent's space
+     */
+    void SetLocalMatrix(int NodeIndex, const XGMatrix4x4& LocalMatrix);
+
+    const XGMatrix4x4& GetLocalMatrix(int NodeIndex) const { return LocalMatrices[NodeIndex]; }
+
+    /**
+     * \brief Returns the cached world matrix of a node, as of the last call to UpdateWorldMatrices
+     */
+    const XGMatrix4x4& GetWorldMatrix(int NodeIndex) const { return WorldMatrices[NodeIndex]; }
+
+    int GetParentIndex(int NodeIndex) const { return ParentIndices[NodeIndex]; }
+
+    int GetNodeCount() const { return static_cast<int>(ParentIndices.size()); }
+
+    /**
+     * \brief Returns the number of bytes allocated for the nodes
+     */
+    size_t GetMemoryUsage() const;
+
+    /**
+     * \brief Recalculates the world matrices of nodes whose local transform changed, and of all of their descendants
+     * \return The number of world matrices that were recalculated
+     */
+    int UpdateWorldMatrices();
+
+private:
+    std::vector<int> ParentIndices;
+    std::vector<XGMatrix4x4> LocalMatrices;
+    std::vector<XGMatrix4x4> WorldMatrices;
+
+    /**
+     * \brief Whether each node's world matrix needs to be recalculated
+     */
+    std::vector<unsigned char> DirtyFlags;
+
+    /**
+     * \brief The lowest index of any dirty node. Nodes before it are all up to date, so updates can start here.
+     */
+    int FirstDirtyNode = 0;
+
+    void MarkDirty(int NodeIndex);
+};
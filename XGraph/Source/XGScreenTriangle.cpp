@@ -0,0 +1,98 @@
+﻿// XGScreenTriangle.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGScreenTriangle.h"
+
+namespace
+{
+    /**
+     * \brief Returns the vertex a given fraction of the way from Start to End. Every attribute is already divided by
+     * W, so they can all be interpolated linearly.
+     */
+    XGScreenVertex InterpolateVertex(const XGScreenVertex& Start, const XGScreenVertex& End, const float& Scale)
+    {
+        XGScreenVertex Result;
+        Result.X = Start.X + Scale * (End.X - Start.X);
+        Result.Y = Start.Y + Scale * (End.Y - Start.Y);
+        Result.InvW = Start.InvW + Scale * (End.InvW - Start.InvW);
+        Result.UOverW = Start.UOverW + Scale * (End.UOverW - Start.UOverW);
+        Result.VOverW = Start.VOverW + Scale * (End.VOverW - Start.VOverW);
+        return Result;
+    }
+}
+
+int XGScreenTriangle::ClipAgainstEdge(
+    bool IsVerticalEdge,
+    float Boundary,
+    float Direction,
+    XGScreenTriangle& OutTriangle1,
+    XGScreenTriangle& OutTriangle2) const
+{
+    const XGScreenVertex* InsideVertices[3];
+    float InsideDistances[3];
+    int InsideVertexCount = 0;
+    const XGScreenVertex* OutsideVertices[3];
+    float OutsideDistances[3];
+    int OutsideVertexCount = 0;
+
+    // If the signed distance to the edge is positive, then the vertex lies inside it
+    for (const XGScreenVertex& Vertex : Vertices)
+    {
+        const float SignedDistance = ((IsVerticalEdge ? Vertex.X : Vertex.Y) - Boundary) * Direction;
+        if (SignedDistance > 0.0f)
+        {
+            InsideVertices[InsideVertexCount] = &Vertex;
+            InsideDistances[InsideVertexCount] = SignedDistance;
+            InsideVertexCount++;
+        }
+        else
+        {
+            OutsideVertices[OutsideVertexCount] = &Vertex;
+            OutsideDistances[OutsideVertexCount] = SignedDistance;
+            OutsideVertexCount++;
+        }
+    }
+
+    // The fraction of the way from an inside vertex to an outside vertex where the edge is crossed
+    const auto GetIntersectionScale = [&](int InsideIndex, int OutsideIndex)
+    {
+        return InsideDistances[InsideIndex] / (InsideDistances[InsideIndex] - OutsideDistances[OutsideIndex]);
+    };
+
+    if (InsideVertexCount == 0)
+    {
+        // All vertices of the triangle are outside the edge
+        return 0;
+    }
+
+    if (InsideVertexCount == 1)
+    {
+        // This triangle needs to be clipped, yielding one new triangle
+        OutTriangle1.Color = Color;
+        OutTriangle1.Vertices[0] = *InsideVertices[0];
+        OutTriangle1.Vertices[1] = InterpolateVertex(*InsideVertices[0], *OutsideVertices[0], GetIntersectionScale(0, 0));
+        OutTriangle1.Vertices[2] = InterpolateVertex(*InsideVertices[0], *OutsideVertices[1], GetIntersectionScale(0, 1));
+        return 1;
+    }
+
+    if (InsideVertexCount == 2)
+    {
+        // This triangle needs to be clipped, forming two new triangles that form a quadrangle
+        OutTriangle1.Color = Color;
+        OutTriangle1.Vertices[0] = *InsideVertices[0];
+        OutTriangle1.Vertices[1] = *InsideVertices[1];
+        OutTriangle1.Vertices[2] = InterpolateVertex(*InsideVertices[0], *OutsideVertices[0], GetIntersectionScale(0, 0));
+
+        OutTriangle2.Color = Color;
+        OutTriangle2.Vertices[0] = *InsideVertices[1];
+        OutTriangle2.Vertices[1] = OutTriangle1.Vertices[2];
+        OutTriangle2.Vertices[2] = InterpolateVertex(*InsideVertices[1], *OutsideVertices[0], GetIntersectionScale(1, 0));
+        return 2;
+    }
+
+    // All vertices of the triangle are inside the edge, so no need to calculate new triangles
+    OutTriangle1 = *this;
+    return 1;
+}
@@ -0,0 +1,60 @@
+﻿// XGScreenTriangle.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+
+/**
+ * \brief A vertex after projection, holding only what the rasterizer needs
+ * \details Every attribute except X and Y is divided by W, so it can be interpolated linearly across the screen. Depth
+ * isn't stored separately, because the projected Z is an affine function of 1/W and sorts the same way.
+ */
+struct XGScreenVertex
+{
+    float X = 0.0f;
+    float Y = 0.0f;
+
+    /**
+     * \brief 1/W, which is negative, and closer to zero the farther the vertex is from the camera
+     */
+    float InvW = 0.0f;
+
+    float UOverW = 0.0f;
+    float VOverW = 0.0f;
+};
+
+/**
+ * \brief A projected triangle as it is passed between the stages of the pipeline, sized to fill one cache line
+ */
+struct alignas(64) XGScreenTriangle
+{
+    XGScreenVertex Vertices[3];
+
+    /**
+     * \brief The flat shaded color of the triangle, or the tint its texels are multiplied by
+     */
+    olc::Pixel Color = olc::WHITE;
+
+    /**
+     * \brief Clips this triangle against a horizontal or vertical edge of the screen
+     * \param IsVerticalEdge True to clip against a vertical line at X = Boundary, false for a horizontal line at
+     * Y = Boundary
+     * \param Boundary The coordinate of the edge
+     * \param Direction 1 to keep the side greater than Boundary, -1 to keep the side less than it
+     * \param OutTriangle1 If the return value is 1 or greater, this is the first new triangle created by clipping
+     * \param OutTriangle2 If the return value is 2, this is the second new triangle created by clipping
+     * \return The number of new triangles created by clipping. May be 0, 1, or 2.
+     */
+    int ClipAgainstEdge(
+        bool IsVerticalEdge,
+        float Boundary,
+        float Direction,
+        XGScreenTriangle& OutTriangle1,
+        XGScreenTriangle& OutTriangle2
+    ) const;
+};
+
+static_assert(sizeof(XGScreenTriangle) == 64, "XGScreenTriangle should fill exactly one cache line");
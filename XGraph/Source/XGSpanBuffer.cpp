@@ -0,0 +1,165 @@
+﻿// XGSpanBuffer.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGSpanBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+void XGSpanBuffer::Reset(int NewWidth, int NewHeight)
+{
+    Width = NewWidth;
+    Rows.assign(static_cast<size_t>(NewHeight), XGSpanRow());
+    Spans.clear();
+    Stats = XGSpanBufferStats();
+}
+
+void XGSpanBuffer::InsertSpan(int Y, int StartX, int EndX, float DepthAtZero, float DepthStepX, uint32_t TriangleId)
+{
+    if (StartX >= EndX)
+    {
+        return;
+    }
+
+    Stats.SpansInserted++;
+
+    // Spans are planar, so they are nearest at one of their ends
+    XGSpanRow& Row = Rows[Y];
+    const float StartDepth = DepthAtZero + static_cast<float>(StartX) * DepthStepX;
+    const float EndDepth = DepthAtZero + static_cast<float>(EndX - 1) * DepthStepX;
+    if (Row.CoveredPixelCount >= Width && std::min(StartDepth, EndDepth) >= Row.FarthestDepth)
+    {
+        Stats.SpansRejected++;
+        Stats.SpansRejectedByRow++;
+        return;
+    }
+
+    XGSpan NewSpan = { StartX, EndX, DepthAtZero, DepthStepX, TriangleId, -1 };
+    int NewlyCoveredPixelCount = 0;
+    bool IsAnyPartVisible = false;
+
+    int32_t Previous = -1;
+    int32_t Current = Row.Head;
+    int X = StartX;
+
+    while (X < EndX)
+    {
+        // Nothing is left on the row past this point, so the rest of the new span is visible
+        if (Current == -1 || Spans[Current].StartX >= EndX)
+        {
+            NewSpan.StartX = X;
+            NewSpan.EndX = EndX;
+            LinkSpan(Y, Previous, NewSpan);
+            NewlyCoveredPixelCount += EndX - X;
+            IsAnyPartVisible = true;
+            break;
+        }
+
+        // Copy the span, because linking new spans can move it
+        const XGSpan OldSpan = Spans[Current];
+        if (OldSpan.EndX <= X)
+        {
+            Previous = Current;
+            Current = OldSpan.Next;
+            continue;
+        }
+
+        // The gap before the next span is empty, so that part of the new span is visible
+        if (OldSpan.StartX > X)
+        {
+            NewSpan.StartX = X;
+            NewSpan.EndX = OldSpan.StartX;
+            Previous = LinkSpan(Y, Previous, NewSpan);
+            NewlyCoveredPixelCount += OldSpan.StartX - X;
+            X = OldSpan.StartX;
+            IsAnyPartVisible = true;
+            continue;
+        }
+
+        // Both spans lie on planes, so comparing their depths at the first and last pixel of the overlap shows whether
+        // one hides the other across all of it, or whether they cross somewhere in between
+        Stats.SpanComparisons++;
+        const int OverlapEndX = std::min(EndX, OldSpan.EndX);
+        const float FirstX = static_cast<float>(X);
+        const float LastX = static_cast<float>(OverlapEndX - 1);
+        const bool IsCloserAtFirst = DepthAtZero + FirstX * DepthStepX < OldSpan.DepthAtZero + FirstX * OldSpan.DepthStepX;
+        const bool IsCloserAtLast = DepthAtZero + LastX * DepthStepX < OldSpan.DepthAtZero + LastX * OldSpan.DepthStepX;
+
+        if (!IsCloserAtFirst && !IsCloserAtLast)
+        {
+            Previous = Current;
+            Current = OldSpan.Next;
+            X = OverlapEndX;
+            continue;
+        }
+
+        // Find the part of the overlap where the new span is in front
+        int VisibleStartX = X;
+        int VisibleEndX = OverlapEndX;
+        if (IsCloserAtFirst != IsCloserAtLast)
+        {
+            // The crossing can only be between the first and last pixel, which are at least one pixel apart here
+            const float CrossingX = (OldSpan.DepthAtZero - DepthAtZero) / (DepthStepX - OldSpan.DepthStepX);
+            if (IsCloserAtFirst)
+            {
+                VisibleEndX = std::max(X + 1, std::min(OverlapEndX - 1, static_cast<int>(std::ceil(CrossingX))));
+            }
+            else
+            {
+                VisibleStartX = std::max(X + 1, std::min(OverlapEndX - 1, static_cast<int>(std::floor(CrossingX)) + 1));
+            }
+        }
+
+        // Cut that part out of the old span, keeping whatever is left of it on either side
+        NewSpan.StartX = VisibleStartX;
+        NewSpan.EndX = VisibleEndX;
+        int32_t Middle = Current;
+        if (OldSpan.StartX < VisibleStartX)
+        {
+            Spans[Current].EndX = VisibleStartX;
+            Middle = LinkSpan(Y, Current, NewSpan);
+        }
+        else
+        {
+            NewSpan.Next = OldSpan.Next;
+            Spans[Current] = NewSpan;
+        }
+
+        Previous = Middle;
+        if (VisibleEndX < OldSpan.EndX)
+        {
+            XGSpan RightPart = OldSpan;
+            RightPart.StartX = VisibleEndX;
+            Current = LinkSpan(Y, Middle, RightPart);
+        }
+        else
+        {
+            Current = Spans[Middle].Next;
+        }
+
+        X = VisibleEndX;
+        IsAnyPartVisible = true;
+    }
+
+    if (!IsAnyPartVisible)
+    {
+        Stats.SpansRejected++;
+        return;
+    }
+
+    Row.CoveredPixelCount += NewlyCoveredPixelCount;
+    Row.FarthestDepth = std::max(Row.FarthestDepth, std::max(StartDepth, EndDepth));
+}
+
+int32_t XGSpanBuffer::LinkSpan(int Y, int32_t Previous, const XGSpan& Span)
+{
+    const int32_t SpanIndex = static_cast<int32_t>(Spans.size());
+    Spans.push_back(Span);
+
+    int32_t& Link = Previous == -1 ? Rows[Y].Head : Spans[Previous].Next;
+    Spans[SpanIndex].Next = Link;
+    Link = SpanIndex;
+    return SpanIndex;
+}
@@ -0,0 +1,147 @@
+﻿// XGSpanBuffer.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * \brief A run of pixels on one row that shows a single triangle
+ */
+struct XGSpan
+{
+    /**
+     * \brief The first pixel of the span, and the pixel just past its end
+     */
+    int StartX;
+    int EndX;
+
+    /**
+     * \brief The depth (1/W) of the span at pixel X is DepthAtZero + X * DepthStepX
+     */
+    float DepthAtZero;
+    float DepthStepX;
+
+    /**
+     * \brief Identifies the triangle the span shows
+     */
+    uint32_t TriangleId;
+
+    /**
+     * \brief The index of the next span to the right on the same row, or -1 if this is the last one
+     */
+    int32_t Next;
+};
+
+/**
+ * \brief Counters gathered by the span buffer during a single frame
+ */
+struct XGSpanBufferStats
+{
+    /**
+     * \brief The number of spans that were inserted, and how many of them were completely hidden
+     */
+    int SpansInserted = 0;
+    int SpansRejected = 0;
+
+    /**
+     * \brief The number of rejected spans that were rejected without walking their row, because the row was already
+     * covered by closer spans
+     */
+    int SpansRejectedByRow = 0;
+
+    /**
+     * \brief The number of spans that were compared against a span already in the buffer
+     */
+    int SpanComparisons = 0;
+};
+
+/**
+ * \brief Hidden surface removal that keeps, for each row of the screen, a sorted list of the spans that are visible
+ * \details Triangles are inserted one span at a time. Where a new span overlaps spans already on its row, their depths
+ * are compared across the overlap, and only the parts of the new span that are closer are kept, splitting spans where
+ * they cross. Once every triangle is in, each visible pixel belongs to exactly one span, so it is shaded and written
+ * exactly once. Inserting triangles front to back means most spans are behind the spans already in their row, and
+ * once a row is covered from edge to edge, spans behind everything in it are rejected without walking it.
+ */
+class XGSpanBuffer
+{
+public:
+    /**
+     * \brief Removes every span and sets the size of the buffer. Memory from earlier frames is kept.
+     * \param NewWidth The number of pixels on each row that spans can cover. A row is only treated as covered once spans
+     * cover all of them.
+     * \param NewHeight The number of rows
+     */
+    void Reset(int NewWidth, int NewHeight);
+
+    /**
+     * \brief Adds the visible parts of a span to a row
+     * \param Y The row of the span
+     * \param StartX The first pixel of the span
+     * \param EndX The pixel just past the end of the span
+     * \param DepthAtZero The depth (1/W) of the span's plane at pixel X = 0. Smaller values are closer.
+     * \param DepthStepX The amount the depth changes per pixel to the right
+     * \param TriangleId Identifies the triangle the span shows
+     */
+    void InsertSpan(int Y, int StartX, int EndX, float DepthAtZero, float DepthStepX, uint32_t TriangleId);
+
+    int GetWidth() const { return Width; }
+    int GetHeight() const { return static_cast<int>(Rows.size()); }
+
+    /**
+     * \brief Returns the index of the leftmost span of a row, or -1 if the row is empty
+     */
+    int32_t GetFirstSpan(int Y) const { return Rows[Y].Head; }
+
+    const XGSpan& GetSpan(int32_t SpanIndex) const { return Spans[SpanIndex]; }
+
+    const XGSpanBufferStats& GetStats() const { return Stats; }
+
+    size_t GetMemoryUsage() const
+    {
+        return Rows.capacity() * sizeof(XGSpanRow) + Spans.capacity() * sizeof(XGSpan);
+    }
+
+private:
+    struct XGSpanRow
+    {
+        /**
+         * \brief The index of the leftmost span of the row
+         */
+        int32_t Head = -1;
+
+        /**
+         * \brief The number of pixels of the row that spans cover
+         */
+        int CoveredPixelCount = 0;
+
+        /**
+         * \brief No span in the row is farther away than this. Spans that are cut down keep it where it was, so it can
+         * be farther than the spans really are, which only makes rejecting spans by row less likely.
+         */
+        float FarthestDepth = -std::numeric_limits<float>::max();
+    };
+
+    int Width = 0;
+
+    std::vector<XGSpanRow> Rows;
+
+    /**
+     * \brief Every span of every row. Spans are linked into their rows by index, so splitting one never moves the rest.
+     */
+    std::vector<XGSpan> Spans;
+
+    XGSpanBufferStats Stats;
+
+    /**
+     * \brief Adds a span after the given span, or at the start of the row if Previous is -1
+     * \return The index of the new span
+     */
+    int32_t LinkSpan(int Y, int32_t Previous, const XGSpan& Span);
+};
@@ -0,0 +1,727 @@
+﻿// XGTexture.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "XGBlockCompression.h"
+#include "XGVirtualTexture.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XG_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+XGTexture::~XGTexture()
+{
+    delete VirtualTexture;
+}
+
+bool XGTexture::LoadFromFile(const std::string& FilePath)
+{
+    if (XGVirtualTexture::IsPageFilePath(FilePath))
+    {
+        return LoadFromPageFile(FilePath, XGVirtualTexture::DefaultPhysicalPageCount);
+    }
+
+    olc::Sprite Sprite;
+    if (Sprite.LoadFromFile(FilePath) != olc::OK)
+    {
+        return false;
+    }
+
+    LoadFromSprite(Sprite);
+    return true;
+}
+
+bool XGTexture::LoadFromPageFile(const std::string& FilePath, int PhysicalPageCount)
+{
+    XGVirtualTexture* NewVirtualTexture = new XGVirtualTexture();
+    if (!NewVirtualTexture->Open(FilePath, PhysicalPageCount))
+    {
+        delete NewVirtualTexture;
+        return false;
+    }
+
+    delete VirtualTexture;
+    VirtualTexture = NewVirtualTexture;
+    Format = UncompressedFormat;
+    FirstResidentLevel = 0;
+    MinLevelOfDetail = 0.0f;
+    DroppedTexelCount = 0;
+    std::vector<olc::Pixel>().swap(Texels);
+    std::vector<uint64_t>().swap(Blocks);
+    std::vector<size_t>().swap(DecodedBlockIndices);
+    std::vector<olc::Pixel>().swap(DecodedTexels);
+
+    // Only the sizes are needed, for picking the level of detail
+    Levels.clear();
+    for (int Level = 0; Level < VirtualTexture->GetLevelCount(); ++Level)
+    {
+        const int Width = VirtualTexture->GetWidth(Level);
+        const int Height = VirtualTexture->GetHeight(Level);
+        Levels.push_back({
+            Width,
+            Height,
+            0,
+            static_cast<float>(Width << SubTexelShift),
+            static_cast<float>(Height << SubTexelShift),
+            0
+        });
+    }
+
+    SelectSampleFunction();
+    return true;
+}
+
+void XGTexture::LoadFromSprite(const olc::Sprite& Sprite)
+{
+    delete VirtualTexture;
+    VirtualTexture = nullptr;
+
+    Format = UncompressedFormat;
+    FirstResidentLevel = 0;
+    MinLevelOfDetail = 0.0f;
+    DroppedTexelCount = 0;
+    std::vector<uint64_t>().swap(Blocks);
+    std::vector<size_t>().swap(DecodedBlockIndices);
+    std::vector<olc::Pixel>().swap(DecodedTexels);
+
+    // Work out the size of every level first, so the texels can be allocated once
+    Levels.clear();
+    size_t TexelCount = 0;
+    int Width = std::max(1, Sprite.width);
+    int Height = std::max(1, Sprite.height);
+    while (true)
+    {
+        const int BlocksPerRow = (Width + BlockSizeMask) >> BlockSizeShift;
+        const int BlockRowCount = (Height + BlockSizeMask) >> BlockSizeShift;
+        Levels.push_back({
+            Width,
+            Height,
+            BlocksPerRow,
+            static_cast<float>(Width << SubTexelShift),
+            static_cast<float>(Height << SubTexelShift),
+            TexelCount
+        });
+        TexelCount += static_cast<size_t>(BlocksPerRow) * static_cast<size_t>(BlockRowCount) * BlockTexelCount;
+        if (Width == 1 && Height == 1)
+        {
+            break;
+        }
+
+        Width = std::max(1, Width / 2);
+        Height = std::max(1, Height / 2);
+    }
+
+    Texels.assign(TexelCount, olc::BLACK);
+    for (int Y = 0; Y < Sprite.height; ++Y)
+    {
+        for (int X = 0; X < Sprite.width; ++X)
+        {
+            Texels[GetTexelOffset(Levels[0], X, Y)] = Sprite.pColData[static_cast<size_t>(Y) * static_cast<size_t>(Sprite.width) + static_cast<size_t>(X)];
+        }
+    }
+
+    // Each texel of a level is the average of the 2x2 texels it covers in the level above. When the level above has
+    // an odd size, its last row or column is shared with its neighbour rather than dropped.
+    for (size_t LevelIndex = 1; LevelIndex < Levels.size(); ++LevelIndex)
+    {
+        const XGMipLevel& Source = Levels[LevelIndex - 1];
+        const XGMipLevel& Destination = Levels[LevelIndex];
+
+        for (int Y = 0; Y < Destination.Height; ++Y)
+        {
+            const int SourceY0 = std::min(Y * 2, Source.Height - 1);
+            const int SourceY1 = std::min(Y * 2 + 1, Source.Height - 1);
+            for (int X = 0; X < Destination.Width; ++X)
+            {
+                const int SourceX0 = std::min(X * 2, Source.Width - 1);
+                const int SourceX1 = std::min(X * 2 + 1, Source.Width - 1);
+                const olc::Pixel& Texel00 = GetTexel(Source, SourceX0, SourceY0);
+                const olc::Pixel& Texel10 = GetTexel(Source, SourceX1, SourceY0);
+                const olc::Pixel& Texel01 = GetTexel(Source, SourceX0, SourceY1);
+                const olc::Pixel& Texel11 = GetTexel(Source, SourceX1, SourceY1);
+
+                Texels[GetTexelOffset(Destination, X, Y)] = olc::Pixel(
+                    static_cast<uint8_t>((Texel00.r + Texel10.r + Texel01.r + Texel11.r + 2) / 4),
+                    static_cast<uint8_t>((Texel00.g + Texel10.g + Texel01.g + Texel11.g + 2) / 4),
+                    static_cast<uint8_t>((Texel00.b + Texel10.b + Texel01.b + Texel11.b + 2) / 4),
+                    static_cast<uint8_t>((Texel00.a + Texel10.a + Texel01.a + Texel11.a + 2) / 4)
+                );
+            }
+        }
+    }
+
+    SelectSampleFunction();
+}
+
+void XGTexture::Swap(XGTexture& Other)
+{
+    std::swap(Levels, Other.Levels);
+    std::swap(Wrap, Other.Wrap);
+    std::swap(Format, Other.Format);
+    std::swap(SampleFunction, Other.SampleFunction);
+    std::swap(SampleBatchFunction, Other.SampleBatchFunction);
+    std::swap(Texels, Other.Texels);
+    std::swap(Blocks, Other.Blocks);
+    std::swap(DecodedBlockIndices, Other.DecodedBlockIndices);
+    std::swap(DecodedTexels, Other.DecodedTexels);
+    std::swap(VirtualTexture, Other.VirtualTexture);
+    std::swap(FirstResidentLevel, Other.FirstResidentLevel);
+    std::swap(MinLevelOfDetail, Other.MinLevelOfDetail);
+    std::swap(DroppedTexelCount, Other.DroppedTexelCount);
+}
+
+void XGTexture::Compress(XGTextureFormat NewFormat)
+{
+    static_assert(XGBlockCompression::BlockTexelCount == BlockTexelCount, "Texture blocks must match compressed blocks");
+
+    if (Format != UncompressedFormat || NewFormat == UncompressedFormat || VirtualTexture != nullptr)
+    {
+        return;
+    }
+
+    // The texels are already stored block by block, so each block is encoded where it is and keeps its index
+    const size_t WordsPerBlock = NewFormat == BC3Format ? 2 : 1;
+    Blocks.assign(Texels.size() / BlockTexelCount * WordsPerBlock, 0);
+    for (size_t LevelIndex = static_cast<size_t>(FirstResidentLevel); LevelIndex < Levels.size(); ++LevelIndex)
+    {
+        const XGMipLevel& Level = Levels[LevelIndex];
+        const int BlockRowCount = (Level.Height + BlockSizeMask) >> BlockSizeShift;
+        for (int BlockY = 0; BlockY < BlockRowCount; ++BlockY)
+        {
+            for (int BlockX = 0; BlockX < Level.BlocksPerRow; ++BlockX)
+            {
+                // Padding texels past the right and bottom edges of the level are left out of the endpoints
+                uint32_t ValidTexelMask = 0;
+                for (int Y = 0; Y < BlockSize; ++Y)
+                {
+                    for (int X = 0; X < BlockSize; ++X)
+                    {
+                        if ((BlockX << BlockSizeShift) + X < Level.Width && (BlockY << BlockSizeShift) + Y < Level.Height)
+                        {
+                            ValidTexelMask |= 1u << ((Y << BlockSizeShift) | X);
+                        }
+                    }
+                }
+
+                const size_t TexelOffset = GetTexelOffset(Level, BlockX << BlockSizeShift, BlockY << BlockSizeShift);
+                const olc::Pixel* BlockTexels = Texels.data() + TexelOffset;
+                uint64_t* Block = Blocks.data() + TexelOffset / BlockTexelCount * WordsPerBlock;
+                if (NewFormat == BC3Format)
+                {
+                    Block[0] = XGBlockCompression::EncodeAlphaBlock(BlockTexels, ValidTexelMask);
+                    Block[1] = XGBlockCompression::EncodeColorBlock(BlockTexels, ValidTexelMask);
+                }
+                else
+                {
+                    Block[0] = XGBlockCompression::EncodeColorBlock(BlockTexels, ValidTexelMask);
+                }
+            }
+        }
+    }
+
+    Format = NewFormat;
+    std::vector<olc::Pixel>().swap(Texels);
+    DecodedBlockIndices.assign(DecodedBlockCacheSize, std::numeric_limits<size_t>::max());
+    DecodedTexels.assign(DecodedBlockCacheSize * BlockTexelCount, olc::BLACK);
+
+    SelectSampleFunction();
+}
+
+size_t XGTexture::GetMemoryUsage() const
+{
+    return Texels.capacity() * sizeof(olc::Pixel) + Blocks.capacity() * sizeof(uint64_t) +
+        DecodedBlockIndices.capacity() * sizeof(size_t) + DecodedTexels.capacity() * sizeof(olc::Pixel) +
+        (VirtualTexture != nullptr ? VirtualTexture->GetMemoryUsage() : 0);
+}
+
+size_t XGTexture::GetDroppedMemoryUsage() const
+{
+    return GetTexelMemoryUsage(DroppedTexelCount);
+}
+
+size_t XGTexture::GetLevelMemoryUsage(int Level) const
+{
+    const XGMipLevel& MipLevel = Levels[Level];
+    const int BlockRowCount = (MipLevel.Height + BlockSizeMask) >> BlockSizeShift;
+    return GetTexelMemoryUsage(static_cast<size_t>(MipLevel.BlocksPerRow) * static_cast<size_t>(BlockRowCount) * BlockTexelCount);
+}
+
+size_t XGTexture::GetTexelMemoryUsage(size_t TexelCount) const
+{
+    if (Format == UncompressedFormat)
+    {
+        return TexelCount * sizeof(olc::Pixel);
+    }
+
+    const size_t WordsPerBlock = Format == BC3Format ? 2 : 1;
+    return TexelCount / BlockTexelCount * WordsPerBlock * sizeof(uint64_t);
+}
+
+void XGTexture::DropFineLevels(int NewFirstResidentLevel)
+{
+    if (VirtualTexture != nullptr || NewFirstResidentLevel <= FirstResidentLevel || NewFirstResidentLevel >= GetLevelCount())
+    {
+        return;
+    }
+
+    // The resident levels move to the front of a new, smaller buffer, so the memory of the dropped ones is released
+    const size_t DroppedCount = Levels[NewFirstResidentLevel].Offset;
+    for (size_t LevelIndex = static_cast<size_t>(NewFirstResidentLevel); LevelIndex < Levels.size(); ++LevelIndex)
+    {
+        Levels[LevelIndex].Offset -= DroppedCount;
+    }
+
+    if (Format == UncompressedFormat)
+    {
+        std::vector<olc::Pixel>(Texels.begin() + static_cast<std::ptrdiff_t>(DroppedCount), Texels.end()).swap(Texels);
+    }
+    else
+    {
+        // Blocks have new indices, so the decoded blocks no longer match them
+        const size_t WordsPerBlock = Format == BC3Format ? 2 : 1;
+        std::vector<uint64_t>(Blocks.begin() + static_cast<std::ptrdiff_t>(DroppedCount / BlockTexelCount * WordsPerBlock), Blocks.end()).swap(Blocks);
+        std::fill(DecodedBlockIndices.begin(), DecodedBlockIndices.end(), std::numeric_limits<size_t>::max());
+    }
+
+    FirstResidentLevel = NewFirstResidentLevel;
+    MinLevelOfDetail = static_cast<float>(NewFirstResidentLevel);
+    DroppedTexelCount += DroppedCount;
+}
+
+void XGTexture::UpdatePages()
+{
+    if (VirtualTexture != nullptr)
+    {
+        VirtualTexture->Update();
+    }
+}
+
+void XGTexture::SetWrap(XGTextureWrap NewWrap)
+{
+    Wrap = NewWrap;
+    SelectSampleFunction();
+}
+
+bool XGTexture::IsPowerOfTwo() const
+{
+    const int Width = Levels[0].Width;
+    const int Height = Levels[0].Height;
+    return (Width & (Width - 1)) == 0 && (Height & (Height - 1)) == 0;
+}
+
+float XGTexture::GetLevelOfDetail(float DUDX, float DVDX, float DUDY, float DVDY) const
+{
+    // Measure the footprint of the pixel in texels of the first level, using whichever axis stretches it the most
+    const float TexelsPerU = static_cast<float>(Levels[0].Width);
+    const float TexelsPerV = static_cast<float>(Levels[0].Height);
+    const float FootprintX = (DUDX * TexelsPerU) * (DUDX * TexelsPerU) + (DVDX * TexelsPerV) * (DVDX * TexelsPerV);
+    const float FootprintY = (DUDY * TexelsPerU) * (DUDY * TexelsPerU) + (DVDY * TexelsPerV) * (DVDY * TexelsPerV);
+    const float Footprint = std::max(FootprintX, FootprintY);
+
+    // The footprint is squared, so half its log is the log of its size
+    if (!(Footprint > 1.0f))
+    {
+        UsedLevelMask |= 1;
+        return 0.0f;
+    }
+
+    const float LevelOfDetail = std::min(0.5f * std::log2(Footprint), static_cast<float>(Levels.size() - 1));
+    UsedLevelMask |= 1u << static_cast<int>(LevelOfDetail);
+    return LevelOfDetail;
+}
+
+void XGTexture::SelectSampleFunction()
+{
+    if (VirtualTexture != nullptr)
+    {
+        SampleFunction = &XGTexture::SampleVirtual;
+        SampleBatchFunction = &XGTexture::SampleVirtualBatch;
+    }
+    else if (Format == UncompressedFormat)
+    {
+        SelectSampleFunctionFor<false>();
+    }
+    else
+    {
+        SelectSampleFunctionFor<true>();
+    }
+}
+
+template <bool IsCompressed>
+void XGTexture::SelectSampleFunctionFor()
+{
+    const bool IsSizePowerOfTwo = IsPowerOfTwo();
+    switch (Wrap)
+    {
+    case RepeatWrap:
+        SampleFunction = IsSizePowerOfTwo ? &XGTexture::SampleWith<RepeatWrap, true, IsCompressed> : &XGTexture::SampleWith<RepeatWrap, false, IsCompressed>;
+        SampleBatchFunction = IsSizePowerOfTwo ? &XGTexture::SampleBatchWith<RepeatWrap, true, IsCompressed> : &XGTexture::SampleBatchWith<RepeatWrap, false, IsCompressed>;
+        break;
+    case MirrorWrap:
+        SampleFunction = IsSizePowerOfTwo ? &XGTexture::SampleWith<MirrorWrap, true, IsCompressed> : &XGTexture::SampleWith<MirrorWrap, false, IsCompressed>;
+        SampleBatchFunction = IsSizePowerOfTwo ? &XGTexture::SampleBatchWith<MirrorWrap, true, IsCompressed> : &XGTexture::SampleBatchWith<MirrorWrap, false, IsCompressed>;
+        break;
+    default:
+        // Clamping doesn't get any cheaper for power of two sizes
+        SampleFunction = &XGTexture::SampleWith<ClampWrap, false, IsCompressed>;
+        SampleBatchFunction = &XGTexture::SampleBatchWith<ClampWrap, false, IsCompressed>;
+        break;
+    }
+}
+
+olc::Pixel XGTexture::SampleVirtual(XGTextureFilter Filter, float LevelOfDetail, float U, float V) const
+{
+    return VirtualTexture->Sample(Filter, LevelOfDetail, U, V);
+}
+
+void XGTexture::SampleVirtualBatch(XGTextureFilter Filter, float LevelOfDetail, const float* U, const float* V, int Count, olc::Pixel* OutColors) const
+{
+    VirtualTexture->SampleBatch(Filter, LevelOfDetail, U, V, Count, OutColors);
+}
+
+template <bool IsCompressed>
+olc::Pixel XGTexture::FetchTexel(size_t Offset) const
+{
+    if (!IsCompressed)
+    {
+        return Texels[Offset];
+    }
+
+    // Every level starts on a whole block, so dividing a texel's offset by the size of a block gives its block
+    return GetDecodedBlock(Offset / BlockTexelCount)[Offset & (BlockTexelCount - 1)];
+}
+
+template <bool IsCompressed>
+void XGTexture::FetchBilinearTexels(const size_t Offsets[4], uint32_t OutTexels[4]) const
+{
+    // The top left and bottom right texels share a block for most samples, and then so do the other two, so the
+    // block only has to be found in the cache once
+    if (IsCompressed && Offsets[0] / BlockTexelCount == Offsets[3] / BlockTexelCount)
+    {
+        const olc::Pixel* BlockTexels = GetDecodedBlock(Offsets[0] / BlockTexelCount);
+        for (int Index = 0; Index < 4; ++Index)
+        {
+            OutTexels[Index] = BlockTexels[Offsets[Index] & (BlockTexelCount - 1)].n;
+        }
+        return;
+    }
+
+    for (int Index = 0; Index < 4; ++Index)
+    {
+        OutTexels[Index] = FetchTexel<IsCompressed>(Offsets[Index]).n;
+    }
+}
+
+const olc::Pixel* XGTexture::GetDecodedBlock(size_t BlockIndex) const
+{
+    const size_t Slot = (BlockIndex ^ (BlockIndex >> DecodedBlockCacheShift)) & (DecodedBlockCacheSize - 1);
+    if (DecodedBlockIndices[Slot] != BlockIndex)
+    {
+        DecodeBlock(BlockIndex, Slot);
+    }
+
+    return DecodedTexels.data() + Slot * BlockTexelCount;
+}
+
+void XGTexture::DecodeBlock(size_t BlockIndex, size_t Slot) const
+{
+    olc::Pixel* const SlotTexels = DecodedTexels.data() + Slot * BlockTexelCount;
+    if (Format == BC3Format)
+    {
+        XGBlockCompression::DecodeColorBlock(Blocks[BlockIndex * 2 + 1], false, SlotTexels);
+        XGBlockCompression::DecodeAlphaBlock(Blocks[BlockIndex * 2], SlotTexels);
+    }
+    else
+    {
+        XGBlockCompression::DecodeColorBlock(Blocks[BlockIndex], true, SlotTexels);
+    }
+
+    DecodedBlockIndices[Slot] = BlockIndex;
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo>
+int XGTexture::ToFixedTexels(float Coordinate, float FixedTexelsPerUnit)
+{
+    if (WrapMode == ClampWrap)
+    {
+        return static_cast<int>(std::max(0.0f, std::min(Coordinate, 1.0f)) * FixedTexelsPerUnit);
+    }
+
+    if (IsSizePowerOfTwo)
+    {
+        // Wrapping only keeps the low bits, which converting through 64 bits leaves intact
+        return static_cast<int>(static_cast<int64_t>(Coordinate * FixedTexelsPerUnit));
+    }
+
+    // Other sizes need the coordinate moved into the first tile, or the first tile and its mirror, before it's scaled
+    const float Period = WrapMode == MirrorWrap ? 2.0f : 1.0f;
+    return static_cast<int>((Coordinate - Period * FloorCoordinate(Coordinate / Period)) * FixedTexelsPerUnit);
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo>
+int XGTexture::WrapCoordinate(int Coordinate, int Size)
+{
+    if (WrapMode == RepeatWrap)
+    {
+        if (IsSizePowerOfTwo)
+        {
+            return Coordinate & (Size - 1);
+        }
+
+        const int Wrapped = Coordinate % Size;
+        return Wrapped < 0 ? Wrapped + Size : Wrapped;
+    }
+
+    if (WrapMode == MirrorWrap)
+    {
+        if (IsSizePowerOfTwo)
+        {
+            // Every other tile is flipped, and flipping a coordinate within a tile is the same as inverting its bits
+            return ((Coordinate & Size) != 0 ? ~Coordinate : Coordinate) & (Size - 1);
+        }
+
+        const int Period = Size * 2;
+        int Wrapped = Coordinate % Period;
+        if (Wrapped < 0)
+        {
+            Wrapped += Period;
+        }
+
+        return Wrapped < Size ? Wrapped : Period - 1 - Wrapped;
+    }
+
+    return std::max(0, std::min(Coordinate, Size - 1));
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+olc::Pixel XGTexture::SampleWith(XGTextureFilter Filter, float LevelOfDetail, float U, float V) const
+{
+    switch (Filter)
+    {
+    case BilinearFilter:
+        return SampleBilinear<WrapMode, IsSizePowerOfTwo, IsCompressed>(static_cast<int>(LevelOfDetail + 0.5f), U, V);
+    case TrilinearFilter:
+        return SampleTrilinear<WrapMode, IsSizePowerOfTwo, IsCompressed>(LevelOfDetail, U, V);
+    default:
+        return SampleNearest<WrapMode, IsSizePowerOfTwo, IsCompressed>(static_cast<int>(LevelOfDetail + 0.5f), U, V);
+    }
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+olc::Pixel XGTexture::SampleNearest(int Level, float U, float V) const
+{
+    // Shifting the fixed-point coordinates rounds them down, even when they're negative
+    const XGMipLevel& MipLevel = Levels[Level];
+    const int X = ToFixedTexels<WrapMode, IsSizePowerOfTwo>(U, MipLevel.FixedTexelsPerU) >> SubTexelShift;
+    const int Y = ToFixedTexels<WrapMode, IsSizePowerOfTwo>(V, MipLevel.FixedTexelsPerV) >> SubTexelShift;
+    return FetchTexel<IsCompressed>(GetTexelOffset(
+        MipLevel,
+        WrapCoordinate<WrapMode, IsSizePowerOfTwo>(X, MipLevel.Width),
+        WrapCoordinate<WrapMode, IsSizePowerOfTwo>(Y, MipLevel.Height)
+    ));
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo>
+void XGTexture::GetBilinearTexels(const XGMipLevel& MipLevel, float U, float V, size_t OutOffsets[4], int& OutWeightX, int& OutWeightY) const
+{
+    // Texel centres are half a texel in from their edges
+    constexpr int HalfTexel = 1 << (SubTexelShift - 1);
+    const int FixedX = ToFixedTexels<WrapMode, IsSizePowerOfTwo>(U, MipLevel.FixedTexelsPerU) - HalfTexel;
+    const int FixedY = ToFixedTexels<WrapMode, IsSizePowerOfTwo>(V, MipLevel.FixedTexelsPerV) - HalfTexel;
+    OutWeightX = (FixedX & SubTexelMask) >> (SubTexelShift - BilinearWeightShift);
+    OutWeightY = (FixedY & SubTexelMask) >> (SubTexelShift - BilinearWeightShift);
+
+    const int X0 = WrapCoordinate<WrapMode, IsSizePowerOfTwo>(FixedX >> SubTexelShift, MipLevel.Width);
+    const int Y0 = WrapCoordinate<WrapMode, IsSizePowerOfTwo>(FixedY >> SubTexelShift, MipLevel.Height);
+    const int X1 = WrapCoordinate<WrapMode, IsSizePowerOfTwo>((FixedX >> SubTexelShift) + 1, MipLevel.Width);
+    const int Y1 = WrapCoordinate<WrapMode, IsSizePowerOfTwo>((FixedY >> SubTexelShift) + 1, MipLevel.Height);
+
+    OutOffsets[0] = GetTexelOffset(MipLevel, X0, Y0);
+    OutOffsets[1] = GetTexelOffset(MipLevel, X1, Y0);
+    OutOffsets[2] = GetTexelOffset(MipLevel, X0, Y1);
+    OutOffsets[3] = GetTexelOffset(MipLevel, X1, Y1);
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+olc::Pixel XGTexture::SampleBilinear(int Level, float U, float V) const
+{
+    size_t Offsets[4];
+    int WeightX;
+    int WeightY;
+    GetBilinearTexels<WrapMode, IsSizePowerOfTwo>(Levels[Level], U, V, Offsets, WeightX, WeightY);
+
+    const olc::Pixel Texel00 = FetchTexel<IsCompressed>(Offsets[0]);
+    const olc::Pixel Texel10 = FetchTexel<IsCompressed>(Offsets[1]);
+    const olc::Pixel Texel01 = FetchTexel<IsCompressed>(Offsets[2]);
+    const olc::Pixel Texel11 = FetchTexel<IsCompressed>(Offsets[3]);
+
+    // The four weights add up to 1 << (BilinearWeightShift * 2)
+    constexpr int One = 1 << BilinearWeightShift;
+    constexpr int WeightShift = BilinearWeightShift * 2;
+    constexpr int Rounding = 1 << (WeightShift - 1);
+    const int Weight00 = (One - WeightX) * (One - WeightY);
+    const int Weight10 = WeightX * (One - WeightY);
+    const int Weight01 = (One - WeightX) * WeightY;
+    const int Weight11 = WeightX * WeightY;
+
+    return olc::Pixel(
+        static_cast<uint8_t>((Texel00.r * Weight00 + Texel10.r * Weight10 + Texel01.r * Weight01 + Texel11.r * Weight11 + Rounding) >> WeightShift),
+        static_cast<uint8_t>((Texel00.g * Weight00 + Texel10.g * Weight10 + Texel01.g * Weight01 + Texel11.g * Weight11 + Rounding) >> WeightShift),
+        static_cast<uint8_t>((Texel00.b * Weight00 + Texel10.b * Weight10 + Texel01.b * Weight01 + Texel11.b * Weight11 + Rounding) >> WeightShift),
+        static_cast<uint8_t>((Texel00.a * Weight00 + Texel10.a * Weight10 + Texel01.a * Weight01 + Texel11.a * Weight11 + Rounding) >> WeightShift)
+    );
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+olc::Pixel XGTexture::SampleTrilinear(float LevelOfDetail, float U, float V) const
+{
+    const int FinerLevel = static_cast<int>(LevelOfDetail);
+    const int CoarserWeight = static_cast<int>((LevelOfDetail - static_cast<float>(FinerLevel)) * (1 << SubTexelShift));
+    const olc::Pixel Finer = SampleBilinear<WrapMode, IsSizePowerOfTwo, IsCompressed>(FinerLevel, U, V);
+    if (CoarserWeight <= 0 || FinerLevel + 1 >= GetLevelCount())
+    {
+        return Finer;
+    }
+
+    const olc::Pixel Coarser = SampleBilinear<WrapMode, IsSizePowerOfTwo, IsCompressed>(FinerLevel + 1, U, V);
+    const int FinerWeight = (1 << SubTexelShift) - CoarserWeight;
+    constexpr int Rounding = 1 << (SubTexelShift - 1);
+    return olc::Pixel(
+        static_cast<uint8_t>((Finer.r * FinerWeight + Coarser.r * CoarserWeight + Rounding) >> SubTexelShift),
+        static_cast<uint8_t>((Finer.g * FinerWeight + Coarser.g * CoarserWeight + Rounding) >> SubTexelShift),
+        static_cast<uint8_t>((Finer.b * FinerWeight + Coarser.b * CoarserWeight + Rounding) >> SubTexelShift),
+        static_cast<uint8_t>((Finer.a * FinerWeight + Coarser.a * CoarserWeight + Rounding) >> SubTexelShift)
+    );
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+void XGTexture::SampleBatchWith(XGTextureFilter Filter, float LevelOfDetail, const float* U, const float* V, int Count, olc::Pixel* OutColors) const
+{
+    switch (Filter)
+    {
+    case BilinearFilter:
+        SampleBilinearBatch<WrapMode, IsSizePowerOfTwo, IsCompressed>(static_cast<int>(LevelOfDetail + 0.5f), U, V, Count, OutColors);
+        break;
+    case TrilinearFilter:
+    {
+        // The whole batch shares a level of detail, so it blends the same two levels by the same amount
+        const int FinerLevel = static_cast<int>(LevelOfDetail);
+        const int CoarserWeight = static_cast<int>((LevelOfDetail - static_cast<float>(FinerLevel)) * (1 << SubTexelShift));
+        SampleBilinearBatch<WrapMode, IsSizePowerOfTwo, IsCompressed>(FinerLevel, U, V, Count, OutColors);
+        if (CoarserWeight <= 0 || FinerLevel + 1 >= GetLevelCount())
+        {
+            break;
+        }
+
+        olc::Pixel CoarserColors[SampleBatchSize];
+        SampleBilinearBatch<WrapMode, IsSizePowerOfTwo, IsCompressed>(FinerLevel + 1, U, V, Count, CoarserColors);
+
+        const int FinerWeight = (1 << SubTexelShift) - CoarserWeight;
+        constexpr int Rounding = 1 << (SubTexelShift - 1);
+        for (int Index = 0; Index < Count; ++Index)
+        {
+            const olc::Pixel Finer = OutColors[Index];
+            const olc::Pixel& Coarser = CoarserColors[Index];
+            OutColors[Index] = olc::Pixel(
+                static_cast<uint8_t>((Finer.r * FinerWeight + Coarser.r * CoarserWeight + Rounding) >> SubTexelShift),
+                static_cast<uint8_t>((Finer.g * FinerWeight + Coarser.g * CoarserWeight + Rounding) >> SubTexelShift),
+                static_cast<uint8_t>((Finer.b * FinerWeight + Coarser.b * CoarserWeight + Rounding) >> SubTexelShift),
+                static_cast<uint8_t>((Finer.a * FinerWeight + Coarser.a * CoarserWeight + Rounding) >> SubTexelShift)
+            );
+        }
+        break;
+    }
+    default:
+    {
+        const int Level = static_cast<int>(LevelOfDetail + 0.5f);
+        for (int Index = 0; Index < Count; ++Index)
+        {
+            OutColors[Index] = SampleNearest<WrapMode, IsSizePowerOfTwo, IsCompressed>(Level, U[Index], V[Index]);
+        }
+        break;
+    }
+    }
+}
+
+template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+void XGTexture::SampleBilinearBatch(int Level, const float* U, const float* V, int Count, olc::Pixel* OutColors) const
+{
+#ifdef XG_USE_SSE2
+    const XGMipLevel& MipLevel = Levels[Level];
+
+    constexpr int One = 1 << BilinearWeightShift;
+    constexpr int WeightShift = BilinearWeightShift * 2;
+    const __m128i Zero = _mm_setzero_si128();
+    const __m128i Rounding = _mm_set1_epi32(1 << (WeightShift - 1));
+
+    // Four pixels are filtered at a time, each in its own register, and packed back into four colors together
+    for (int FirstIndex = 0; FirstIndex < Count; FirstIndex += 4)
+    {
+        __m128i Colors[4];
+        for (int Lane = 0; Lane < 4; ++Lane)
+        {
+            // Lanes past the end of the batch repeat its last sample, and are never stored
+            const int Index = std::min(FirstIndex + Lane, Count - 1);
+            size_t Offsets[4];
+            int WeightX;
+            int WeightY;
+            GetBilinearTexels<WrapMode, IsSizePowerOfTwo>(MipLevel, U[Index], V[Index], Offsets, WeightX, WeightY);
+            uint32_t SampleTexels[4];
+            FetchBilinearTexels<IsCompressed>(Offsets, SampleTexels);
+
+            // Interleave the left and right texels channel by channel and widen them to 16 bits, with the top row in
+            // one register and the bottom row in another. A multiply-add against pairs of weights then blends each
+            // channel of a row in a single instruction.
+            const __m128i Left = _mm_unpacklo_epi32(
+                _mm_cvtsi32_si128(static_cast<int>(SampleTexels[0])),
+                _mm_cvtsi32_si128(static_cast<int>(SampleTexels[2]))
+            );
+            const __m128i Right = _mm_unpacklo_epi32(
+                _mm_cvtsi32_si128(static_cast<int>(SampleTexels[1])),
+                _mm_cvtsi32_si128(static_cast<int>(SampleTexels[3]))
+            );
+            const __m128i Interleaved = _mm_unpacklo_epi8(Left, Right);
+            const __m128i Top = _mm_unpacklo_epi8(Interleaved, Zero);
+            const __m128i Bottom = _mm_unpackhi_epi8(Interleaved, Zero);
+
+            // Each weight is at most 1 << WeightShift, which still fits in a signed 16 bit lane
+            const int Weight00 = (One - WeightX) * (One - WeightY);
+            const int Weight10 = WeightX * (One - WeightY);
+            const int Weight01 = (One - WeightX) * WeightY;
+            const int Weight11 = WeightX * WeightY;
+            const __m128i TopWeights = _mm_set1_epi32(Weight00 | (Weight10 << 16));
+            const __m128i BottomWeights = _mm_set1_epi32(Weight01 | (Weight11 << 16));
+
+            const __m128i Sum = _mm_add_epi32(_mm_madd_epi16(Top, TopWeights), _mm_madd_epi16(Bottom, BottomWeights));
+            Colors[Lane] = _mm_srli_epi32(_mm_add_epi32(Sum, Rounding), WeightShift);
+        }
+
+        const __m128i Packed = _mm_packus_epi16(_mm_packs_epi32(Colors[0], Colors[1]), _mm_packs_epi32(Colors[2], Colors[3]));
+        if (FirstIndex + 4 <= Count)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(OutColors + FirstIndex), Packed);
+        }
+        else
+        {
+            olc::Pixel Remaining[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(Remaining), Packed);
+            std::copy(Remaining, Remaining + (Count - FirstIndex), OutColors + FirstIndex);
+        }
+    }
+#else
+    for (int Index = 0; Index < Count; ++Index)
+    {
+        OutColors[Index] = SampleBilinear<WrapMode, IsSizePowerOfTwo, IsCompressed>(Level, U[Index], V[Index]);
+    }
+#endif
+}
@@ -0,0 +1,463 @@
+﻿// XGTexture.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+
+class XGVirtualTexture;
+
+/**
+ * \brief The ways a texture can be filtered when it is sampled
+ */
+enum XGTextureFilter
+{
+    /**
+     * \brief The nearest texel of the nearest mip level
+     */
+    NearestFilter,
+
+    /**
+     * \brief The four nearest texels of the nearest mip level, blended by distance
+     */
+    BilinearFilter,
+
+    /**
+     * \brief Bilinear samples from the two nearest mip levels, blended by how close the level of detail is to each
+     */
+    TrilinearFilter
+};
+
+/**
+ * \brief What happens to texture coordinates that fall outside of the texture
+ */
+enum XGTextureWrap
+{
+    /**
+     * \brief Coordinates are clamped to the nearest edge texel
+     */
+    ClampWrap,
+
+    /**
+     * \brief The texture tiles, so coordinates wrap around to the opposite edge
+     */
+    RepeatWrap,
+
+    /**
+     * \brief The texture tiles, flipping every other tile so its edges meet seamlessly
+     */
+    MirrorWrap
+};
+
+/**
+ * \brief How the texels of a texture are stored
+ */
+enum XGTextureFormat
+{
+    /**
+     * \brief 32 bits per texel
+     */
+    UncompressedFormat,
+
+    /**
+     * \brief 4 bits per texel, in BC1 blocks. Alpha is dropped, so every texel is opaque.
+     */
+    BC1Format,
+
+    /**
+     * \brief 8 bits per texel, in BC3 blocks, which keep alpha
+     */
+    BC3Format
+};
+
+/**
+ * \brief A texture with a full chain of mip levels, each half the size of the one before, down to a single texel
+ * \details Distant surfaces sample the smaller levels, which both stops them from aliasing and keeps the texels they
+ * read close together in memory.
+ *
+ * Each level is stored in 4x4 blocks of texels rather than row by row. A block is 64 bytes, a single cache line, so a
+ * span that walks diagonally across the texture (common on terrain) reads a new line every few texels instead of on
+ * every texel, and the 2x2 texels read by a bilinear sample usually share a line.
+ *
+ * Sampling is done by a family of samplers specialized at compile time on the wrap mode and on whether the texture's
+ * sides are powers of two, which lets tiling textures wrap with a mask. The right one is picked whenever the texture
+ * is loaded or its wrap mode changes, so the per-texel work is all integer math on fixed-point texel coordinates.
+ * SampleBatch samples several pixels per call, which lets the bilinear filter blend four pixels at a time with SSE2.
+ *
+ * Compress swaps the texels for BC1 or BC3 blocks, which are an eighth or a quarter of the size, so far larger textures
+ * stay in the cache. The samplers decode blocks as they reach them into a small cache of decoded blocks. Spans read the
+ * same few blocks over and over, so most texels come from a block that was decoded for an earlier one. The cache
+ * changes as the texture is sampled, so a compressed texture must only be sampled from one thread at a time.
+ *
+ * A texture loaded from a page file is a virtual texture, which keeps only the pages of its levels that are being
+ * sampled in memory and streams the rest from disk (see XGVirtualTexture). Its samplers forward to the virtual texture,
+ * so it is drawn like any other texture, but UpdatePages must be called once per frame to load the pages it needs.
+ * Virtual textures always repeat, and can't be compressed.
+ *
+ * DropFineLevels releases the finest levels of a texture that is only being drawn from a distance, and samples of those
+ * levels then use the finest level that is left. GetLevelOfDetail records the levels it picks, so XGTextureResidency
+ * can tell which levels are still wanted.
+ */
+class XGTexture
+{
+public:
+    /**
+     * \brief The most texture coordinates SampleBatch takes in one call
+     */
+    static constexpr int SampleBatchSize = 16;
+
+    /**
+     * \brief The most mip levels a texture can have, which is enough for sides of up to 2^31 texels
+     */
+    static constexpr int MaxLevelCount = 32;
+
+    /**
+     * \brief Rounds a texture coordinate down to a whole number like std::floor, which is a library call on targets
+     * without SSE4.1
+     */
+    static float FloorCoordinate(float Coordinate)
+    {
+        // Floats this large have no fraction, and converting them to int could overflow
+        if (!(std::fabs(Coordinate) < 8388608.0f))
+        {
+            return Coordinate;
+        }
+
+        const float Truncated = static_cast<float>(static_cast<int>(Coordinate));
+        return Truncated > Coordinate ? Truncated - 1.0f : Truncated;
+    }
+
+    XGTexture() = default;
+    ~XGTexture();
+
+    XGTexture(const XGTexture&) = delete;
+    XGTexture& operator=(const XGTexture&) = delete;
+
+    /**
+     * \brief Loads an image and builds its mip chain, or opens a page file as a virtual texture
+     * \return False if the image couldn't be loaded
+     */
+    bool LoadFromFile(const std::string& FilePath);
+
+    /**
+     * \brief Opens a page file written by XGVirtualTexture::WritePageFile as a virtual texture
+     * \param PhysicalPageCount The number of pages that can be in memory at once
+     * \return False if the page file couldn't be opened
+     */
+    bool LoadFromPageFile(const std::string& FilePath, int PhysicalPageCount);
+
+    /**
+     * \brief Copies the pixels of a sprite into the first mip level and builds the rest of the chain from it
+     */
+    void LoadFromSprite(const olc::Sprite& Sprite);
+
+    /**
+     * \brief Exchanges everything about this texture with another, so a texture built elsewhere can replace this one
+     * without copying its texels. The levels used since the last call to TakeUsedLevels stay with each texture, since
+     * they describe how the texture is being drawn rather than what it holds.
+     */
+    void Swap(XGTexture& Other);
+
+    int GetLevelCount() const { return static_cast<int>(Levels.size()); }
+    int GetWidth(int Level = 0) const { return Levels[Level].Width; }
+    int GetHeight(int Level = 0) const { return Levels[Level].Height; }
+
+    size_t GetMemoryUsage() const;
+
+    /**
+     * \brief Returns the bytes the levels dropped by DropFineLevels held, which reloading the texture would take again
+     */
+    size_t GetDroppedMemoryUsage() const;
+
+    /**
+     * \brief Returns the bytes one level holds, including the padding out to whole blocks
+     */
+    size_t GetLevelMemoryUsage(int Level) const;
+
+    /**
+     * \brief Returns the finest level that hasn't been dropped. Samples of finer levels use this one instead.
+     */
+    int GetFirstResidentLevel() const { return FirstResidentLevel; }
+
+    /**
+     * \brief Releases the texels of every level finer than the given one, keeping the texture's size and level count
+     * \details Does nothing for virtual textures, which manage their own memory, or if the given level is the last.
+     */
+    void DropFineLevels(int NewFirstResidentLevel);
+
+    /**
+     * \brief Returns one bit for each level GetLevelOfDetail has picked since the last call, lowest bit for the finest
+     * level, and clears them. Levels that have been dropped are included, since they are what was wanted.
+     */
+    uint32_t TakeUsedLevels()
+    {
+        const uint32_t UsedLevels = UsedLevelMask;
+        UsedLevelMask = 0;
+        return UsedLevels;
+    }
+
+    XGTextureFormat GetFormat() const { return Format; }
+
+    /**
+     * \brief Encodes every mip level into blocks of the given format and releases the uncompressed texels
+     * \details Does nothing if the texture is already compressed, since its uncompressed texels are gone.
+     */
+    void Compress(XGTextureFormat NewFormat);
+
+    /**
+     * \brief The virtual texture the texture was loaded from, or null if it was loaded from an image
+     */
+    const XGVirtualTexture* GetVirtualTexture() const { return VirtualTexture; }
+
+    /**
+     * \brief Publishes the pages of a virtual texture that finished loading and starts loading the ones sampled without
+     * being resident since the last call. Does nothing for other textures. Call once per frame, before drawing.
+     */
+    void UpdatePages();
+
+    XGTextureWrap GetWrap() const { return Wrap; }
+    void SetWrap(XGTextureWrap NewWrap);
+
+    /**
+     * \brief Returns true if both sides of the texture are powers of two, so every mip level's sides are as well
+     */
+    bool IsPowerOfTwo() const;
+
+    /**
+     * \brief Finds the level of detail for a pixel, given how far the texture coordinates move across it
+     * \param DUDX The change in U from this pixel to the one on its right
+     * \param DVDX The change in V from this pixel to the one on its right
+     * \param DUDY The change in U from this pixel to the one below it
+     * \param DVDY The change in V from this pixel to the one below it
+     * \return The mip level whose texels are about the size of the pixel, with a fraction between levels. Zero when
+     * texels are larger than pixels. The level is recorded as used, for TakeUsedLevels.
+     */
+    float GetLevelOfDetail(float DUDX, float DVDX, float DUDY, float DVDY) const;
+
+    /**
+     * \brief Samples the texture with the given filter
+     * \param Filter How the texels around the texture coordinates are combined
+     * \param LevelOfDetail The mip level to sample, as returned by GetLevelOfDetail. The nearest and bilinear filters
+     * round it to the nearest level. Levels that have been dropped are sampled from the first resident level.
+     * \param U The horizontal texture coordinate, from 0 to 1
+     * \param V The vertical texture coordinate, from 0 to 1
+     */
+    olc::Pixel Sample(XGTextureFilter Filter, float LevelOfDetail, float U, float V) const
+    {
+        return (this->*SampleFunction)(Filter, std::max(LevelOfDetail, MinLevelOfDetail), U, V);
+    }
+
+    /**
+     * \brief Samples the texture at several texture coordinates with the same filter and level of detail
+     * \param Count The number of texture coordinates, up to SampleBatchSize
+     * \param OutColors Receives one color per texture coordinate
+     */
+    void SampleBatch(XGTextureFilter Filter, float LevelOfDetail, const float* U, const float* V, int Count, olc::Pixel* OutColors) const
+    {
+        (this->*SampleBatchFunction)(Filter, std::max(LevelOfDetail, MinLevelOfDetail), U, V, Count, OutColors);
+    }
+
+private:
+    /**
+     * \brief The number of fractional bits in fixed-point texel coordinates
+     */
+    static constexpr int SubTexelShift = 8;
+    static constexpr int SubTexelMask = (1 << SubTexelShift) - 1;
+
+    /**
+     * \brief The number of fractional bits in each axis of a bilinear weight. The four weights of a sample multiply
+     * two of these together, so they still fit in 16 bits.
+     */
+    static constexpr int BilinearWeightShift = 7;
+
+    struct XGMipLevel
+    {
+        int Width;
+        int Height;
+        int BlocksPerRow;
+
+        /**
+         * \brief The factors to convert texture coordinates to fixed-point texel coordinates in this level
+         */
+        float FixedTexelsPerU;
+        float FixedTexelsPerV;
+
+        /**
+         * \brief The index of the level's first texel in Texels
+         */
+        size_t Offset;
+    };
+
+    static constexpr int BlockSizeShift = 2;
+    static constexpr int BlockSize = 1 << BlockSizeShift;
+    static constexpr int BlockSizeMask = BlockSize - 1;
+    static constexpr int BlockTexelCount = BlockSize * BlockSize;
+
+    /**
+     * \brief The number of blocks the decoded block cache holds, which is 64KB of texels
+     */
+    static constexpr int DecodedBlockCacheShift = 10;
+    static constexpr size_t DecodedBlockCacheSize = static_cast<size_t>(1) << DecodedBlockCacheShift;
+
+    using XGSampleFunction = olc::Pixel (XGTexture::*)(XGTextureFilter, float, float, float) const;
+    using XGSampleBatchFunction = void (XGTexture::*)(XGTextureFilter, float, const float*, const float*, int, olc::Pixel*) const;
+
+    std::vector<XGMipLevel> Levels;
+
+    XGTextureWrap Wrap = ClampWrap;
+
+    XGTextureFormat Format = UncompressedFormat;
+
+    /**
+     * \brief The finest level whose texels are held, and the same as a level of detail, which samples are clamped to
+     */
+    int FirstResidentLevel = 0;
+    float MinLevelOfDetail = 0.0f;
+
+    /**
+     * \brief The number of texels the dropped levels held
+     */
+    size_t DroppedTexelCount = 0;
+
+    /**
+     * \brief One bit for each level picked by GetLevelOfDetail since the last call to TakeUsedLevels
+     */
+    mutable uint32_t UsedLevelMask = 0;
+
+    /**
+     * \brief The sampler specialized for the texture's wrap mode, size and format. Chosen when the texture is loaded or
+     * compressed.
+     */
+    XGSampleFunction SampleFunction = nullptr;
+    XGSampleBatchFunction SampleBatchFunction = nullptr;
+
+    /**
+     * \brief The texels of every resident level, largest level first. Levels are padded out to a whole number of blocks.
+     */
+    std::vector<olc::Pixel> Texels;
+
+    /**
+     * \brief The blocks of every level when the texture is compressed, in the same order as the blocks of Texels. A BC3
+     * block is two words, alpha first.
+     */
+    std::vector<uint64_t> Blocks;
+
+    /**
+     * \brief The index of the block decoded into each slot of the decoded block cache. Blocks are placed in a slot picked
+     * from the low bits of their index, folded with the bits above them so the blocks above and below a block don't
+     * share its slot.
+     */
+    mutable std::vector<size_t> DecodedBlockIndices;
+
+    /**
+     * \brief The texels of the decoded blocks, BlockTexelCount per slot
+     */
+    mutable std::vector<olc::Pixel> DecodedTexels;
+
+    /**
+     * \brief The virtual texture that owns the texels when the texture was loaded from a page file. Levels then only
+     * holds the size of each level.
+     */
+    XGVirtualTexture* VirtualTexture = nullptr;
+
+    /**
+     * \brief Returns the bytes a number of texels take up in the texture's format
+     */
+    size_t GetTexelMemoryUsage(size_t TexelCount) const;
+
+    static size_t GetTexelOffset(const XGMipLevel& Level, int X, int Y)
+    {
+        return Level.Offset +
+            (static_cast<size_t>(Y >> BlockSizeShift) * static_cast<size_t>(Level.BlocksPerRow) + static_cast<size_t>(X >> BlockSizeShift)) * BlockTexelCount +
+            static_cast<size_t>(((Y & BlockSizeMask) << BlockSizeShift) | (X & BlockSizeMask));
+    }
+
+    const olc::Pixel& GetTexel(const XGMipLevel& Level, int X, int Y) const
+    {
+        return Texels[GetTexelOffset(Level, X, Y)];
+    }
+
+    /**
+     * \brief Reads the texel at an offset returned by GetTexelOffset, decoding its block first if the texture is
+     * compressed and the block isn't in the decoded block cache
+     */
+    template <bool IsCompressed>
+    olc::Pixel FetchTexel(size_t Offset) const;
+
+    /**
+     * \brief Reads the four texels of a bilinear sample as packed colors, at the offsets returned by GetBilinearTexels
+     */
+    template <bool IsCompressed>
+    void FetchBilinearTexels(const size_t Offsets[4], uint32_t OutTexels[4]) const;
+
+    /**
+     * \brief Returns the texels of a block from the decoded block cache, decoding it first if it isn't there
+     */
+    const olc::Pixel* GetDecodedBlock(size_t BlockIndex) const;
+
+    /**
+     * \brief Decodes a block into a slot of the decoded block cache
+     */
+    void DecodeBlock(size_t BlockIndex, size_t Slot) const;
+
+    /**
+     * \brief Picks the sampler that matches the texture's wrap mode, size and format
+     */
+    void SelectSampleFunction();
+
+    template <bool IsCompressed>
+    void SelectSampleFunctionFor();
+
+    olc::Pixel SampleVirtual(XGTextureFilter Filter, float LevelOfDetail, float U, float V) const;
+    void SampleVirtualBatch(XGTextureFilter Filter, float LevelOfDetail, const float* U, const float* V, int Count, olc::Pixel* OutColors) const;
+
+    /**
+     * \brief Scales a texture coordinate to fixed-point texels, keeping only as much of it as wrapping needs
+     * \details Coordinates far outside the texture, which tiled terrain produces, would otherwise overflow an int once
+     * scaled. The result still has to be wrapped.
+     */
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo>
+    static int ToFixedTexels(float Coordinate, float FixedTexelsPerUnit);
+
+    /**
+     * \brief Wraps a texel coordinate into the range [0, Size)
+     */
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo>
+    static int WrapCoordinate(int Coordinate, int Size);
+
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+    olc::Pixel SampleWith(XGTextureFilter Filter, float LevelOfDetail, float U, float V) const;
+
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+    olc::Pixel SampleNearest(int Level, float U, float V) const;
+
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+    olc::Pixel SampleBilinear(int Level, float U, float V) const;
+
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+    olc::Pixel SampleTrilinear(float LevelOfDetail, float U, float V) const;
+
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+    void SampleBatchWith(XGTextureFilter Filter, float LevelOfDetail, const float* U, const float* V, int Count, olc::Pixel* OutColors) const;
+
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo, bool IsCompressed>
+    void SampleBilinearBatch(int Level, const float* U, const float* V, int Count, olc::Pixel* OutColors) const;
+
+    /**
+     * \brief Finds the texels and weights of a bilinear sample
+     * \param OutOffsets Receives the offsets of the top left, top right, bottom left and bottom right texels
+     * \param OutWeightX How far the sample is from the left texels to the right ones, from 0 to 1 << BilinearWeightShift
+     * \param OutWeightY How far the sample is from the top texels to the bottom ones, from 0 to 1 << BilinearWeightShift
+     */
+    template <XGTextureWrap WrapMode, bool IsSizePowerOfTwo>
+    void GetBilinearTexels(const XGMipLevel& MipLevel, float U, float V, size_t OutOffsets[4], int& OutWeightX, int& OutWeightY) const;
+};
@@ -0,0 +1,135 @@
+﻿// XGTextureLoader.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGTextureLoader.h"
+
+#include <iostream>
+
+XGTextureLoader::~XGTextureLoader()
+{
+    Stop();
+}
+
+void XGTextureLoader::Load(XGTexture& Texture, const std::string& FilePath, XGTextureWrap Wrap, XGTextureFormat Format)
+{
+    olc::Sprite Placeholder(1, 1);
+    Placeholder.pColData[0] = PlaceholderColor;
+    Texture.LoadFromSprite(Placeholder);
+    Texture.SetWrap(Wrap);
+
+    QueueLoad(Texture, FilePath, Wrap, Format);
+}
+
+void XGTextureLoader::Reload(XGTexture& Texture, const std::string& FilePath)
+{
+    QueueLoad(Texture, FilePath, Texture.GetWrap(), Texture.GetFormat());
+}
+
+void XGTextureLoader::QueueLoad(XGTexture& Texture, const std::string& FilePath, XGTextureWrap Wrap, XGTextureFormat Format)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        QueuedLoads.push_back({ &Texture, FilePath, Wrap, Format, nullptr });
+    }
+
+    if (!Worker.joinable())
+    {
+        Worker = std::thread(&XGTextureLoader::LoadQueuedTextures, this);
+    }
+    LoadQueued.notify_one();
+}
+
+int XGTextureLoader::PublishLoadedTextures()
+{
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (FinishedLoads.empty())
+        {
+            return 0;
+        }
+
+        PublishingLoads.swap(FinishedLoads);
+    }
+
+    int PublishedCount = 0;
+    for (XGTextureLoad& Load : PublishingLoads)
+    {
+        if (Load.LoadedTexture == nullptr)
+        {
+            std::cout << "ERROR: Failed to load texture at path: " << Load.FilePath << std::endl;
+            continue;
+        }
+
+        // The placeholder goes to the loaded texture, which is then done with
+        Load.Texture->Swap(*Load.LoadedTexture);
+        delete Load.LoadedTexture;
+        ++PublishedCount;
+    }
+    PublishingLoads.clear();
+
+    return PublishedCount;
+}
+
+bool XGTextureLoader::HasPendingLoads() const
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return !QueuedLoads.empty() || IsLoading || !FinishedLoads.empty();
+}
+
+void XGTextureLoader::Stop()
+{
+    if (Worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            IsStopping = true;
+        }
+        LoadQueued.notify_one();
+        Worker.join();
+    }
+
+    for (XGTextureLoad& Load : FinishedLoads)
+    {
+        delete Load.LoadedTexture;
+    }
+    FinishedLoads.clear();
+    QueuedLoads.clear();
+    IsStopping = false;
+}
+
+void XGTextureLoader::LoadQueuedTextures()
+{
+    std::unique_lock<std::mutex> Lock(Mutex);
+    while (true)
+    {
+        LoadQueued.wait(Lock, [this]() { return IsStopping || !QueuedLoads.empty(); });
+        if (IsStopping)
+        {
+            return;
+        }
+
+        XGTextureLoad Load = QueuedLoads.front();
+        QueuedLoads.pop_front();
+        IsLoading = true;
+
+        // Nothing else can see the new texture until it is published, so it is built without the lock
+        Lock.unlock();
+        Load.LoadedTexture = new XGTexture();
+        if (Load.LoadedTexture->LoadFromFile(Load.FilePath))
+        {
+            Load.LoadedTexture->SetWrap(Load.Wrap);
+            Load.LoadedTexture->Compress(Load.Format);
+        }
+        else
+        {
+            delete Load.LoadedTexture;
+            Load.LoadedTexture = nullptr;
+        }
+        Lock.lock();
+
+        FinishedLoads.push_back(Load);
+        IsLoading = false;
+    }
+}
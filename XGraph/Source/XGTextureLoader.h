@@ -0,0 +1,112 @@
+﻿// XGTextureLoader.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+#include "XGTexture.h"
+
+/**
+ * \brief Loads textures on a worker thread, so decoding images and building their mip chains doesn't stall the frame
+ * \details Load gives the texture a placeholder straight away and queues the file. The worker decodes it into a texture
+ * of its own, builds its mip chain and compresses it, all without touching the texture being drawn. Finished textures
+ * wait until PublishLoadedTextures, called between frames, swaps each one's contents with its placeholder in a single
+ * step, so a frame is drawn entirely with the placeholder or entirely with the loaded texture.
+ *
+ * Files are loaded in the order they were queued. The worker thread is started by the first load and runs until Stop.
+ */
+class XGTextureLoader
+{
+public:
+    XGTextureLoader() = default;
+    ~XGTextureLoader();
+
+    XGTextureLoader(const XGTextureLoader&) = delete;
+    XGTextureLoader& operator=(const XGTextureLoader&) = delete;
+
+    /**
+     * \brief The color of the single texel placeholder textures show until their file has loaded
+     */
+    olc::Pixel PlaceholderColor = olc::GREY;
+
+    /**
+     * \brief Gives a texture the placeholder and queues a file to be loaded into it
+     * \details The texture must not be destroyed until its load is published, or Stop is called.
+     * \param Wrap The wrap mode to give the loaded texture
+     * \param Format The format to compress the loaded texture to
+     */
+    void Load(XGTexture& Texture, const std::string& FilePath, XGTextureWrap Wrap, XGTextureFormat Format);
+
+    /**
+     * \brief Queues a file to be loaded again into a texture, which keeps drawing as it is until the load is published
+     * \details The loaded texture is given the texture's current wrap mode and format.
+     */
+    void Reload(XGTexture& Texture, const std::string& FilePath);
+
+    /**
+     * \brief Swaps the textures that have finished loading in for their placeholders. Textures that failed to load keep
+     * their placeholder. Call between frames, on the thread that draws the textures.
+     * \return The number of textures that were swapped in
+     */
+    int PublishLoadedTextures();
+
+    /**
+     * \brief Returns true if any queued texture hasn't been published yet
+     */
+    bool HasPendingLoads() const;
+
+    /**
+     * \brief Stops the worker thread, finishing the texture it is loading first, and discards every load that hasn't
+     * been published
+     */
+    void Stop();
+
+private:
+    struct XGTextureLoad
+    {
+        XGTexture* Texture;
+        std::string FilePath;
+        XGTextureWrap Wrap;
+        XGTextureFormat Format;
+
+        /**
+         * \brief The texture the worker loaded the file into, which is null if it couldn't be loaded
+         */
+        XGTexture* LoadedTexture;
+    };
+
+    /**
+     * \brief The worker thread, and everything it shares with the thread calling Load
+     */
+    std::thread Worker;
+    mutable std::mutex Mutex;
+    std::condition_variable LoadQueued;
+    std::deque<XGTextureLoad> QueuedLoads;
+    std::vector<XGTextureLoad> FinishedLoads;
+    bool IsLoading = false;
+    bool IsStopping = false;
+
+    /**
+     * \brief Loads finished by the worker, swapped out under the lock when they are published
+     */
+    std::vector<XGTextureLoad> PublishingLoads;
+
+    /**
+     * \brief Adds a load to the queue, starting the worker thread if it isn't running
+     */
+    void QueueLoad(XGTexture& Texture, const std::string& FilePath, XGTextureWrap Wrap, XGTextureFormat Format);
+
+    /**
+     * \brief Runs on the worker thread, loading queued files until the loader is stopped
+     */
+    void LoadQueuedTextures();
+};
@@ -0,0 +1,183 @@
+﻿// XGTextureResidency.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGTextureResidency.h"
+
+#include <algorithm>
+#include <iterator>
+
+void XGTextureResidency::Register(XGTexture& Texture, const std::string& FilePath)
+{
+    // Nothing is known about how the texture is used until it has been drawn, so its levels count as used until the
+    // update after next
+    XGResidentTexture ResidentTexture;
+    ResidentTexture.Texture = &Texture;
+    ResidentTexture.FilePath = FilePath;
+    std::fill(std::begin(ResidentTexture.LevelLastUsedFrames), std::end(ResidentTexture.LevelLastUsedFrames), FrameIndex + 1);
+    ResidentTexture.LevelCount = Texture.GetLevelCount();
+    ResidentTexture.FirstResidentLevel = Texture.GetFirstResidentLevel();
+    ResidentTexture.IsReloading = false;
+    ResidentTexture.CanReload = true;
+    Textures.push_back(ResidentTexture);
+}
+
+void XGTextureResidency::Clear()
+{
+    Textures.clear();
+    Stats = XGTextureResidencyStats();
+}
+
+void XGTextureResidency::Update(XGTextureLoader& Loader, size_t BudgetBytes)
+{
+    ++FrameIndex;
+    Stats.LevelsDropped = 0;
+    Stats.ReloadsStarted = 0;
+
+    // Reloads are finished once the loader has published everything. A texture that is still missing levels then
+    // couldn't be loaded again.
+    const bool IsLoaderIdle = !Loader.HasPendingLoads();
+    size_t ResidentBytes = 0;
+    for (XGResidentTexture& ResidentTexture : Textures)
+    {
+        if (ResidentTexture.IsReloading && IsLoaderIdle)
+        {
+            ResidentTexture.IsReloading = false;
+            ResidentTexture.CanReload = ResidentTexture.Texture->GetFirstResidentLevel() == 0;
+        }
+
+        // A texture the loader has replaced gets the same grace as a new one
+        const XGTexture& Texture = *ResidentTexture.Texture;
+        if (Texture.GetLevelCount() != ResidentTexture.LevelCount || Texture.GetFirstResidentLevel() != ResidentTexture.FirstResidentLevel)
+        {
+            std::fill(std::begin(ResidentTexture.LevelLastUsedFrames), std::end(ResidentTexture.LevelLastUsedFrames), FrameIndex);
+        }
+
+        uint32_t UsedLevels = ResidentTexture.Texture->TakeUsedLevels();
+        for (int Level = 0; UsedLevels != 0; ++Level, UsedLevels >>= 1)
+        {
+            if ((UsedLevels & 1) != 0)
+            {
+                ResidentTexture.LevelLastUsedFrames[Level] = FrameIndex;
+            }
+        }
+
+        ResidentBytes += ResidentTexture.Texture->GetMemoryUsage();
+    }
+
+    // Reload the textures whose dropped levels were wanted during the last frame, if they fit
+    for (XGResidentTexture& ResidentTexture : Textures)
+    {
+        if (ResidentTexture.IsReloading || !ResidentTexture.CanReload)
+        {
+            continue;
+        }
+
+        const int FirstResidentLevel = ResidentTexture.Texture->GetFirstResidentLevel();
+        const uint32_t* DroppedLevels = ResidentTexture.LevelLastUsedFrames;
+        if (std::find(DroppedLevels, DroppedLevels + FirstResidentLevel, FrameIndex) == DroppedLevels + FirstResidentLevel)
+        {
+            continue;
+        }
+
+        // Once it is published, the texture holds its dropped levels again on top of what it holds now. Levels are only
+        // dropped to make room once it's known that enough can be.
+        const size_t DroppedBytes = ResidentTexture.Texture->GetDroppedMemoryUsage();
+        if (BudgetBytes != 0 && ResidentBytes + DroppedBytes > BudgetBytes)
+        {
+            if (ResidentBytes + DroppedBytes > BudgetBytes + GetUnusedBytes(&ResidentTexture))
+            {
+                continue;
+            }
+
+            DropUnusedLevels(BudgetBytes - DroppedBytes, ResidentBytes, &ResidentTexture);
+        }
+
+        Loader.Reload(*ResidentTexture.Texture, ResidentTexture.FilePath);
+        ResidentTexture.IsReloading = true;
+        ResidentBytes += DroppedBytes;
+        ++Stats.ReloadsStarted;
+    }
+
+    if (BudgetBytes != 0)
+    {
+        DropUnusedLevels(BudgetBytes, ResidentBytes, nullptr);
+    }
+
+    for (XGResidentTexture& ResidentTexture : Textures)
+    {
+        ResidentTexture.LevelCount = ResidentTexture.Texture->GetLevelCount();
+        ResidentTexture.FirstResidentLevel = ResidentTexture.Texture->GetFirstResidentLevel();
+    }
+
+    Stats.TextureCount = static_cast<int>(Textures.size());
+    Stats.ReducedTextureCount = static_cast<int>(std::count_if(Textures.begin(), Textures.end(), [](const XGResidentTexture& ResidentTexture)
+    {
+        return ResidentTexture.Texture->GetFirstResidentLevel() > 0;
+    }));
+    Stats.ResidentBytes = ResidentBytes;
+    Stats.BudgetBytes = BudgetBytes;
+}
+
+bool XGTextureResidency::CanDropLevels(const XGResidentTexture& ResidentTexture)
+{
+    const XGTexture& Texture = *ResidentTexture.Texture;
+    return !ResidentTexture.IsReloading && Texture.GetVirtualTexture() == nullptr && Texture.GetFirstResidentLevel() + 1 < Texture.GetLevelCount();
+}
+
+size_t XGTextureResidency::GetUnusedBytes(const XGResidentTexture* ExcludedTexture) const
+{
+    size_t UnusedBytes = 0;
+    for (const XGResidentTexture& ResidentTexture : Textures)
+    {
+        if (&ResidentTexture == ExcludedTexture || !CanDropLevels(ResidentTexture))
+        {
+            continue;
+        }
+
+        const XGTexture& Texture = *ResidentTexture.Texture;
+        for (int Level = Texture.GetFirstResidentLevel(); Level + 1 < Texture.GetLevelCount() && ResidentTexture.LevelLastUsedFrames[Level] < FrameIndex; ++Level)
+        {
+            UnusedBytes += Texture.GetLevelMemoryUsage(Level);
+        }
+    }
+
+    return UnusedBytes;
+}
+
+bool XGTextureResidency::DropUnusedLevels(size_t TargetBytes, size_t& InOutResidentBytes, const XGResidentTexture* ExcludedTexture)
+{
+    while (InOutResidentBytes > TargetBytes)
+    {
+        // Find the finest remaining level, of any texture, that was used least recently
+        XGResidentTexture* LeastRecentTexture = nullptr;
+        uint32_t LeastRecentFrame = FrameIndex;
+        for (XGResidentTexture& ResidentTexture : Textures)
+        {
+            if (&ResidentTexture == ExcludedTexture || !CanDropLevels(ResidentTexture))
+            {
+                continue;
+            }
+
+            const int FirstResidentLevel = ResidentTexture.Texture->GetFirstResidentLevel();
+            if (ResidentTexture.LevelLastUsedFrames[FirstResidentLevel] < LeastRecentFrame)
+            {
+                LeastRecentTexture = &ResidentTexture;
+                LeastRecentFrame = ResidentTexture.LevelLastUsedFrames[FirstResidentLevel];
+            }
+        }
+
+        if (LeastRecentTexture == nullptr)
+        {
+            return false;
+        }
+
+        const size_t BytesBefore = LeastRecentTexture->Texture->GetMemoryUsage();
+        LeastRecentTexture->Texture->DropFineLevels(LeastRecentTexture->Texture->GetFirstResidentLevel() + 1);
+        InOutResidentBytes -= BytesBefore - LeastRecentTexture->Texture->GetMemoryUsage();
+        ++Stats.LevelsDropped;
+    }
+
+    return true;
+}
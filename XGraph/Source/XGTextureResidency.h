@@ -0,0 +1,137 @@
+﻿// XGTextureResidency.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "XGTexture.h"
+#include "XGTextureLoader.h"
+
+/**
+ * \brief What the texture residency manager saw and did during its last update
+ */
+struct XGTextureResidencyStats
+{
+    /**
+     * \brief The number of textures being managed, and how many of those have had their finest levels dropped
+     */
+    int TextureCount = 0;
+    int ReducedTextureCount = 0;
+
+    /**
+     * \brief The bytes held by the managed textures after the update, and the budget they were held to. A budget of
+     * zero is no budget.
+     */
+    size_t ResidentBytes = 0;
+    size_t BudgetBytes = 0;
+
+    /**
+     * \brief The number of levels dropped to stay within the budget during the update
+     */
+    int LevelsDropped = 0;
+
+    /**
+     * \brief The number of textures whose dropped levels were wanted again and are being reloaded from their files
+     */
+    int ReloadsStarted = 0;
+};
+
+/**
+ * \brief Keeps the textures of a scene within a memory budget by dropping the finest mip levels that haven't been
+ * sampled recently, and reloading textures whose dropped levels are wanted again
+ * \details Textures record which levels the renderer picked for them as it draws. Each update turns those into the last
+ * frame each level of each texture was used in. While the textures are over budget, the finest remaining level that
+ * was used least recently, across every texture, is dropped, which frees three quarters of that texture. Levels used
+ * during the last frame are never dropped, so a scene that needs more than the budget stays over it rather than
+ * dropping detail from what is on screen.
+ *
+ * When the renderer picks a level that has been dropped, the texture draws with its finest remaining level and is
+ * queued on the texture loader to be loaded again from its file, as long as the budget has room for its dropped levels,
+ * or can be made to by dropping levels that weren't used during the last frame. The texture keeps drawing as it is
+ * until the loader publishes the full texture.
+ */
+class XGTextureResidency
+{
+public:
+    /**
+     * \brief Starts managing a texture that was loaded from a file. The texture must stay alive until Clear is called.
+     */
+    void Register(XGTexture& Texture, const std::string& FilePath);
+
+    /**
+     * \brief Stops managing every texture
+     */
+    void Clear();
+
+    /**
+     * \brief Records the levels used since the last update, then drops or reloads levels to keep the textures within the
+     * budget. Call once per frame, between frames, after the loader has published its finished textures.
+     * \param BudgetBytes The most bytes the textures should hold together. Zero means no budget, so nothing is dropped.
+     */
+    void Update(XGTextureLoader& Loader, size_t BudgetBytes);
+
+    const XGTextureResidencyStats& GetStats() const { return Stats; }
+
+private:
+    struct XGResidentTexture
+    {
+        XGTexture* Texture;
+        std::string FilePath;
+
+        /**
+         * \brief The last update each level was used before
+         */
+        uint32_t LevelLastUsedFrames[XGTexture::MaxLevelCount];
+
+        /**
+         * \brief The level count and first resident level the texture had after the last update. When they change
+         * without the manager changing them, the loader has replaced the texture.
+         */
+        int LevelCount;
+        int FirstResidentLevel;
+
+        /**
+         * \brief Whether the texture has been queued to be loaded again and the loader hasn't finished with it
+         */
+        bool IsReloading;
+
+        /**
+         * \brief Cleared if reloading the texture failed, so it isn't tried every frame
+         */
+        bool CanReload;
+    };
+
+    std::vector<XGResidentTexture> Textures;
+
+    uint32_t FrameIndex = 0;
+
+    XGTextureResidencyStats Stats;
+
+    /**
+     * \brief Returns true if the levels of a texture can be dropped at all. A texture's last level never is, and neither
+     * are the levels of virtual textures, which manage their own memory, or of textures being reloaded, which are about
+     * to be replaced.
+     */
+    static bool CanDropLevels(const XGResidentTexture& ResidentTexture);
+
+    /**
+     * \brief Returns the bytes DropUnusedLevels could free, which are held by the levels finer than the finest level
+     * used during the last frame
+     */
+    size_t GetUnusedBytes(const XGResidentTexture* ExcludedTexture) const;
+
+    /**
+     * \brief Drops the least recently used levels that weren't used during the last frame until the textures hold no
+     * more than the target
+     * \param InOutResidentBytes The bytes held by the textures, which is reduced by the bytes freed
+     * \param ExcludedTexture A texture whose levels must not be dropped, or null
+     * \return True if the textures now hold no more than the target
+     */
+    bool DropUnusedLevels(size_t TargetBytes, size_t& InOutResidentBytes, const XGResidentTexture* ExcludedTexture);
+};
@@ -0,0 +1,59 @@
+﻿// XGTileLayout.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * \brief Maps pixel coordinates to offsets in a buffer that stores the pixels in 8x8 tiles
+ * \details The tiles are stored left to right, then top to bottom, and the pixels within a tile are stored row by row.
+ * A triangle that covers a few pixels on each of many rows touches one tile per eight rows instead of one cache line
+ * per row. Buffers are padded out to a whole number of tiles.
+ */
+struct XGTileLayout
+{
+    static constexpr int TileSizeShift = 3;
+    static constexpr int TileSize = 1 << TileSizeShift;
+    static constexpr int TileSizeMask = TileSize - 1;
+    static constexpr int TilePixelCount = TileSize * TileSize;
+
+    int Width = 0;
+    int Height = 0;
+    int TilesPerRow = 0;
+    int TileRowCount = 0;
+
+    void Resize(int NewWidth, int NewHeight)
+    {
+        Width = NewWidth;
+        Height = NewHeight;
+        TilesPerRow = (Width + TileSizeMask) >> TileSizeShift;
+        TileRowCount = (Height + TileSizeMask) >> TileSizeShift;
+    }
+
+    /**
+     * \brief The number of pixels in the buffer, including the padding in the last row and column of tiles
+     */
+    size_t GetPaddedPixelCount() const
+    {
+        return static_cast<size_t>(TilesPerRow) * static_cast<size_t>(TileRowCount) * TilePixelCount;
+    }
+
+    /**
+     * \brief The offset of the first pixel of row Y. Add GetColumnOffset(X) to it to find pixel (X, Y).
+     */
+    size_t GetRowOffset(int Y) const
+    {
+        return static_cast<size_t>(Y >> TileSizeShift) * static_cast<size_t>(TilesPerRow) * TilePixelCount +
+            static_cast<size_t>((Y & TileSizeMask) << TileSizeShift);
+    }
+
+    static size_t GetColumnOffset(int X)
+    {
+        return static_cast<size_t>(X >> TileSizeShift) * TilePixelCount + static_cast<size_t>(X & TileSizeMask);
+    }
+
+    size_t GetOffset(int X, int Y) const { return GetRowOffset(Y) + GetColumnOffset(X); }
+};
@@ -68,8 +68,6 @@ int XGTriangle::ClipAgainstPlane(
             return -1;
         }
 
-        OutTriangle1.Color = Color;
-
         // The inside point is valid, so keep that one
         OutTriangle1.Points[0] = *InsidePoints[0];
         OutTriangle1.TextureCoordinates[0] = *InsideTextureCoordinates[0];
@@ -116,9 +114,6 @@ int XGTriangle::ClipAgainstPlane(
             return -1;
         }
 
-        OutTriangle1.Color = Color;
-        OutTriangle2.Color = Color;
-
         // The first new triangle uses the two inside points and a new point where the first side of the triangle
         // intersects with the clipping plane
 
@@ -15,12 +15,10 @@ struct XGTriangle
 
     XGVector2D TextureCoordinates[3];
 
-    olc::Pixel Color;
-
-    XGTriangle() : Points{ XGVector3D(), XGVector3D(), XGVector3D() }, Color(olc::WHITE) {}
+    XGTriangle() : Points{ XGVector3D(), XGVector3D(), XGVector3D() } {}
     
     XGTriangle(const XGVector3D& Point1, const XGVector3D& Point2, const XGVector3D& Point3)
-        : Points{ Point1, Point2, Point3 }, Color(olc::WHITE) {}
+        : Points{ Point1, Point2, Point3 } {}
 
     XGTriangle(
         const XGVector3D& Point1,
@@ -30,8 +28,7 @@ struct XGTriangle
         const XGVector2D& TextureCoordinate2,
         const XGVector2D& TextureCoordinate3
     ) : Points{ Point1, Point2, Point3 },
-        TextureCoordinates{ TextureCoordinate1, TextureCoordinate2, TextureCoordinate3 },
-        Color(olc::WHITE) {}
+        TextureCoordinates{ TextureCoordinate1, TextureCoordinate2, TextureCoordinate3 } {}
 
     XGVector3D GetNormal() const;
 
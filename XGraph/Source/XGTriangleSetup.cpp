@@ -0,0 +1,74 @@
+﻿// XGTriangleSetup.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGTriangleSetup.h"
+
+#include <algorithm>
+
+bool XGTriangleSetup::Initialize(const XGScreenTriangle& Triangle)
+{
+    // Since we're drawing pixels, we use integer X and Y coordinates
+    const XGScreenVertex* Vertices[3] = { &Triangle.Vertices[0], &Triangle.Vertices[1], &Triangle.Vertices[2] };
+    for (int VertexIndex = 0; VertexIndex < 3; ++VertexIndex)
+    {
+        X[VertexIndex] = static_cast<int>(Vertices[VertexIndex]->X);
+        Y[VertexIndex] = static_cast<int>(Vertices[VertexIndex]->Y);
+    }
+
+    // Sort the vertices based on their Y position
+    const auto SwapVertices = [&](int Index1, int Index2)
+    {
+        std::swap(X[Index1], X[Index2]);
+        std::swap(Y[Index1], Y[Index2]);
+        std::swap(Vertices[Index1], Vertices[Index2]);
+    };
+
+    if (Y[1] < Y[0])
+    {
+        SwapVertices(0, 1);
+    }
+
+    if (Y[2] < Y[0])
+    {
+        SwapVertices(0, 2);
+    }
+
+    if (Y[2] < Y[1])
+    {
+        SwapVertices(1, 2);
+    }
+
+    const float DeltaX1 = static_cast<float>(X[1] - X[0]);
+    const float DeltaY1 = static_cast<float>(Y[1] - Y[0]);
+    const float DeltaX2 = static_cast<float>(X[2] - X[0]);
+    const float DeltaY2 = static_cast<float>(Y[2] - Y[0]);
+
+    const float Determinant = DeltaX1 * DeltaY2 - DeltaX2 * DeltaY1;
+    if (Determinant == 0.0f)
+    {
+        return false;
+    }
+
+    // Solve for the gradient of an attribute from its change along two of the triangle's edges
+    const float InverseDeterminant = 1.0f / Determinant;
+    const auto CalculateSteps = [&](float Value0, float Value1, float Value2, float& OutStepX, float& OutStepY)
+    {
+        const float DeltaValue1 = Value1 - Value0;
+        const float DeltaValue2 = Value2 - Value0;
+        OutStepX = (DeltaValue1 * DeltaY2 - DeltaValue2 * DeltaY1) * InverseDeterminant;
+        OutStepY = (DeltaX1 * DeltaValue2 - DeltaX2 * DeltaValue1) * InverseDeterminant;
+    };
+
+    InvW = Vertices[0]->InvW;
+    UOverW = Vertices[0]->UOverW;
+    VOverW = Vertices[0]->VOverW;
+    CalculateSteps(Vertices[0]->InvW, Vertices[1]->InvW, Vertices[2]->InvW, InvWStepX, InvWStepY);
+    CalculateSteps(Vertices[0]->UOverW, Vertices[1]->UOverW, Vertices[2]->UOverW, UOverWStepX, UOverWStepY);
+    CalculateSteps(Vertices[0]->VOverW, Vertices[1]->VOverW, Vertices[2]->VOverW, VOverWStepX, VOverWStepY);
+
+    Color = Triangle.Color;
+
+    return true;
+}
@@ -0,0 +1,98 @@
+﻿// XGTriangleSetup.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <utility>
+
+#include "XGScreenTriangle.h"
+
+/**
+ * \brief Everything the rasterizer needs to know about a triangle, calculated once before its pixels are filled
+ * \details The vertices are snapped to whole pixels and sorted from top to bottom. Because every attribute is divided
+ * by W, each one changes by a constant amount per pixel, so a span only needs its starting values and the steps along
+ * X. Sized and aligned to fill one cache line.
+ */
+struct alignas(64) XGTriangleSetup
+{
+    /**
+     * \brief The pixel coordinates of the vertices, sorted by Y
+     */
+    int X[3];
+    int Y[3];
+
+    /**
+     * \brief The attributes at the top vertex
+     */
+    float InvW;
+    float UOverW;
+    float VOverW;
+
+    /**
+     * \brief The amount each attribute changes per pixel to the right
+     */
+    float InvWStepX;
+    float UOverWStepX;
+    float VOverWStepX;
+
+    /**
+     * \brief The amount each attribute changes per row down
+     */
+    float InvWStepY;
+    float UOverWStepY;
+    float VOverWStepY;
+
+    olc::Pixel Color;
+
+    /**
+     * \brief Calculates the setup for the given triangle
+     * \return False if the triangle covers no area once snapped to pixels, in which case nothing should be drawn
+     */
+    bool Initialize(const XGScreenTriangle& Triangle);
+
+    /**
+     * \brief Calls Function(Y, StartX, EndX) for each row the triangle covers, with the first pixel of the row's span
+     * and the pixel just past its end. The row of the middle vertex is visited twice, once for each half.
+     */
+    template <typename SpanFunction>
+    void ForEachSpan(SpanFunction&& Function) const
+    {
+        // Line B runs from the top point to the bottom point. Line A runs from the top point to the middle point for
+        // the top half of the triangle, then from the middle point to the bottom point for the bottom half.
+        const float LineBStepX = Y[2] > Y[0] ? static_cast<float>(X[2] - X[0]) / static_cast<float>(Y[2] - Y[0]) : 0.0f;
+
+        for (int Half = 0; Half < 2; ++Half)
+        {
+            const int LineAStartX = X[Half];
+            const int LineAStartY = Y[Half];
+            const int LineAEndX = X[Half + 1];
+            const int LineAEndY = Y[Half + 1];
+
+            // Only draw this half of the triangle as long as Line A isn't flat
+            if (LineAEndY <= LineAStartY)
+            {
+                continue;
+            }
+
+            const float LineAStepX = static_cast<float>(LineAEndX - LineAStartX) / static_cast<float>(LineAEndY - LineAStartY);
+
+            for (int Row = LineAStartY; Row <= LineAEndY; ++Row)
+            {
+                int LineAX = LineAStartX + static_cast<int>(static_cast<float>(Row - LineAStartY) * LineAStepX);
+                int LineBX = X[0] + static_cast<int>(static_cast<float>(Row - Y[0]) * LineBStepX);
+
+                // Make sure we're always going from a smaller X value to a larger one
+                if (LineAX > LineBX)
+                {
+                    std::swap(LineAX, LineBX);
+                }
+
+                Function(Row, LineAX, LineBX);
+            }
+        }
+    }
+};
+
+static_assert(sizeof(XGTriangleSetup) == 64, "XGTriangleSetup should fill exactly one cache line");
@@ -0,0 +1,254 @@
+﻿// XGVertexCacheOptimizer.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGVertexCacheOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // The size of the least recently used cache that the scoring models, and the tuning values from Forsyth's article
+    constexpr int ModelCacheSize = 32;
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float LastTriangleScore = 0.75f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+
+    float GetVertexScore(int CachePosition, int RemainingValence)
+    {
+        // Vertices that no remaining triangle uses shouldn't attract anything
+        if (RemainingValence == 0)
+        {
+            return -1.0f;
+        }
+
+        float Score = 0.0f;
+        if (CachePosition >= 0)
+        {
+            if (CachePosition < 3)
+            {
+                // The vertices of the last triangle get a fixed score, so the next triangle doesn't just reuse the same
+                // edge over and over
+                Score = LastTriangleScore;
+            }
+            else
+            {
+                const float Scale = 1.0f / static_cast<float>(ModelCacheSize - 3);
+                Score = powf(1.0f - static_cast<float>(CachePosition - 3) * Scale, CacheDecayPower);
+            }
+        }
+
+        // Favour vertices with few triangles left, so they can be finished off and leave the cache for good
+        Score += ValenceBoostScale * powf(static_cast<float>(RemainingValence), -ValenceBoostPower);
+
+        return Score;
+    }
+}
+
+void XGVertexCacheOptimizer::OptimizeTriangleOrder(unsigned int* Indices, size_t TriangleCount)
+{
+    if (TriangleCount < 2)
+    {
+        return;
+    }
+
+    const size_t IndexCount = TriangleCount * 3;
+
+    // Give the vertices used by these triangles compact local indices
+    std::vector<unsigned int> UniqueVertices(Indices, Indices + IndexCount);
+    std::sort(UniqueVertices.begin(), UniqueVertices.end());
+    UniqueVertices.erase(std::unique(UniqueVertices.begin(), UniqueVertices.end()), UniqueVertices.end());
+    const size_t VertexCount = UniqueVertices.size();
+
+    std::vector<unsigned int> LocalIndices(IndexCount);
+    for (size_t i = 0; i < IndexCount; ++i)
+    {
+        LocalIndices[i] = static_cast<unsigned int>(
+            std::lower_bound(UniqueVertices.begin(), UniqueVertices.end(), Indices[i]) - UniqueVertices.begin()
+        );
+    }
+
+    // List the triangles that use each vertex. The first RemainingValence entries of a vertex's list are the triangles
+    // that haven't been emitted yet.
+    std::vector<int> RemainingValence(VertexCount, 0);
+    for (const unsigned int LocalIndex : LocalIndices)
+    {
+        RemainingValence[LocalIndex]++;
+    }
+
+    std::vector<size_t> AdjacencyOffsets(VertexCount + 1, 0);
+    for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        AdjacencyOffsets[Vertex + 1] = AdjacencyOffsets[Vertex] + RemainingValence[Vertex];
+    }
+
+    std::vector<unsigned int> AdjacentTriangles(IndexCount);
+    std::vector<size_t> AdjacencyCursors(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < IndexCount; ++i)
+    {
+        AdjacentTriangles[AdjacencyCursors[LocalIndices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<int> CachePositions(VertexCount, -1);
+    std::vector<float> VertexScores(VertexCount);
+    for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        VertexScores[Vertex] = GetVertexScore(-1, RemainingValence[Vertex]);
+    }
+
+    std::vector<float> TriangleScores(TriangleCount);
+    for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+    {
+        TriangleScores[Triangle] =
+            VertexScores[LocalIndices[Triangle * 3]] +
+            VertexScores[LocalIndices[Triangle * 3 + 1]] +
+            VertexScores[LocalIndices[Triangle * 3 + 2]];
+    }
+
+    std::vector<unsigned char> IsTriangleEmitted(TriangleCount, 0);
+    std::vector<unsigned int> OrderedIndices;
+    OrderedIndices.reserve(IndexCount);
+
+    // The modelled cache, with room for the three vertices of the newest triangle before older vertices fall out
+    int Cache[ModelCacheSize + 3];
+    int CacheCount = 0;
+
+    long long BestTriangle = -1;
+    for (size_t EmittedCount = 0; EmittedCount < TriangleCount; ++EmittedCount)
+    {
+        // When no triangle that touches the cache is left, start again from the best triangle anywhere
+        if (BestTriangle < 0)
+        {
+            float BestScore = -2.0f;
+            for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+            {
+                if (!IsTriangleEmitted[Triangle] && TriangleScores[Triangle] > BestScore)
+                {
+                    BestScore = TriangleScores[Triangle];
+                    BestTriangle = static_cast<long long>(Triangle);
+                }
+            }
+        }
+
+        const auto Triangle = static_cast<size_t>(BestTriangle);
+        IsTriangleEmitted[Triangle] = 1;
+
+        int NewCache[ModelCacheSize + 3];
+        int NewCacheCount = 0;
+
+        for (int Corner = 0; Corner < 3; ++Corner)
+        {
+            const unsigned int Vertex = LocalIndices[Triangle * 3 + Corner];
+            OrderedIndices.push_back(UniqueVertices[Vertex]);
+
+            // Remove the triangle from the vertex's list of remaining triangles
+            unsigned int* const Adjacency = &AdjacentTriangles[AdjacencyOffsets[Vertex]];
+            for (int i = 0; i < RemainingValence[Vertex]; ++i)
+            {
+                if (Adjacency[i] == Triangle)
+                {
+                    std::swap(Adjacency[i], Adjacency[RemainingValence[Vertex] - 1]);
+                    RemainingValence[Vertex]--;
+                    break;
+                }
+            }
+
+            // Degenerate triangles can use the same vertex twice, but it only takes one place in the cache
+            if (std::find(NewCache, NewCache + NewCacheCount, static_cast<int>(Vertex)) == NewCache + NewCacheCount)
+            {
+                NewCache[NewCacheCount++] = static_cast<int>(Vertex);
+            }
+        }
+
+        // Everything that was already in the cache moves back behind the new triangle's vertices
+        const int TriangleVertexCount = NewCacheCount;
+        for (int i = 0; i < CacheCount; ++i)
+        {
+            if (std::find(NewCache, NewCache + TriangleVertexCount, Cache[i]) == NewCache + TriangleVertexCount)
+            {
+                NewCache[NewCacheCount++] = Cache[i];
+            }
+        }
+
+        for (int i = 0; i < NewCacheCount; ++i)
+        {
+            CachePositions[NewCache[i]] = i < ModelCacheSize ? i : -1;
+        }
+
+        // Rescore every vertex whose position changed, including the ones that just fell out of the cache, and pass
+        // the change on to the triangles that still use it
+        for (int i = 0; i < NewCacheCount; ++i)
+        {
+            const int Vertex = NewCache[i];
+            const float NewScore = GetVertexScore(CachePositions[Vertex], RemainingValence[Vertex]);
+            const float ScoreChange = NewScore - VertexScores[Vertex];
+            VertexScores[Vertex] = NewScore;
+
+            const unsigned int* const Adjacency = &AdjacentTriangles[AdjacencyOffsets[Vertex]];
+            for (int j = 0; j < RemainingValence[Vertex]; ++j)
+            {
+                TriangleScores[Adjacency[j]] += ScoreChange;
+            }
+        }
+
+        CacheCount = std::min(NewCacheCount, ModelCacheSize);
+        for (int i = 0; i < CacheCount; ++i)
+        {
+            Cache[i] = NewCache[i];
+        }
+
+        // The next triangle is the best one that uses a vertex in the cache
+        BestTriangle = -1;
+        float BestScore = -2.0f;
+        for (int i = 0; i < CacheCount; ++i)
+        {
+            const int Vertex = Cache[i];
+            const unsigned int* const Adjacency = &AdjacentTriangles[AdjacencyOffsets[Vertex]];
+            for (int j = 0; j < RemainingValence[Vertex]; ++j)
+            {
+                if (TriangleScores[Adjacency[j]] > BestScore)
+                {
+                    BestScore = TriangleScores[Adjacency[j]];
+                    BestTriangle = Adjacency[j];
+                }
+            }
+        }
+    }
+
+    std::copy(OrderedIndices.begin(), OrderedIndices.end(), Indices);
+}
+
+size_t XGVertexCacheOptimizer::CountCacheMisses(const unsigned int* Indices, size_t TriangleCount)
+{
+    XGPostTransformCacheModel Cache;
+    for (size_t TriangleIndex = 0; TriangleIndex < TriangleCount; ++TriangleIndex)
+    {
+        Cache.AddTriangle(Indices + TriangleIndex * 3);
+    }
+
+    return Cache.GetMissCount();
+}
+
+void XGPostTransformCacheModel::Clear()
+{
+    std::fill(CachedIndices, CachedIndices + XGPostTransformCacheSize, 0xFFFFFFFF);
+    MissCount = 0;
+}
+
+void XGPostTransformCacheModel::AddTriangle(const unsigned int* TriangleIndices)
+{
+    // Model the engine's direct mapped cache
+    for (int i = 0; i < 3; ++i)
+    {
+        unsigned int& CachedIndex = CachedIndices[TriangleIndices[i] % XGPostTransformCacheSize];
+        if (CachedIndex != TriangleIndices[i])
+        {
+            CachedIndex = TriangleIndices[i];
+            MissCount++;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+﻿// XGVertexCacheOptimizer.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * \brief The number of transformed vertices the engine keeps while transforming a run of triangles
+ * \details The cache is direct mapped, so a vertex always lives in the slot given by its index modulo this size
+ */
+constexpr unsigned int XGPostTransformCacheSize = 64;
+
+/**
+ * \brief A model of the engine's post-transform cache that counts the vertices missing it as triangles are added
+ */
+class XGPostTransformCacheModel
+{
+public:
+    XGPostTransformCacheModel() { Clear(); }
+
+    /**
+     * \brief Empties the cache and sets the miss count back to zero
+     */
+    void Clear();
+
+    /**
+     * \brief Looks up the three vertices of a triangle, counting and caching the ones that aren't in the cache
+     */
+    void AddTriangle(const unsigned int* TriangleIndices);
+
+    size_t GetMissCount() const { return MissCount; }
+
+private:
+    unsigned int CachedIndices[XGPostTransformCacheSize];
+    size_t MissCount = 0;
+};
+
+/**
+ * \brief Reorders triangle indices so that vertices are reused while they are still in the post-transform cache
+ */
+struct XGVertexCacheOptimizer
+{
+    /**
+     * \brief Reorders triangles in place using Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+     * \details Every vertex gets a score based on how recently it was used and how many unprocessed triangles still
+     * use it. The triangle whose vertices have the highest combined score is emitted next.
+     * \param Indices Three vertex indices for every triangle
+     * \param TriangleCount The number of triangles
+     */
+    static void OptimizeTriangleOrder(unsigned int* Indices, size_t TriangleCount);
+
+    /**
+     * \brief Counts how many vertices the engine would have to transform for the given triangles, starting with an
+     * empty post-transform cache
+     * \param Indices Three vertex indices for every triangle
+     * \param TriangleCount The number of triangles
+     */
+    static size_t CountCacheMisses(const unsigned int* Indices, size_t TriangleCount);
+};
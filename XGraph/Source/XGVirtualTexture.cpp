@@ -0,0 +1,561 @@
+﻿// XGVirtualTexture.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#include "XGVirtualTexture.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+namespace
+{
+    constexpr uint32_t PageFileMagic = 0x54564758; // "XGVT"
+    constexpr uint32_t PageFileVersion = 1;
+
+    /**
+     * \brief The start of a page file. The pages follow it, level by level from the largest, and row by row within
+     * each level.
+     */
+    struct XGPageFileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t PageSize;
+        uint32_t LevelCount;
+    };
+
+    bool IsPowerOfTwo(uint32_t Value)
+    {
+        return Value != 0 && (Value & (Value - 1)) == 0;
+    }
+
+    /**
+     * \brief Counts the levels of a mip chain, each half the size of the one before, down to a single texel
+     */
+    uint32_t CountLevels(uint32_t Width, uint32_t Height)
+    {
+        uint32_t LevelCount = 1;
+        while (Width > 1 || Height > 1)
+        {
+            Width = std::max(1u, Width / 2);
+            Height = std::max(1u, Height / 2);
+            ++LevelCount;
+        }
+
+        return LevelCount;
+    }
+}
+
+XGVirtualTexture::~XGVirtualTexture()
+{
+    Close();
+}
+
+bool XGVirtualTexture::IsPageFilePath(const std::string& FilePath)
+{
+    const std::string Extension = ".xgvt";
+    if (FilePath.size() < Extension.size())
+    {
+        return false;
+    }
+
+    return std::equal(Extension.begin(), Extension.end(), FilePath.end() - Extension.size(), [](char Expected, char Actual)
+    {
+        return Expected == std::tolower(static_cast<unsigned char>(Actual));
+    });
+}
+
+bool XGVirtualTexture::WritePageFile(const olc::Sprite& Sprite, const std::string& PageFilePath)
+{
+    if (!IsPowerOfTwo(static_cast<uint32_t>(Sprite.width)) || !IsPowerOfTwo(static_cast<uint32_t>(Sprite.height)))
+    {
+        std::cout << "ERROR: Virtual textures must have power of two sides: " << PageFilePath << std::endl;
+        return false;
+    }
+
+    std::ofstream File(PageFilePath, std::ios::binary);
+    if (!File)
+    {
+        return false;
+    }
+
+    const XGPageFileHeader Header = {
+        PageFileMagic,
+        PageFileVersion,
+        static_cast<uint32_t>(Sprite.width),
+        static_cast<uint32_t>(Sprite.height),
+        static_cast<uint32_t>(PageSize),
+        CountLevels(static_cast<uint32_t>(Sprite.width), static_cast<uint32_t>(Sprite.height))
+    };
+    File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+
+    // The first level is read straight from the sprite, and each level after it is built from the one before and then
+    // replaces it, so the whole chain is never in memory at once
+    const olc::Pixel* LevelTexels = Sprite.pColData.data();
+    std::vector<olc::Pixel> CurrentLevel;
+    std::vector<olc::Pixel> NextLevel;
+    std::vector<olc::Pixel> Page(StoredPageTexelCount);
+    int Width = Sprite.width;
+    int Height = Sprite.height;
+    for (uint32_t Level = 0; Level < Header.LevelCount; ++Level)
+    {
+        // The extra column and row of each page come from the next page over, wrapping around at the edges of the
+        // level. Pages of levels smaller than a page repeat the level to fill themselves.
+        const int PagesPerRow = (Width + PageSizeMask) >> PageSizeShift;
+        const int PageRowCount = (Height + PageSizeMask) >> PageSizeShift;
+        for (int PageY = 0; PageY < PageRowCount; ++PageY)
+        {
+            for (int PageX = 0; PageX < PagesPerRow; ++PageX)
+            {
+                for (int Y = 0; Y < StoredPageSize; ++Y)
+                {
+                    const size_t SourceRow = static_cast<size_t>(((PageY << PageSizeShift) + Y) & (Height - 1)) * static_cast<size_t>(Width);
+                    for (int X = 0; X < StoredPageSize; ++X)
+                    {
+                        Page[static_cast<size_t>(Y) * StoredPageSize + static_cast<size_t>(X)] =
+                            LevelTexels[SourceRow + static_cast<size_t>(((PageX << PageSizeShift) + X) & (Width - 1))];
+                    }
+                }
+
+                File.write(reinterpret_cast<const char*>(Page.data()), static_cast<std::streamsize>(StoredPageTexelCount * sizeof(olc::Pixel)));
+            }
+        }
+
+        if (Width == 1 && Height == 1)
+        {
+            break;
+        }
+
+        // Each texel of the next level is the average of the 2x2 texels it covers in this one, as in XGTexture. When
+        // one side has already reached a single texel, its row or column is shared rather than read past.
+        const int NextWidth = std::max(1, Width / 2);
+        const int NextHeight = std::max(1, Height / 2);
+        NextLevel.resize(static_cast<size_t>(NextWidth) * static_cast<size_t>(NextHeight));
+        for (int Y = 0; Y < NextHeight; ++Y)
+        {
+            const size_t SourceRow0 = static_cast<size_t>(std::min(Y * 2, Height - 1)) * static_cast<size_t>(Width);
+            const size_t SourceRow1 = static_cast<size_t>(std::min(Y * 2 + 1, Height - 1)) * static_cast<size_t>(Width);
+            for (int X = 0; X < NextWidth; ++X)
+            {
+                const size_t SourceX0 = static_cast<size_t>(std::min(X * 2, Width - 1));
+                const size_t SourceX1 = static_cast<size_t>(std::min(X * 2 + 1, Width - 1));
+                const olc::Pixel& Texel00 = LevelTexels[SourceRow0 + SourceX0];
+                const olc::Pixel& Texel10 = LevelTexels[SourceRow0 + SourceX1];
+                const olc::Pixel& Texel01 = LevelTexels[SourceRow1 + SourceX0];
+                const olc::Pixel& Texel11 = LevelTexels[SourceRow1 + SourceX1];
+
+                NextLevel[static_cast<size_t>(Y) * static_cast<size_t>(NextWidth) + static_cast<size_t>(X)] = olc::Pixel(
+                    static_cast<uint8_t>((Texel00.r + Texel10.r + Texel01.r + Texel11.r + 2) / 4),
+                    static_cast<uint8_t>((Texel00.g + Texel10.g + Texel01.g + Texel11.g + 2) / 4),
+                    static_cast<uint8_t>((Texel00.b + Texel10.b + Texel01.b + Texel11.b + 2) / 4),
+                    static_cast<uint8_t>((Texel00.a + Texel10.a + Texel01.a + Texel11.a + 2) / 4)
+                );
+            }
+        }
+
+        CurrentLevel.swap(NextLevel);
+        LevelTexels = CurrentLevel.data();
+        Width = NextWidth;
+        Height = NextHeight;
+    }
+
+    return static_cast<bool>(File);
+}
+
+bool XGVirtualTexture::Open(const std::string& FilePath, int NewPhysicalPageCount)
+{
+    Close();
+
+    std::ifstream File(FilePath, std::ios::binary);
+    XGPageFileHeader Header;
+    if (!File.read(reinterpret_cast<char*>(&Header), sizeof(Header)) || Header.Magic != PageFileMagic ||
+        Header.Version != PageFileVersion || Header.PageSize != static_cast<uint32_t>(PageSize) ||
+        !IsPowerOfTwo(Header.Width) || !IsPowerOfTwo(Header.Height) || Header.LevelCount != CountLevels(Header.Width, Header.Height))
+    {
+        return false;
+    }
+
+    // Work out where each level's pages start, and which levels fit in a single page
+    uint32_t PageCount = 0;
+    int SinglePageLevelCount = 0;
+    int Width = static_cast<int>(Header.Width);
+    int Height = static_cast<int>(Header.Height);
+    for (uint32_t Level = 0; Level < Header.LevelCount; ++Level)
+    {
+        const int PagesPerRow = (Width + PageSizeMask) >> PageSizeShift;
+        const int PageRowCount = (Height + PageSizeMask) >> PageSizeShift;
+        Levels.push_back({
+            Width,
+            Height,
+            PagesPerRow,
+            PageRowCount,
+            static_cast<float>(Width << SubTexelShift),
+            static_cast<float>(Height << SubTexelShift),
+            PageCount
+        });
+        PageCount += static_cast<uint32_t>(PagesPerRow) * static_cast<uint32_t>(PageRowCount);
+        if (PagesPerRow == 1 && PageRowCount == 1)
+        {
+            ++SinglePageLevelCount;
+        }
+
+        Width = std::max(1, Width / 2);
+        Height = std::max(1, Height / 2);
+    }
+
+    PhysicalPageCount = std::max(1, NewPhysicalPageCount);
+    const size_t SlotCount = static_cast<size_t>(PhysicalPageCount) + static_cast<size_t>(SinglePageLevelCount);
+    PageTable.assign(PageCount, static_cast<int32_t>(NotResidentPage));
+    PageRequestFrames.assign(PageCount, 0);
+    PageRequests.reserve(MaxPageRequestsPerFrame);
+    PhysicalTexels.assign(SlotCount * StoredPageTexelCount, olc::BLANK);
+    SlotStates.assign(SlotCount, FreeSlot);
+    SlotPages.assign(SlotCount, 0);
+    SlotLastUsedFrames.assign(SlotCount, 0);
+
+    // A slot is only ever loading one page, so the loads in flight never outnumber the slots
+    QueuedLoads.reserve(static_cast<size_t>(PhysicalPageCount));
+    FinishedLoads.reserve(static_cast<size_t>(PhysicalPageCount));
+    PublishingLoads.reserve(static_cast<size_t>(PhysicalPageCount));
+
+    // Pin the single page levels after the slots that pages come and go from
+    int32_t Slot = PhysicalPageCount;
+    for (const XGPageLevel& Level : Levels)
+    {
+        if (Level.PagesPerRow != 1 || Level.PageRowCount != 1)
+        {
+            continue;
+        }
+
+        if (!ReadPage(File, Level.FirstPage, PhysicalTexels.data() + static_cast<size_t>(Slot) * StoredPageTexelCount))
+        {
+            Close();
+            return false;
+        }
+
+        PageTable[Level.FirstPage] = Slot;
+        SlotStates[Slot] = PinnedSlot;
+        SlotPages[Slot] = Level.FirstPage;
+        ++Slot;
+    }
+
+    // Frame zero is what every page was last requested in, so counting starts from one
+    FrameIndex = 1;
+    Stats = XGVirtualTextureStats();
+    Stats.ResidentPageCount = SinglePageLevelCount;
+
+    PageFilePath = FilePath;
+    IsStopping = false;
+    Worker = std::thread(&XGVirtualTexture::LoadQueuedPages, this);
+    return true;
+}
+
+void XGVirtualTexture::Close()
+{
+    if (Worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            IsStopping = true;
+        }
+        LoadQueued.notify_one();
+        Worker.join();
+    }
+
+    QueuedLoads.clear();
+    FinishedLoads.clear();
+    PublishingLoads.clear();
+
+    Levels.clear();
+    std::vector<int32_t>().swap(PageTable);
+    std::vector<uint32_t>().swap(PageRequestFrames);
+    std::vector<uint32_t>().swap(PageRequests);
+    std::vector<olc::Pixel>().swap(PhysicalTexels);
+    std::vector<XGPageSlotState>().swap(SlotStates);
+    std::vector<uint32_t>().swap(SlotPages);
+    std::vector<uint32_t>().swap(SlotLastUsedFrames);
+    PhysicalPageCount = 0;
+}
+
+size_t XGVirtualTexture::GetMemoryUsage() const
+{
+    return Levels.capacity() * sizeof(XGPageLevel) + PageTable.capacity() * sizeof(int32_t) +
+        PageRequestFrames.capacity() * sizeof(uint32_t) + PageRequests.capacity() * sizeof(uint32_t) +
+        PhysicalTexels.capacity() * sizeof(olc::Pixel) + SlotStates.capacity() * sizeof(XGPageSlotState) +
+        SlotPages.capacity() * sizeof(uint32_t) + SlotLastUsedFrames.capacity() * sizeof(uint32_t) +
+        (QueuedLoads.capacity() + FinishedLoads.capacity() + PublishingLoads.capacity()) * sizeof(XGPageLoad);
+}
+
+void XGVirtualTexture::Update()
+{
+    if (Levels.empty())
+    {
+        return;
+    }
+
+    Stats.PagesRequested = static_cast<int>(PageRequests.size());
+    Stats.PagesLoaded = 0;
+    Stats.PagesEvicted = 0;
+
+    // Publish the pages the worker has finished. Their slots were set aside when the loads were queued, so nothing
+    // sampled from them in the meantime.
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        PublishingLoads.swap(FinishedLoads);
+    }
+
+    for (const XGPageLoad& Load : PublishingLoads)
+    {
+        if (Load.HasSucceeded)
+        {
+            PageTable[Load.Page] = Load.Slot;
+            SlotStates[Load.Slot] = ResidentSlot;
+            SlotLastUsedFrames[Load.Slot] = FrameIndex;
+            ++Stats.PagesLoaded;
+        }
+        else
+        {
+            std::cout << "ERROR: Failed to read page " << Load.Page << " of virtual texture: " << PageFilePath << std::endl;
+            PageTable[Load.Page] = NotResidentPage;
+            SlotStates[Load.Slot] = FreeSlot;
+        }
+    }
+    PublishingLoads.clear();
+
+    // Pages are numbered from the largest level, so the highest numbers are the coarsest pages. Loading those first
+    // means a new view sharpens a level at a time rather than leaving some areas blurry for longer than others.
+    std::sort(PageRequests.begin(), PageRequests.end(), std::greater<uint32_t>());
+
+    XGPageLoad NewLoads[MaxPageLoadsPerUpdate];
+    int NewLoadCount = 0;
+    for (const uint32_t Page : PageRequests)
+    {
+        if (NewLoadCount == MaxPageLoadsPerUpdate)
+        {
+            break;
+        }
+
+        if (PageTable[Page] != NotResidentPage)
+        {
+            continue;
+        }
+
+        const int32_t Slot = FindSlotToLoadInto();
+        if (Slot < 0)
+        {
+            // Every slot is loading or was sampled during the last frame
+            break;
+        }
+
+        if (SlotStates[Slot] == ResidentSlot)
+        {
+            PageTable[SlotPages[Slot]] = NotResidentPage;
+            ++Stats.PagesEvicted;
+        }
+
+        PageTable[Page] = LoadingPage;
+        SlotStates[Slot] = LoadingSlot;
+        SlotPages[Slot] = Page;
+        NewLoads[NewLoadCount++] = { Page, Slot, false };
+    }
+    PageRequests.clear();
+
+    if (NewLoadCount > 0)
+    {
+        // The worker takes loads from the back of the queue, so the coarsest pages go in last
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            for (int LoadIndex = NewLoadCount - 1; LoadIndex >= 0; --LoadIndex)
+            {
+                QueuedLoads.push_back(NewLoads[LoadIndex]);
+            }
+        }
+        LoadQueued.notify_one();
+    }
+
+    Stats.ResidentPageCount = 0;
+    Stats.LoadingPageCount = 0;
+    for (const XGPageSlotState State : SlotStates)
+    {
+        Stats.ResidentPageCount += State == ResidentSlot || State == PinnedSlot ? 1 : 0;
+        Stats.LoadingPageCount += State == LoadingSlot ? 1 : 0;
+    }
+
+    ++FrameIndex;
+}
+
+void XGVirtualTexture::LoadQueuedPages()
+{
+    std::ifstream File(PageFilePath, std::ios::binary);
+
+    std::unique_lock<std::mutex> Lock(Mutex);
+    while (true)
+    {
+        LoadQueued.wait(Lock, [this]() { return IsStopping || !QueuedLoads.empty(); });
+        if (IsStopping)
+        {
+            return;
+        }
+
+        XGPageLoad Load = QueuedLoads.back();
+        QueuedLoads.pop_back();
+
+        // The slot belongs to this load until it is published, so its texels can be written without the lock
+        Lock.unlock();
+        Load.HasSucceeded = ReadPage(File, Load.Page, PhysicalTexels.data() + static_cast<size_t>(Load.Slot) * StoredPageTexelCount);
+        Lock.lock();
+
+        FinishedLoads.push_back(Load);
+    }
+}
+
+bool XGVirtualTexture::ReadPage(std::istream& File, uint32_t Page, olc::Pixel* OutTexels)
+{
+    constexpr std::streamoff PageBytes = static_cast<std::streamoff>(StoredPageTexelCount * sizeof(olc::Pixel));
+    File.clear();
+    File.seekg(static_cast<std::streamoff>(sizeof(XGPageFileHeader)) + static_cast<std::streamoff>(Page) * PageBytes);
+    return static_cast<bool>(File.read(reinterpret_cast<char*>(OutTexels), PageBytes));
+}
+
+int32_t XGVirtualTexture::FindSlotToLoadInto() const
+{
+    int32_t LeastRecentSlot = -1;
+    for (int32_t Slot = 0; Slot < PhysicalPageCount; ++Slot)
+    {
+        if (SlotStates[Slot] == FreeSlot)
+        {
+            return Slot;
+        }
+
+        if (SlotStates[Slot] == ResidentSlot && SlotLastUsedFrames[Slot] != FrameIndex &&
+            (LeastRecentSlot < 0 || SlotLastUsedFrames[Slot] < SlotLastUsedFrames[LeastRecentSlot]))
+        {
+            LeastRecentSlot = Slot;
+        }
+    }
+
+    return LeastRecentSlot;
+}
+
+const olc::Pixel* XGVirtualTexture::FindResidentTexel(int& InOutLevel, float U, float V, int HalfTexel, int& OutFixedX, int& OutFixedY) const
+{
+    // Every level repeats, so only the fraction of each coordinate matters. Dropping the rest first keeps coordinates far
+    // outside the texture from overflowing when they're scaled to fixed-point texels.
+    U -= XGTexture::FloorCoordinate(U);
+    V -= XGTexture::FloorCoordinate(V);
+
+    // Always ends, since the single page levels are always resident
+    while (true)
+    {
+        const XGPageLevel& Level = Levels[InOutLevel];
+        OutFixedX = static_cast<int>(U * Level.FixedTexelsPerU) - HalfTexel;
+        OutFixedY = static_cast<int>(V * Level.FixedTexelsPerV) - HalfTexel;
+
+        // Every level's sides are powers of two, so wrapping is a mask
+        const int X = (OutFixedX >> SubTexelShift) & (Level.Width - 1);
+        const int Y = (OutFixedY >> SubTexelShift) & (Level.Height - 1);
+        const uint32_t Page = Level.FirstPage + static_cast<uint32_t>((Y >> PageSizeShift) * Level.PagesPerRow + (X >> PageSizeShift));
+        const int32_t Slot = PageTable[Page];
+        if (Slot >= 0)
+        {
+            SlotLastUsedFrames[Slot] = FrameIndex;
+            return PhysicalTexels.data() + static_cast<size_t>(Slot) * StoredPageTexelCount +
+                static_cast<size_t>((Y & PageSizeMask) * StoredPageSize + (X & PageSizeMask));
+        }
+
+        if (Slot == NotResidentPage && PageRequestFrames[Page] != FrameIndex && PageRequests.size() < MaxPageRequestsPerFrame)
+        {
+            PageRequestFrames[Page] = FrameIndex;
+            PageRequests.push_back(Page);
+        }
+
+        ++InOutLevel;
+    }
+}
+
+olc::Pixel XGVirtualTexture::Sample(XGTextureFilter Filter, float LevelOfDetail, float U, float V) const
+{
+    switch (Filter)
+    {
+    case BilinearFilter:
+        return SampleBilinear(static_cast<int>(LevelOfDetail + 0.5f), U, V);
+    case TrilinearFilter:
+        return SampleTrilinear(LevelOfDetail, U, V);
+    default:
+        return SampleNearest(static_cast<int>(LevelOfDetail + 0.5f), U, V);
+    }
+}
+
+void XGVirtualTexture::SampleBatch(XGTextureFilter Filter, float LevelOfDetail, const float* U, const float* V, int Count, olc::Pixel* OutColors) const
+{
+    for (int Index = 0; Index < Count; ++Index)
+    {
+        OutColors[Index] = Sample(Filter, LevelOfDetail, U[Index], V[Index]);
+    }
+}
+
+olc::Pixel XGVirtualTexture::SampleNearest(int Level, float U, float V) const
+{
+    int FixedX;
+    int FixedY;
+    return *FindResidentTexel(Level, U, V, 0, FixedX, FixedY);
+}
+
+olc::Pixel XGVirtualTexture::SampleBilinear(int Level, float U, float V) const
+{
+    // Texel centres are half a texel in from their edges. The right and bottom neighbours of every texel in a page are
+    // stored in the page, so the four texels are always together.
+    int FixedX;
+    int FixedY;
+    const olc::Pixel* Texel = FindResidentTexel(Level, U, V, 1 << (SubTexelShift - 1), FixedX, FixedY);
+    const int WeightX = (FixedX & SubTexelMask) >> (SubTexelShift - BilinearWeightShift);
+    const int WeightY = (FixedY & SubTexelMask) >> (SubTexelShift - BilinearWeightShift);
+
+    const olc::Pixel& Texel00 = Texel[0];
+    const olc::Pixel& Texel10 = Texel[1];
+    const olc::Pixel& Texel01 = Texel[StoredPageSize];
+    const olc::Pixel& Texel11 = Texel[StoredPageSize + 1];
+
+    // The four weights add up to 1 << (BilinearWeightShift * 2)
+    constexpr int One = 1 << BilinearWeightShift;
+    constexpr int WeightShift = BilinearWeightShift * 2;
+    constexpr int Rounding = 1 << (WeightShift - 1);
+    const int Weight00 = (One - WeightX) * (One - WeightY);
+    const int Weight10 = WeightX * (One - WeightY);
+    const int Weight01 = (One - WeightX) * WeightY;
+    const int Weight11 = WeightX * WeightY;
+
+    return olc::Pixel(
+        static_cast<uint8_t>((Texel00.r * Weight00 + Texel10.r * Weight10 + Texel01.r * Weight01 + Texel11.r * Weight11 + Rounding) >> WeightShift),
+        static_cast<uint8_t>((Texel00.g * Weight00 + Texel10.g * Weight10 + Texel01.g * Weight01 + Texel11.g * Weight11 + Rounding) >> WeightShift),
+        static_cast<uint8_t>((Texel00.b * Weight00 + Texel10.b * Weight10 + Texel01.b * Weight01 + Texel11.b * Weight11 + Rounding) >> WeightShift),
+        static_cast<uint8_t>((Texel00.a * Weight00 + Texel10.a * Weight10 + Texel01.a * Weight01 + Texel11.a * Weight11 + Rounding) >> WeightShift)
+    );
+}
+
+olc::Pixel XGVirtualTexture::SampleTrilinear(float LevelOfDetail, float U, float V) const
+{
+    const int FinerLevel = static_cast<int>(LevelOfDetail);
+    const int CoarserWeight = static_cast<int>((LevelOfDetail - static_cast<float>(FinerLevel)) * (1 << SubTexelShift));
+    const olc::Pixel Finer = SampleBilinear(FinerLevel, U, V);
+    if (CoarserWeight <= 0 || FinerLevel + 1 >= GetLevelCount())
+    {
+        return Finer;
+    }
+
+    const olc::Pixel Coarser = SampleBilinear(FinerLevel + 1, U, V);
+    const int FinerWeight = (1 << SubTexelShift) - CoarserWeight;
+    constexpr int Rounding = 1 << (SubTexelShift - 1);
+    return olc::Pixel(
+        static_cast<uint8_t>((Finer.r * FinerWeight + Coarser.r * CoarserWeight + Rounding) >> SubTexelShift),
+        static_cast<uint8_t>((Finer.g * FinerWeight + Coarser.g * CoarserWeight + Rounding) >> SubTexelShift),
+        static_cast<uint8_t>((Finer.b * FinerWeight + Coarser.b * CoarserWeight + Rounding) >> SubTexelShift),
+        static_cast<uint8_t>((Finer.a * FinerWeight + Coarser.a * CoarserWeight + Rounding) >> SubTexelShift)
+    );
+}
@@ -0,0 +1,286 @@
+﻿// XGVirtualTexture.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ThirdParty/olcPixelGameEngine.h"
+#include "XGTexture.h"
+
+/**
+ * \brief Counts of what a virtual texture's page cache did during the last frame
+ */
+struct XGVirtualTextureStats
+{
+    /**
+     * \brief The number of pages in the physical page cache, and how many slots are waiting for a page to load
+     */
+    int ResidentPageCount = 0;
+    int LoadingPageCount = 0;
+
+    /**
+     * \brief The number of pages that were sampled during the last frame without being resident
+     */
+    int PagesRequested = 0;
+
+    /**
+     * \brief The number of pages that finished loading, and the number evicted to make room for new loads, during the
+     * last update
+     */
+    int PagesLoaded = 0;
+    int PagesEvicted = 0;
+};
+
+/**
+ * \brief A texture too large to keep in memory, read on demand from a page file of square pages covering every mip level
+ * \details Only a fixed number of pages, the physical page cache, are in memory at once. A page table maps each page
+ * of each level to its slot in the cache. When a sample lands on a page that isn't resident, the page is recorded as
+ * requested and the sample falls back to the same spot in the next coarser level, repeating until it finds a resident
+ * page. The levels small enough to fit in a single page are loaded when the texture is opened and never evicted, so
+ * there is always somewhere to fall back to.
+ *
+ * Update, called once per frame, hands the pages requested during the last frame to a worker thread, coarsest first,
+ * evicting the least recently sampled pages to make room. Pages the worker has finished reading are published to the
+ * page table at the next update, so the page table and the cache are only ever changed between frames, on the thread
+ * that samples the texture.
+ *
+ * Each page is stored with one extra column and row, copied from the next page over, so a bilinear sample never needs
+ * texels from a second page. The extra texels wrap around at the edges of each level, so virtual textures always repeat.
+ */
+class XGVirtualTexture
+{
+public:
+    /**
+     * \brief The number of texels along each side of a page
+     */
+    static constexpr int PageSizeShift = 7;
+    static constexpr int PageSize = 1 << PageSizeShift;
+
+    /**
+     * \brief The number of pages the physical page cache holds when the size isn't given to Open, which is 16MB of texels
+     */
+    static constexpr int DefaultPhysicalPageCount = 256;
+
+    /**
+     * \brief The most pages Update hands to the worker thread at once, so a sudden jump in view doesn't evict the whole
+     * cache for pages that may no longer be needed by the time they load
+     */
+    static constexpr int MaxPageLoadsPerUpdate = 32;
+
+    /**
+     * \brief The most page requests recorded in a frame. Requests past this are dropped, and made again next frame.
+     */
+    static constexpr int MaxPageRequestsPerFrame = 1024;
+
+    XGVirtualTexture() = default;
+    ~XGVirtualTexture();
+
+    XGVirtualTexture(const XGVirtualTexture&) = delete;
+    XGVirtualTexture& operator=(const XGVirtualTexture&) = delete;
+
+    /**
+     * \brief Returns true if the file at the given path should be opened as a page file, going by its extension
+     */
+    static bool IsPageFilePath(const std::string& FilePath);
+
+    /**
+     * \brief Builds the mip chain of a sprite and writes it to a page file
+     * \details The levels are built one at a time, each from the one before, so the chain is never in memory all at once.
+     * Running XGraph with --make-page-file <image> <page file> converts an image with this.
+     * \return False if the sprite's sides aren't powers of two, or the file couldn't be written
+     */
+    static bool WritePageFile(const olc::Sprite& Sprite, const std::string& PageFilePath);
+
+    /**
+     * \brief Opens a page file, loads the levels that fit in a single page and starts the worker thread
+     * \param NewPhysicalPageCount The number of pages that can be resident at once, on top of the single page levels
+     * \return False if the file couldn't be read or isn't a page file
+     */
+    bool Open(const std::string& FilePath, int NewPhysicalPageCount = DefaultPhysicalPageCount);
+
+    /**
+     * \brief Stops the worker thread and releases every page
+     */
+    void Close();
+
+    int GetLevelCount() const { return static_cast<int>(Levels.size()); }
+    int GetWidth(int Level = 0) const { return Levels[Level].Width; }
+    int GetHeight(int Level = 0) const { return Levels[Level].Height; }
+
+    size_t GetMemoryUsage() const;
+
+    const XGVirtualTextureStats& GetStats() const { return Stats; }
+
+    /**
+     * \brief Publishes the pages that finished loading and starts loading the pages requested since the last update.
+     * Call once per frame, before anything samples the texture.
+     */
+    void Update();
+
+    /**
+     * \brief Samples the texture like XGTexture::Sample, falling back to coarser levels where pages aren't resident
+     */
+    olc::Pixel Sample(XGTextureFilter Filter, float LevelOfDetail, float U, float V) const;
+
+    /**
+     * \brief Samples the texture at several texture coordinates with the same filter and level of detail
+     */
+    void SampleBatch(XGTextureFilter Filter, float LevelOfDetail, const float* U, const float* V, int Count, olc::Pixel* OutColors) const;
+
+private:
+    static constexpr int PageSizeMask = PageSize - 1;
+
+    /**
+     * \brief The number of texels along each side of a page as it is stored, including the extra column and row
+     */
+    static constexpr int StoredPageSize = PageSize + 1;
+    static constexpr size_t StoredPageTexelCount = static_cast<size_t>(StoredPageSize) * static_cast<size_t>(StoredPageSize);
+
+    /**
+     * \brief Sampling uses the same fixed-point texel coordinates and bilinear weights as XGTexture
+     */
+    static constexpr int SubTexelShift = 8;
+    static constexpr int SubTexelMask = (1 << SubTexelShift) - 1;
+    static constexpr int BilinearWeightShift = 7;
+
+    /**
+     * \brief Page table entries for pages that aren't in the cache, and for pages the worker thread is reading
+     */
+    static constexpr int32_t NotResidentPage = -1;
+    static constexpr int32_t LoadingPage = -2;
+
+    struct XGPageLevel
+    {
+        int Width;
+        int Height;
+        int PagesPerRow;
+        int PageRowCount;
+
+        /**
+         * \brief The factors to convert texture coordinates to fixed-point texel coordinates in this level
+         */
+        float FixedTexelsPerU;
+        float FixedTexelsPerV;
+
+        /**
+         * \brief The index of the level's first page in the page file and the page table
+         */
+        uint32_t FirstPage;
+    };
+
+    enum XGPageSlotState : uint8_t
+    {
+        FreeSlot,
+        LoadingSlot,
+        ResidentSlot,
+
+        /**
+         * \brief Holds a level that fits in a single page, and is never evicted
+         */
+        PinnedSlot
+    };
+
+    struct XGPageLoad
+    {
+        uint32_t Page;
+        int32_t Slot;
+        bool HasSucceeded;
+    };
+
+    std::string PageFilePath;
+
+    std::vector<XGPageLevel> Levels;
+
+    /**
+     * \brief The slot holding each page, or NotResidentPage or LoadingPage
+     */
+    std::vector<int32_t> PageTable;
+
+    /**
+     * \brief The frame each page was last requested in, so each page is only requested once per frame
+     */
+    mutable std::vector<uint32_t> PageRequestFrames;
+
+    /**
+     * \brief The pages requested during the current frame
+     */
+    mutable std::vector<uint32_t> PageRequests;
+
+    /**
+     * \brief The texels of every slot of the physical page cache, StoredPageTexelCount per slot. The single page levels
+     * are in the slots after the first PhysicalPageCount.
+     */
+    std::vector<olc::Pixel> PhysicalTexels;
+
+    int PhysicalPageCount = 0;
+
+    std::vector<XGPageSlotState> SlotStates;
+
+    /**
+     * \brief The page in each slot, and the last frame it was sampled in
+     */
+    std::vector<uint32_t> SlotPages;
+    mutable std::vector<uint32_t> SlotLastUsedFrames;
+
+    uint32_t FrameIndex = 0;
+
+    XGVirtualTextureStats Stats;
+
+    /**
+     * \brief Loads finished by the worker thread, swapped out under the lock at each update so they can be published
+     * without holding it
+     */
+    std::vector<XGPageLoad> PublishingLoads;
+
+    /**
+     * \brief The worker thread, and everything it shares with the thread calling Update. Everything below is guarded by
+     * Mutex, except the texels of slots that are loading, which belong to the worker until their load is published.
+     */
+    std::thread Worker;
+    std::mutex Mutex;
+    std::condition_variable LoadQueued;
+    std::vector<XGPageLoad> QueuedLoads;
+    std::vector<XGPageLoad> FinishedLoads;
+    bool IsStopping = false;
+
+    /**
+     * \brief Runs on the worker thread, reading queued pages into their slots until the texture is closed
+     */
+    void LoadQueuedPages();
+
+    /**
+     * \brief Reads a page from the page file into a slot
+     * \return False if the page couldn't be read
+     */
+    static bool ReadPage(std::istream& File, uint32_t Page, olc::Pixel* OutTexels);
+
+    /**
+     * \brief Finds the slot to load a new page into: a free slot, or else the slot whose page was sampled least
+     * recently. Pages sampled during the last frame are never evicted.
+     * \return The slot, or -1 if there isn't one
+     */
+    int32_t FindSlotToLoadInto() const;
+
+    /**
+     * \brief Finds the resident page closest to the given level that covers the texture coordinates, requesting every
+     * page it skips over on the way
+     * \param InOutLevel The level to start from, which is changed to the level the page was found in
+     * \param HalfTexel The amount to offset the texel coordinates by, which is half a texel for bilinear samples
+     * \param OutFixedX Receives the fixed-point texel coordinates in the level the page was found in
+     * \return The texel of the page at the whole part of the texel coordinates
+     */
+    const olc::Pixel* FindResidentTexel(int& InOutLevel, float U, float V, int HalfTexel, int& OutFixedX, int& OutFixedY) const;
+
+    olc::Pixel SampleNearest(int Level, float U, float V) const;
+    olc::Pixel SampleBilinear(int Level, float U, float V) const;
+    olc::Pixel SampleTrilinear(float LevelOfDetail, float U, float V) const;
+};
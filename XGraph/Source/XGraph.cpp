@@ -20,9 +20,44 @@
 // |/__ X
 
 #include "XGEngine.h"
+#include "XGVirtualTexture.h"
+
+namespace
+{
+    /**
+     * \brief Converts an image into a page file, which the engine opens as a virtual texture when given its path in place
+     * of the image's
+     */
+    bool MakePageFile(const std::string& ImageFilePath, const std::string& PageFilePath)
+    {
+        // Images are decoded by the image loader the pixel game engine sets up when it is constructed
+        olc::PixelGameEngine ImageLoaderOwner;
+        olc::Sprite Image;
+        if (Image.LoadFromFile(ImageFilePath) != olc::OK)
+        {
+            std::cout << "ERROR: Failed to load image at path: " << ImageFilePath << std::endl;
+            return false;
+        }
+
+        if (!XGVirtualTexture::WritePageFile(Image, PageFilePath))
+        {
+            std::cout << "ERROR: Failed to write page file at path: " << PageFilePath << std::endl;
+            return false;
+        }
+
+        std::cout << "Wrote page file: " << PageFilePath << std::endl;
+        return true;
+    }
+}
 
 int main(int ArgC, char* ArgV[])
 {
+    // XGraph --make-page-file <image> <page file>
+    if (ArgC == 4 && std::string(ArgV[1]) == "--make-page-file")
+    {
+        return MakePageFile(ArgV[2], ArgV[3]) ? 0 : 1;
+    }
+
     XGEngine Demo(
         "Resources/ValleyTerrain.obj",
         "Resources/Grass.bmp",
@@ -31,6 +66,7 @@ int main(int ArgC, char* ArgV[])
 
     Demo.RenderMode = Textured;
     Demo.ShouldDrawWireframe = false;
+    Demo.ShouldQuantizeMesh = true;
     
     if (!Demo.Construct(1920, 1080, 1, 1))
     {
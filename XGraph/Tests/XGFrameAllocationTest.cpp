@@ -0,0 +1,166 @@
+﻿// XGFrameAllocationTest.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+// Checks that rendering makes no heap allocations once the engine has warmed up. Every call to the global operator new
+// is counted, so growth of any container in the pipeline fails the test, not just the frame arena falling back to the
+// heap.
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "../Source/XGEngine.h"
+#include "../Source/XGFrameArena.h"
+#include "XGTests.h"
+
+namespace
+{
+    std::atomic<size_t> HeapAllocationCount(0);
+
+    constexpr int WarmUpFrameCount = 5;
+    constexpr int SteadyFrameCount = 20;
+
+    constexpr int ScreenWidth = 640;
+    constexpr int ScreenHeight = 360;
+}
+
+void* operator new(size_t Size)
+{
+    ++HeapAllocationCount;
+    if (void* Allocation = std::malloc(Size > 0 ? Size : 1))
+    {
+        return Allocation;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t Size)
+{
+    return operator new(Size);
+}
+
+void operator delete(void* Allocation) noexcept
+{
+    std::free(Allocation);
+}
+
+void operator delete[](void* Allocation) noexcept
+{
+    std::free(Allocation);
+}
+
+void operator delete(void* Allocation, size_t) noexcept
+{
+    std::free(Allocation);
+}
+
+void operator delete[](void* Allocation, size_t) noexcept
+{
+    std::free(Allocation);
+}
+
+namespace
+{
+    bool ReportResult(const std::string& TestName, size_t AllocationCount)
+    {
+        if (AllocationCount != 0)
+        {
+            std::cout << "FAILED: " << TestName << " made " << AllocationCount << " heap allocations in "
+                << SteadyFrameCount << " steady frames" << std::endl;
+            return false;
+        }
+
+        std::cout << "PASSED: " << TestName << std::endl;
+        return true;
+    }
+
+    /**
+     * \brief Allocates a frame's worth of memory with mixed alignments and arrays that grow, which overflows the arena
+     * until it has grown to fit
+     */
+    void AllocateFrame(XGFrameArena& Arena)
+    {
+        XGFrameArray<uint32_t> Indices(Arena);
+        for (uint32_t i = 0; i < 5000; ++i)
+        {
+            Indices.Add(i);
+            if (i % 500 == 0)
+            {
+                Arena.Allocate(24, 64);
+                Arena.AllocateArray<uint8_t>(3);
+            }
+        }
+
+        XGFrameArray<double> Depths(Arena, 100);
+        Depths.Resize(4000);
+    }
+
+    bool TestFrameArena()
+    {
+        XGFrameArena Arena;
+        for (int Frame = 0; Frame < WarmUpFrameCount; ++Frame)
+        {
+            Arena.Reset();
+            AllocateFrame(Arena);
+        }
+
+        const size_t AllocationsBefore = HeapAllocationCount;
+        for (int Frame = 0; Frame < SteadyFrameCount; ++Frame)
+        {
+            Arena.Reset();
+            AllocateFrame(Arena);
+        }
+        Arena.Reset();
+
+        return ReportResult("XGFrameArena", HeapAllocationCount - AllocationsBefore);
+    }
+
+    bool TestEngine(const std::string& TestName, XGRenderMode RenderMode, bool ShouldUseSpanBuffer)
+    {
+        bool HasPassed = true;
+        {
+            XGEngine Engine("Resources/ValleyTerrain.obj", "Resources/Grass.bmp", true);
+            Engine.RenderMode = RenderMode;
+            Engine.ShouldUseSpanBuffer = ShouldUseSpanBuffer;
+            Engine.ShouldLoadTexturesAsync = false;
+
+            olc::Sprite RenderTarget(ScreenWidth, ScreenHeight);
+            if (!Engine.Construct(ScreenWidth, ScreenHeight, 1, 1))
+            {
+                std::cout << "ERROR: Failed to construct engine" << std::endl;
+                return false;
+            }
+            Engine.SetDrawTarget(&RenderTarget);
+            Engine.OnUserCreate();
+
+            for (int Frame = 0; Frame < WarmUpFrameCount; ++Frame)
+            {
+                Engine.OnUserUpdate(0.0f);
+            }
+
+            const size_t AllocationsBefore = HeapAllocationCount;
+            for (int Frame = 0; Frame < SteadyFrameCount; ++Frame)
+            {
+                Engine.OnUserUpdate(0.0f);
+            }
+            HasPassed = ReportResult(TestName, HeapAllocationCount - AllocationsBefore);
+
+            Engine.OnUserDestroy();
+        }
+        return HasPassed;
+    }
+}
+
+bool RunFrameAllocationTests()
+{
+    bool HasPassed = TestFrameArena();
+    HasPassed &= TestEngine("Wireframe", Wireframe, false);
+    HasPassed &= TestEngine("FlatShaded", FlatShaded, false);
+    HasPassed &= TestEngine("Textured", Textured, false);
+    HasPassed &= TestEngine("Textured with span buffer", Textured, true);
+    return HasPassed;
+}
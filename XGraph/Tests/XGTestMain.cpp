@@ -0,0 +1,17 @@
+﻿// XGTestMain.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+// Runs every test and returns nonzero if any of them failed. Run from the XGraph directory so the resources can be
+// found.
+
+#include "XGTests.h"
+
+int main()
+{
+    bool HasPassed = RunFrameAllocationTests();
+    HasPassed &= RunTextureSamplingTests();
+
+    return HasPassed ? 0 : 1;
+}
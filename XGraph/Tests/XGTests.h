@@ -0,0 +1,18 @@
+﻿// XGTests.h
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+#pragma once
+
+/**
+ * \brief Checks that the frame arena and the engine make no heap allocations once they have warmed up
+ * \return True if every test passed
+ */
+bool RunFrameAllocationTests();
+
+/**
+ * \brief Checks that textures sample texture coordinates far outside the texture the way their wrap mode says
+ * \return True if every test passed
+ */
+bool RunTextureSamplingTests();
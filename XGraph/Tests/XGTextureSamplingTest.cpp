@@ -0,0 +1,159 @@
+﻿// XGTextureSamplingTest.cpp
+// XGraph
+//
+// Copyright (C) 2024 Travis Blankenship. All rights reserved.
+
+// Checks that texture coordinates far outside a texture, which tiled terrain produces, land on the texel their wrap
+// mode says they should. Scaled to fixed-point texels as they are, such coordinates would overflow.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "../Source/XGTexture.h"
+#include "../Source/XGVirtualTexture.h"
+#include "XGTests.h"
+
+namespace
+{
+    /**
+     * \brief Sets every texel of a sprite to its own position, so a sample shows which texel it landed on
+     */
+    void FillWithPositions(olc::Sprite& Sprite)
+    {
+        for (int Y = 0; Y < Sprite.height; ++Y)
+        {
+            for (int X = 0; X < Sprite.width; ++X)
+            {
+                Sprite.pColData[static_cast<size_t>(Y) * Sprite.width + X] = olc::Pixel(
+                    static_cast<uint8_t>(X & 0xFF),
+                    static_cast<uint8_t>((X >> 8) & 0xFF),
+                    static_cast<uint8_t>(Y & 0xFF)
+                );
+            }
+        }
+    }
+
+    bool ReportResult(const std::string& TestName, const olc::Pixel& Sample, const olc::Pixel& ExpectedSample)
+    {
+        if (Sample != ExpectedSample)
+        {
+            std::cout << "FAILED: " << TestName << " sampled (" << static_cast<int>(Sample.r) << ", "
+                << static_cast<int>(Sample.g) << ", " << static_cast<int>(Sample.b) << "), expected ("
+                << static_cast<int>(ExpectedSample.r) << ", " << static_cast<int>(ExpectedSample.g) << ", "
+                << static_cast<int>(ExpectedSample.b) << ")" << std::endl;
+            return false;
+        }
+
+        std::cout << "PASSED: " << TestName << std::endl;
+        return true;
+    }
+
+    /**
+     * \brief Samples a texture far outside it and at the coordinate inside it the wrap mode should bring the sample to
+     */
+    bool TestWrap(int Width, XGTextureWrap Wrap, const std::string& WrapName, float FarU, float NearU)
+    {
+        olc::Sprite Sprite(Width, 4);
+        FillWithPositions(Sprite);
+        XGTexture Texture;
+        Texture.LoadFromSprite(Sprite);
+        Texture.SetWrap(Wrap);
+
+        bool HasPassed = true;
+        std::ostringstream TestName;
+        TestName << WrapName << " " << Width << " wide at U = " << FarU;
+        HasPassed &= ReportResult(
+            TestName.str() + ", nearest",
+            Texture.Sample(NearestFilter, 0.0f, FarU, 0.5f),
+            Texture.Sample(NearestFilter, 0.0f, NearU, 0.5f)
+        );
+        HasPassed &= ReportResult(
+            TestName.str() + ", bilinear",
+            Texture.Sample(BilinearFilter, 0.0f, FarU, 0.5f),
+            Texture.Sample(BilinearFilter, 0.0f, NearU, 0.5f)
+        );
+        return HasPassed;
+    }
+
+    bool TestTextureWrapping()
+    {
+        // At 4096 or 3000 texels wide, a U of 3000 is past what fits in 24.8 fixed point
+        bool HasPassed = true;
+        for (const int Width : { 4096, 3000 })
+        {
+            HasPassed &= TestWrap(Width, RepeatWrap, "Repeat", 3000.25f, 0.25f);
+            HasPassed &= TestWrap(Width, RepeatWrap, "Repeat", -2999.75f, 0.25f);
+            HasPassed &= TestWrap(Width, MirrorWrap, "Mirror", 3000.25f, 0.25f);
+            HasPassed &= TestWrap(Width, MirrorWrap, "Mirror", -2999.75f, 0.25f);
+            HasPassed &= TestWrap(Width, ClampWrap, "Clamp", 3000.25f, 1.0f);
+            HasPassed &= TestWrap(Width, ClampWrap, "Clamp", -2999.75f, 0.0f);
+        }
+        return HasPassed;
+    }
+
+    bool TestVirtualTexture()
+    {
+        // Level 0 of a virtual texture 65536 texels wide has 2^24 fixed-point texels across, so a U of 1000 would need
+        // 34 bits
+        const std::string PageFilePath = "XGTextureSamplingTest.xgvt";
+        {
+            olc::Sprite Sprite(65536, XGVirtualTexture::PageSize);
+            FillWithPositions(Sprite);
+            if (!XGVirtualTexture::WritePageFile(Sprite, PageFilePath))
+            {
+                std::cout << "FAILED: Virtual texture, couldn't write page file" << std::endl;
+                return false;
+            }
+        }
+
+        bool HasPassed = true;
+        {
+            XGTexture Texture;
+            if (!Texture.LoadFromPageFile(PageFilePath, 16))
+            {
+                std::cout << "FAILED: Virtual texture, couldn't open page file" << std::endl;
+                std::remove(PageFilePath.c_str());
+                return false;
+            }
+
+            // Pages load on the worker thread once they have been asked for, so keep sampling until the page is
+            // resident. Until then, samples fall back to coarser levels.
+            const olc::Pixel ExpectedSample(0, 64, 64);
+            olc::Pixel Sample;
+            const auto StartTime = std::chrono::steady_clock::now();
+            while (std::chrono::steady_clock::now() - StartTime < std::chrono::seconds(5))
+            {
+                Sample = Texture.Sample(NearestFilter, 0.0f, 1000.25f, 0.5f);
+                if (Sample == ExpectedSample)
+                {
+                    break;
+                }
+
+                Texture.UpdatePages();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            HasPassed &= ReportResult("Virtual texture 65536 wide at U = 1000.25, nearest", Sample, ExpectedSample);
+            HasPassed &= ReportResult(
+                "Virtual texture 65536 wide at U = 1000.25, bilinear",
+                Texture.Sample(BilinearFilter, 0.0f, 1000.25f, 0.5f),
+                Texture.Sample(BilinearFilter, 0.0f, 0.25f, 0.5f)
+            );
+        }
+
+        // The page file is closed along with the texture, so it can be deleted now
+        std::remove(PageFilePath.c_str());
+        return HasPassed;
+    }
+}
+
+bool RunTextureSamplingTests()
+{
+    bool HasPassed = TestTextureWrapping();
+    HasPassed &= TestVirtualTexture();
+    return HasPassed;
+}